@@ -1,9 +1,19 @@
+#include <ctype.h>
 #include <FS.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 #include <ArduinoOTA.h>             // Over-the-air helper object so we can be flashed via WiFi
 #include "globals.h"
 #include "drawing.h"
+#include "framestore.h"
+#include "scenes.h"
+#include "powersave.h"
+#include "palettes.h"
+#include "deferredlog.h"
+#include "preview.h"
+#include "remotepixels.h"
+#include <memory>
+#include <new>
 
 using namespace fs;
 
@@ -12,41 +22,374 @@ class ApiWebServer
   private:
 
     AsyncWebServer _server;
+    AsyncWebSocket _socket;
+    AsyncWebSocket _preview;
+
+    // A single (strip, index, color) triple for /setleds.  Binary bodies carry these packed as 6 bytes:
+    // strip, index low byte, index high byte, red, green, blue.
+
+    struct LedUpdate
+    {
+        uint8_t  strip;
+        uint16_t index;
+        CRGB     color;
+    };
+
+    static constexpr size_t kLedUpdateRecordSize = 6;
+    static constexpr size_t kMaxLedUpdates       = NUM_LEDS0 + NUM_LEDS1;
+
+    static bool isValidLedUpdate(const LedUpdate & update)
+    {
+        return (update.strip == 0 && update.index < NUM_LEDS0)
+            || (update.strip == 1 && update.index < NUM_LEDS1);
+    }
+
+    // Stages one update; only between BeginPixelWrites and EndPixelWrites
+
+    static void applyLedUpdate(const LedUpdate & update)
+    {
+        WritePixel(update.strip, update.index, update.color);
+    }
+
+    // parseNumber
+    //
+    // Parses an unsigned number made of digits only and advances psz past it.  strtoul alone would also take
+    // leading whitespace, a sign and, in base 16, a 0x prefix; those are rejected here, as is anything over maxValue.
+
+    static bool parseNumber(const char *& psz, int base, unsigned long maxValue, unsigned long & value)
+    {
+        const char * pszDigits = psz;
+        while (base == 16 ? isxdigit(static_cast<uint8_t>(*psz)) : isdigit(static_cast<uint8_t>(*psz)))
+            ++psz;
+        if (psz == pszDigits)
+            return false;
+
+        char * pszEnd = nullptr;
+        value = strtoul(pszDigits, &pszEnd, base);
+        return pszEnd == psz && value <= maxValue;
+    }
+
+    // parseLedUpdate
+    //
+    // Parses one "strip:index:RRGGBB" token from a /setleds query string and advances psz past it and the
+    // trailing comma.  Every field is range checked before it is narrowed into the update.
+
+    static bool parseLedUpdate(const char *& psz, LedUpdate & update)
+    {
+        unsigned long strip, index, rgb;
+        if (!parseNumber(psz, 10, NUM_CHANNELS - 1, strip) || *psz++ != ':')
+            return false;
+        if (!parseNumber(psz, 10, UINT16_MAX, index) || *psz++ != ':')
+            return false;
+
+        const char * pszColor = psz;
+        if (!parseNumber(psz, 16, 0xFFFFFF, rgb) || psz - pszColor != 6 || (*psz != ',' && *psz != 0))
+            return false;
+        if (*psz)
+            ++psz;
+
+        update.strip = static_cast<uint8_t>(strip);
+        update.index = static_cast<uint16_t>(index);
+        update.color = CRGB(static_cast<uint32_t>(rgb));
+        return isValidLedUpdate(update);
+    }
+
+    static LedUpdate decodeLedUpdate(const uint8_t * pRecord)
+    {
+        LedUpdate update;
+        update.strip = pRecord[0];
+        update.index = static_cast<uint16_t>(pRecord[1] | (pRecord[2] << 8));
+        update.color = CRGB(pRecord[3], pRecord[4], pRecord[5]);
+        return update;
+    }
+
+    // WebSocket control messages
+    //
+    // Each binary message starts with a command byte:
+    //
+    //   0x01 SetPixels      n x 6-byte LED records, same layout as the binary /setleds body
+    //   0x02 SetZoneColor   zone (LedZone), r, g, b
+    //   0x03 SetBrightness  value, persist (0/1)
+    //   0x04 TriggerEffect  effect (EffectTrigger)
+    //
+    // Messages are assembled into a buffer that is allocated once with the server, so a command costs no heap.
+
+    enum class SocketCommand : uint8_t
+    {
+        SetPixels     = 0x01,
+        SetZoneColor  = 0x02,
+        SetBrightness = 0x03,
+        TriggerEffect = 0x04
+    };
+
+    static constexpr size_t kMaxSocketMessage = 1 + kMaxLedUpdates * kLedUpdateRecordSize;
+
+    uint8_t  _socketBuffer[kMaxSocketMessage];
+    uint32_t _socketClientId = 0;
+
+    bool handleSocketMessage(const uint8_t * pMessage, size_t len)
+    {
+        NotePowerActivity();
+        if (len == 0)
+            return false;
+
+        const uint8_t * pArgs = pMessage + 1;
+        const size_t cbArgs = len - 1;
+        switch (static_cast<SocketCommand>(pMessage[0]))
+        {
+            case SocketCommand::SetPixels:
+            {
+                if (cbArgs % kLedUpdateRecordSize != 0)
+                    return false;
+                const size_t count = cbArgs / kLedUpdateRecordSize;
+                for (size_t i = 0; i < count; ++i)
+                    if (!isValidLedUpdate(decodeLedUpdate(pArgs + i * kLedUpdateRecordSize)))
+                        return false;
+                BeginPixelWrites();
+                for (size_t i = 0; i < count; ++i)
+                    applyLedUpdate(decodeLedUpdate(pArgs + i * kLedUpdateRecordSize));
+                EndPixelWrites();
+                return true;
+            }
+            case SocketCommand::SetZoneColor:
+            {
+                if (cbArgs != 4 || pArgs[0] >= static_cast<uint8_t>(LedZone::Count))
+                    return false;
+                BeginPixelWrites();
+                WriteZonePixels(static_cast<LedZone>(pArgs[0]), CRGB(pArgs[1], pArgs[2], pArgs[3]));
+                EndPixelWrites();
+                return true;
+            }
+            case SocketCommand::SetBrightness:
+                if (cbArgs != 2)
+                    return false;
+                PostBrightness(pArgs[0]);
+                if (pArgs[1])
+                    SaveBrightness(pArgs[0]);
+                return true;
+            case SocketCommand::TriggerEffect:
+                return cbArgs == 1 && TriggerEffect(static_cast<EffectTrigger>(pArgs[0]));
+            default:
+                return false;
+        }
+    }
+
+    void onSocketEvent(AsyncWebSocketClient * pClient, AwsEventType type, void * pArg, uint8_t * pData, size_t len)
+    {
+        if (type != WS_EVT_DATA)
+            return;
+
+        // Only single-frame binary messages are accepted; a frame may still arrive in several TCP packets
+        const AwsFrameInfo * pInfo = static_cast<const AwsFrameInfo *>(pArg);
+        if (pInfo->opcode != WS_BINARY || !pInfo->final || pInfo->num != 0 || pInfo->len > kMaxSocketMessage)
+            return;
+
+        if (pInfo->index == 0)
+            _socketClientId = pClient->id();
+        else if (_socketClientId != pClient->id())
+            return;
+
+        memcpy(_socketBuffer + pInfo->index, pData, len);
+        if (pInfo->index + len == pInfo->len && !handleSocketMessage(_socketBuffer, pInfo->len))
+            logW("Rejected WebSocket command 0x%02x", _socketBuffer[0]);
+    }
+
+    // Preview stream
+    //
+    // Viewers on /preview only listen.  Each new viewer asks for a key frame, which every viewer then gets; the
+    // message is encoded once into _previewMessage and queued to all of them as one shared buffer.
+
+    uint8_t _previewMessage[kMaxPreviewMessage];
+    volatile bool _bPreviewKeyPending = false;
+
+    void onPreviewEvent(AwsEventType type)
+    {
+        if (type == WS_EVT_CONNECT)
+            _bPreviewKeyPending = true;
+    }
+
+    static void sendStatus(AsyncWebServerRequest * pRequest, int code)
+    {
+        AsyncWebServerResponse * pResponse = pRequest->beginResponse(code);
+        pResponse->addHeader("Access-Control-Allow-Origin", "*");
+        pRequest->send(pResponse);      
+    }
 
   public:
 
     ApiWebServer()
-        : _server(80)
+        : _server(80),
+          _socket("/ws"),
+          _preview("/preview")
+    {
+    }
+
+    // parseZoneMask
+    //
+    // Parses a scene zone mask, decimal or 0x-prefixed hex, for /savescene and the console.  Fails on anything
+    // but digits and on bits past the last LedZone, rather than letting a narrowing cast turn it into another mask.
+
+    static bool parseZoneMask(const char * psz, uint16_t & zoneMask)
     {
+        int base = 10;
+        if (psz[0] == '0' && (psz[1] == 'x' || psz[1] == 'X'))
+        {
+            base = 16;
+            psz += 2;
+        }
+
+        unsigned long value;
+        if (!parseNumber(psz, base, kMaxSceneZoneMask, value) || *psz != 0)
+            return false;
+        zoneMask = static_cast<uint16_t>(value);
+        return true;
     }
 
     void begin()
     {
         _server.on("/setled",         HTTP_GET, [this](AsyncWebServerRequest * pRequest) { this->setLed(pRequest); });
         _server.on("/setbrightness",         HTTP_GET, [this](AsyncWebServerRequest * pRequest) { this->setBrightness(pRequest); });
+        _server.on("/setleds",        HTTP_GET, [this](AsyncWebServerRequest * pRequest) { this->setLeds(pRequest); });
+        _server.on("/setleds",        HTTP_POST, 
+                   [this](AsyncWebServerRequest * pRequest) { this->setLedsBinary(pRequest); },
+                   nullptr,
+                   [](AsyncWebServerRequest * pRequest, uint8_t * pData, size_t len, size_t index, size_t total) { receiveLedUpdates(pRequest, pData, len, index, total); });
+        _server.on("/play",           HTTP_GET, [this](AsyncWebServerRequest * pRequest) { this->play(pRequest); });
+        _server.on("/stop",           HTTP_GET, [this](AsyncWebServerRequest * pRequest) { this->stop(pRequest); });
+        _server.on("/scene",          HTTP_GET, [this](AsyncWebServerRequest * pRequest) { this->scene(pRequest); });
+        _server.on("/savescene",      HTTP_GET, [this](AsyncWebServerRequest * pRequest) { this->saveScene(pRequest); });
+        _server.on("/clearscene",     HTTP_GET, [this](AsyncWebServerRequest * pRequest) { this->clearScene(pRequest); });
+        _server.on("/setpalette",     HTTP_GET, [this](AsyncWebServerRequest * pRequest) { this->setPalette(pRequest); });
+        _server.on("/frame",          HTTP_GET, [](AsyncWebServerRequest * pRequest) { frame(pRequest); });
+        _server.on("/previewrate",    HTTP_GET, [](AsyncWebServerRequest * pRequest) { previewRate(pRequest); });
+        _server.on("/drawstats",      HTTP_GET, [](AsyncWebServerRequest * pRequest) { drawStats(pRequest); });
+
+        _socket.onEvent([this](AsyncWebSocket *, AsyncWebSocketClient * pClient, AwsEventType type, void * pArg, uint8_t * pData, size_t len)
+        {
+            this->onSocketEvent(pClient, type, pArg, pData, len);
+        });
+        _server.addHandler(&_socket);
+
+        _preview.onEvent([this](AsyncWebSocket *, AsyncWebSocketClient *, AwsEventType type, void *, uint8_t *, size_t)
+        {
+            this->onPreviewEvent(type);
+        });
+        _server.addHandler(&_preview);
 
         _server.begin();
         debugI("HTTP server started");
     }
 
+    // cleanupClients
+    //
+    // Drops WebSocket clients that have disconnected; call this periodically from the main loop
+
+    void cleanupClients()
+    {
+        _socket.cleanupClients();
+        _preview.cleanupClients();
+    }
+
+    // sendPreview
+    //
+    // Sends the newest published frame to the preview viewers, if there is one they have not seen; call this
+    // from the main loop.  While any viewer's queue is full nothing is encoded, as a viewer that missed a delta
+    // would show the wrong colors until the next key frame.
+
+    void sendPreview()
+    {
+        if (_preview.count() == 0 || !_preview.availableForWriteAll())
+            return;
+
+        const bool bKeyFrame = _bPreviewKeyPending;
+        _bPreviewKeyPending = false;
+        const size_t len = NextPreviewMessage(_previewMessage, bKeyFrame);
+        if (len == 0)
+        {
+            _bPreviewKeyPending = _bPreviewKeyPending || bKeyFrame;
+            return;
+        }
+        _preview.binaryAll(_preview.makeBuffer(_previewMessage, len));
+    }
+
+    // frame
+    //
+    // The newest published frame: leds0 then leds1, 3 bytes RGB per LED, before brightness is applied
+
+    static void frame(AsyncWebServerRequest * pRequest)
+    {
+        uint8_t frame[kPreviewFrameBytes];
+        uint16_t sequence;
+        if (!CopyPreviewFrame(frame, sequence))
+        {
+            sendStatus(pRequest, 503);
+            return;
+        }
+
+        AsyncResponseStream * pResponse = pRequest->beginResponseStream("application/octet-stream", sizeof(frame));
+        pResponse->addHeader("Access-Control-Allow-Origin", "*");
+        pResponse->addHeader("X-Frame-Sequence", String(sequence));
+        pResponse->addHeader("X-Brightness", String(FastLED.getBrightness()));
+        pResponse->write(frame, sizeof(frame));
+        pRequest->send(pResponse);
+    }
+
+    // drawStats
+    //
+    // The draw counters as JSON, so a load test can see what it costs the frame rate.  Reading them does not
+    // count as activity for the power governor.
+
+    static void drawStats(AsyncWebServerRequest * pRequest)
+    {
+        DrawStats stats;
+        GetDrawStats(stats);
+
+        AsyncResponseStream * pResponse = pRequest->beginResponseStream("application/json");
+        pResponse->addHeader("Access-Control-Allow-Origin", "*");
+        pResponse->printf("{\"millis\":%u,\"frames\":%u,\"showAvgUs\":%u,\"passAvgUs\":%u,\"overruns\":%u}",
+                          static_cast<unsigned>(millis()), stats.frames, stats.showAvgUs, stats.passAvgUs, stats.overruns);
+        pRequest->send(pResponse);
+    }
+
+    // previewRate
+    //
+    // Sets how many frames a second /frame and /preview get with ?fps=, 1 to kMaxPreviewFps
+
+    static void previewRate(AsyncWebServerRequest * pRequest)
+    {
+        const char * pszFps = "fps";
+        const bool bSet = pRequest->hasParam(pszFps, false, false)
+                        && SetPreviewRate(static_cast<uint8_t>(constrain(strtoul(pRequest->getParam(pszFps, false, false)->value().c_str(), NULL, 10), 0, 255)));
+        sendStatus(pRequest, bSet ? 200 : 400);
+    }
+
+    // setLed
+    //
+    // Blanks leds1 and lights the LED given by ?index= white, replacing whatever LEDs a client set before
+
     void setLed(AsyncWebServerRequest * pRequest)
     {
-        ColorFillEffect(CRGB::Black, NUM_LEDS1, 1);
+        NotePowerActivity();
+        size_t index = SIZE_MAX;
 
         const char * pszEffectIndex = "index";
         if (pRequest->hasParam(pszEffectIndex, false, false))
         {
-          debugI("processRequest: param found");
+          logI("processRequest: param found");
           AsyncWebParameter * p = pRequest->getParam(pszEffectIndex, false, false);
-          size_t index = strtoul(p->value().c_str(), NULL, 10); 
-          debugI("index = %d", index);
-          leds1[index] = CRGB::White;
-          FastLED.show();
+          index = strtoul(p->value().c_str(), NULL, 10); 
+          logI("index = %u", static_cast<unsigned>(index));
         } 
         else 
         {
-            debugI("processRequest: param not found");
+            logI("processRequest: param not found");
         }
+
+        BeginPixelWrites(true);
+        for (uint16_t led = 0; led < NUM_LEDS1; ++led)
+            WritePixel(1, led, led == index ? CRGB::White : CRGB::Black);
+        EndPixelWrites();
+
         AsyncWebServerResponse * pResponse = pRequest->beginResponse(200);
         pResponse->addHeader("Access-Control-Allow-Origin", "*");
         pRequest->send(pResponse);      
@@ -54,25 +397,194 @@ class ApiWebServer
 
     void setBrightness(AsyncWebServerRequest * pRequest)
     {
+        NotePowerActivity();
         const char * pszEffectIndex = "value";
         if (pRequest->hasParam(pszEffectIndex, false, false))
         {
-          debugI("processRequest: param found");
+          logI("processRequest: param found");
           AsyncWebParameter * p = pRequest->getParam(pszEffectIndex, false, false);
           size_t value = strtoul(p->value().c_str(), NULL, 10); 
-          debugI("value = %d", value);
+          logI("value = %u", static_cast<unsigned>(value));
           uint8_t brightness = static_cast<uint8_t>(constrain(value, 0, 255));
-          FastLED.setBrightness(brightness);
+          PostBrightness(brightness);
           SaveBrightness(brightness);
-          FastLED.show();
         } 
         else 
         {
-            debugI("processRequest: param not found");
+            logI("processRequest: param not found");
+        }
+        AsyncWebServerResponse * pResponse = pRequest->beginResponse(200);
+        pResponse->addHeader("Access-Control-Allow-Origin", "*");
+        pRequest->send(pResponse);      
+    }
+
+    void play(AsyncWebServerRequest * pRequest)
+    {
+        NotePowerActivity();
+        bool bStarted = false;
+        const char * pszName = "name";
+        if (pRequest->hasParam(pszName, false, false))
+        {
+          const bool bLoop = pRequest->hasParam("loop", false, false);
+          bStarted = StartFramePlayback(pRequest->getParam(pszName, false, false)->value().c_str(), bLoop);
+        } 
+        else 
+        {
+            logI("processRequest: param not found");
         }
+        AsyncWebServerResponse * pResponse = pRequest->beginResponse(bStarted ? 200 : 400);
+        pResponse->addHeader("Access-Control-Allow-Origin", "*");
+        pRequest->send(pResponse);      
+    }
+
+    void stop(AsyncWebServerRequest * pRequest)
+    {
+        NotePowerActivity();
+        StopFrameStore();
         AsyncWebServerResponse * pResponse = pRequest->beginResponse(200);
         pResponse->addHeader("Access-Control-Allow-Origin", "*");
         pRequest->send(pResponse);      
     }
 
+    void scene(AsyncWebServerRequest * pRequest)
+    {
+        const char * pszName = "name";
+        const bool bActivated = pRequest->hasParam(pszName, false, false)
+                             && ActivateScene(pRequest->getParam(pszName, false, false)->value().c_str());
+        sendStatus(pRequest, bActivated ? 200 : 404);
+    }
+
+    // saveScene
+    //
+    // Captures the current output as ?name=, optionally limited to ?zones=, a bit per LedZone
+
+    void saveScene(AsyncWebServerRequest * pRequest)
+    {
+        NotePowerActivity();
+        bool bSaved = false;
+        const char * pszName = "name";
+        if (pRequest->hasParam(pszName, false, false))
+        {
+            const char * pszZones = "zones";
+            uint16_t zoneMask = kSceneAllZones;
+            if (!pRequest->hasParam(pszZones, false, false)
+                || parseZoneMask(pRequest->getParam(pszZones, false, false)->value().c_str(), zoneMask))
+            {
+                bSaved = SaveScene(pRequest->getParam(pszName, false, false)->value().c_str(), zoneMask);
+            }
+        }
+        sendStatus(pRequest, bSaved ? 200 : 400);
+    }
+
+    void clearScene(AsyncWebServerRequest * pRequest)
+    {
+        ClearScene();
+        sendStatus(pRequest, 200);
+    }
+
+    // setPalette
+    //
+    // Themes the backglass with ?name=, or only the LedZone given by ?zone=
+
+    void setPalette(AsyncWebServerRequest * pRequest)
+    {
+        NotePowerActivity();
+        bool bSet = false;
+        PaletteId palette;
+        const char * pszName = "name";
+        if (pRequest->hasParam(pszName, false, false) && FindPalette(pRequest->getParam(pszName, false, false)->value().c_str(), palette))
+        {
+            const char * pszZone = "zone";
+            bSet = pRequest->hasParam(pszZone, false, false)
+                 ? SetZonePalette(static_cast<LedZone>(strtoul(pRequest->getParam(pszZone, false, false)->value().c_str(), NULL, 10)), palette)
+                 : SetAllZonePalettes(palette);
+        }
+        sendStatus(pRequest, bSet ? 200 : 400);
+    }
+
+    // setLeds
+    //
+    // Applies a batch of LED updates from ?leds=strip:index:RRGGBB,strip:index:RRGGBB,...  Every triple is
+    // parsed and validated before any LED is touched, then they all go to the draw task as one batch.
+
+    void setLeds(AsyncWebServerRequest * pRequest)
+    {
+        NotePowerActivity();
+        const char * pszLeds = "leds";
+        if (!pRequest->hasParam(pszLeds, false, false))
+        {
+            sendStatus(pRequest, 400);
+            return;
+        }
+
+        std::unique_ptr<LedUpdate[]> updates(new (std::nothrow) LedUpdate[kMaxLedUpdates]);
+        if (!updates)
+        {
+            sendStatus(pRequest, 503);
+            return;
+        }
+
+        const String & value = pRequest->getParam(pszLeds, false, false)->value();
+        size_t count = 0;
+        for (const char * psz = value.c_str(); *psz; ++count)
+        {
+            if (count >= kMaxLedUpdates || !parseLedUpdate(psz, updates[count]))
+            {
+                sendStatus(pRequest, 400);
+                return;
+            }
+        }
+
+        BeginPixelWrites();
+        for (size_t i = 0; i < count; ++i)
+            applyLedUpdate(updates[i]);
+        EndPixelWrites();
+        sendStatus(pRequest, 200);
+    }
+
+    // receiveLedUpdates
+    //
+    // Collects a binary /setleds body, which may arrive in several chunks, into the request's temp object;
+    // the server frees it along with the request.
+
+    static void receiveLedUpdates(AsyncWebServerRequest * pRequest, uint8_t * pData, size_t len, size_t index, size_t total)
+    {
+        if (index == 0)
+        {
+            if (total == 0 || total % kLedUpdateRecordSize != 0 || total > kMaxLedUpdates * kLedUpdateRecordSize)
+                return;
+            pRequest->_tempObject = malloc(total);
+        }
+
+        if (pRequest->_tempObject != nullptr && index + len <= total)
+            memcpy(static_cast<uint8_t *>(pRequest->_tempObject) + index, pData, len);
+    }
+
+    void setLedsBinary(AsyncWebServerRequest * pRequest)
+    {
+        NotePowerActivity();
+        const uint8_t * pRecords = static_cast<const uint8_t *>(pRequest->_tempObject);
+        const size_t count = pRequest->contentLength() / kLedUpdateRecordSize;
+        if (pRecords == nullptr)
+        {
+            sendStatus(pRequest, 400);
+            return;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!isValidLedUpdate(decodeLedUpdate(pRecords + i * kLedUpdateRecordSize)))
+            {
+                sendStatus(pRequest, 400);
+                return;
+            }
+        }
+
+        BeginPixelWrites();
+        for (size_t i = 0; i < count; ++i)
+            applyLedUpdate(decodeLedUpdate(pRecords + i * kLedUpdateRecordSize));
+        EndPixelWrites();
+        sendStatus(pRequest, 200);
+    }
+
 };
\ No newline at end of file
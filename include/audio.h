@@ -0,0 +1,15 @@
+#pragma once
+
+#include <Arduino.h>
+#include "audioanalysis.h"
+
+// Audio analysis
+//
+// The audio task reads a microphone over I2S, runs each block through AudioAnalyzer (audioanalysis.h) and
+// publishes band energies, the overall level and beat onsets.  Effects read the latest results with
+// GetAudioSnapshot, which never blocks the audio task: the snapshot is published with a sequence counter and
+// readers simply retry if they catch it mid-update.
+
+void AudioLoopTaskEntry(void *);
+bool GetAudioSnapshot(AudioSnapshot & snapshot);
+void ReportAudioStats();
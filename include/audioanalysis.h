@@ -0,0 +1,197 @@
+#pragma once
+
+// Audio analysis DSP
+//
+// AudioAnalyzer turns one block of microphone samples into band energies, an overall level and beat onsets: a
+// Hann window, an in-place Q15 radix-2 FFT, band sums over roughly logarithmic bins with a per-band automatic
+// gain, and a bass onset detector.  The audio task in src/audio.cpp feeds it from I2S and publishes the result.
+//
+// Like framefile.h this depends only on the C standard headers, so tools/audiocheck.cpp runs the same code over
+// WAV files on the host.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+constexpr uint32_t kAudioSampleRate    = 16000;
+constexpr uint16_t kAudioBlockSize     = 256;           // 16 ms blocks, 62.5 Hz bins
+constexpr uint32_t kAudioBlockBudgetUs = 2000;          // DSP time allowed per block on the ESP32
+constexpr uint8_t  kAudioBands         = 8;
+
+struct AudioSnapshot
+{
+    uint8_t  bands[kAudioBands];        // Band energy, 0-255 relative to each band's recent peak, bass first
+    uint8_t  level;                     // Overall loudness, 0-255
+    uint32_t lastBeatMs;                // millis() of the most recent beat onset
+    uint32_t updatedMs;                 // millis() when this snapshot was published
+};
+
+class AudioAnalyzer
+{
+  public:
+
+    AudioAnalyzer()
+    {
+        InitTables();
+    }
+
+    // Analyze
+    //
+    // Samples are 32 bits with the signal left-justified, as the I2S microphone delivers its 24 significant
+    // bits; only the top 16 are used.  nowMs is the time the block ended and is what lastBeatMs reports.
+
+    void Analyze(const int32_t * pSamples, uint32_t nowMs, AudioSnapshot & snapshot)
+    {
+        LoadBlock(pSamples);
+        Fft();
+
+        uint32_t total = 0;
+        uint32_t bass = 0;
+        for (uint8_t band = 0; band < kAudioBands; ++band)
+        {
+            uint32_t energy = 0;
+            for (uint8_t bin = kBandEdges[band]; bin < kBandEdges[band + 1]; ++bin)
+                energy += Magnitude(_re[bin], _im[bin]);
+
+            // Each band is scaled against its own slowly decaying peak, a per-band automatic gain
+            const uint32_t decayed = static_cast<uint32_t>((static_cast<uint64_t>(_bandPeaks[band]) * kPeakDecay) >> 16);
+            _bandPeaks[band] = energy > decayed ? energy : decayed;
+            snapshot.bands[band] = _bandPeaks[band] ? static_cast<uint8_t>(energy * 255 / _bandPeaks[band]) : 0;
+
+            total += snapshot.bands[band];
+            if (band < 2)
+                bass += energy;
+        }
+        snapshot.level = static_cast<uint8_t>(total / kAudioBands);
+
+        // A beat is a bass burst well above its running average
+        if (bass > kMinBeatEnergy && bass > _bassAverage + _bassAverage / 2 && nowMs - _lastBeatMs > kBeatRefractoryMs)
+            _lastBeatMs = nowMs;
+        _bassAverage = (_bassAverage * 7 + bass) / 8;
+
+        snapshot.lastBeatMs = _lastBeatMs;
+        snapshot.updatedMs = nowMs;
+    }
+
+  private:
+
+    static constexpr uint8_t  kFftLog2          = 8;
+    static constexpr uint32_t kBeatRefractoryMs = 200;
+    static constexpr uint32_t kMinBeatEnergy    = 64;
+    static constexpr uint16_t kPeakDecay        = 65300;  // Per-block band peak decay, Q16 (about 0.4%)
+
+    static_assert(kAudioBlockSize == 1 << kFftLog2, "The FFT size must match its log2");
+
+    // Upper FFT bin (exclusive) of each band, roughly logarithmic from 62 Hz to 8 kHz
+    static constexpr uint8_t kBandEdges[kAudioBands + 1] = { 1, 3, 5, 9, 16, 28, 48, 80, 128 };
+
+    int16_t  _cosTable[kAudioBlockSize / 2];               // Q15 twiddles and window
+    int16_t  _sinTable[kAudioBlockSize / 2];
+    int16_t  _window[kAudioBlockSize];
+    int16_t  _re[kAudioBlockSize];
+    int16_t  _im[kAudioBlockSize];
+
+    uint32_t _bandPeaks[kAudioBands] = {};
+    uint32_t _bassAverage = 0;
+    uint32_t _lastBeatMs = 0;
+
+    void InitTables()
+    {
+        const float kTwoPi = 6.28318530718f;
+        for (uint16_t i = 0; i < kAudioBlockSize / 2; ++i)
+        {
+            const float angle = kTwoPi * i / kAudioBlockSize;
+            _cosTable[i] = static_cast<int16_t>(cosf(angle) * 32767.0f);
+            _sinTable[i] = static_cast<int16_t>(sinf(angle) * 32767.0f);
+        }
+        for (uint16_t i = 0; i < kAudioBlockSize; ++i)
+        {
+            _window[i] = static_cast<int16_t>((0.5f - 0.5f * cosf(kTwoPi * i / (kAudioBlockSize - 1))) * 32767.0f);
+        }
+    }
+
+    static int16_t MultiplyQ15(int16_t a, int16_t b)
+    {
+        return static_cast<int16_t>((static_cast<int32_t>(a) * b) >> 15);
+    }
+
+    // Magnitude
+    //
+    // Alpha-max-plus-beta-min estimate of |re + j im|, within about 12% and free of square roots
+
+    static uint32_t Magnitude(int16_t re, int16_t im)
+    {
+        const uint32_t a = static_cast<uint32_t>(abs(re));
+        const uint32_t b = static_cast<uint32_t>(abs(im));
+        return a > b ? a + (b >> 1) : b + (a >> 1);
+    }
+
+    void LoadBlock(const int32_t * pSamples)
+    {
+        // Keep the top 16 bits of each sample and remove DC
+        int64_t sum = 0;
+        for (uint16_t i = 0; i < kAudioBlockSize; ++i)
+            sum += pSamples[i] >> 16;
+        const int32_t dc = static_cast<int32_t>(sum / kAudioBlockSize);
+
+        for (uint16_t i = 0; i < kAudioBlockSize; ++i)
+        {
+            int32_t sample = (pSamples[i] >> 16) - dc;
+            sample = sample < -32768 ? -32768 : sample > 32767 ? 32767 : sample;
+            _re[i] = MultiplyQ15(static_cast<int16_t>(sample), _window[i]);
+            _im[i] = 0;
+        }
+    }
+
+    // Fft
+    //
+    // In-place radix-2 decimation-in-time FFT on _re/_im.  Every stage halves its output so nothing can
+    // overflow; the result is the transform scaled by 1/kAudioBlockSize.
+
+    void Fft()
+    {
+        for (uint16_t i = 1, j = 0; i < kAudioBlockSize; ++i)
+        {
+            uint16_t bit = kAudioBlockSize >> 1;
+            for (; j & bit; bit >>= 1)
+                j ^= bit;
+            j ^= bit;
+            if (i < j)
+            {
+                const int16_t re = _re[i];
+                const int16_t im = _im[i];
+                _re[i] = _re[j];
+                _im[i] = _im[j];
+                _re[j] = re;
+                _im[j] = im;
+            }
+        }
+
+        for (uint8_t stage = 1; stage <= kFftLog2; ++stage)
+        {
+            const uint16_t span = 1 << stage;
+            const uint16_t half = span >> 1;
+            const uint16_t twiddleStep = kAudioBlockSize >> stage;
+            for (uint16_t base = 0; base < kAudioBlockSize; base += span)
+            {
+                for (uint16_t k = 0; k < half; ++k)
+                {
+                    const int16_t wr = _cosTable[k * twiddleStep];
+                    const int16_t wi = -_sinTable[k * twiddleStep];
+                    const uint16_t top = base + k;
+                    const uint16_t bottom = top + half;
+
+                    const int32_t tr = MultiplyQ15(_re[bottom], wr) - MultiplyQ15(_im[bottom], wi);
+                    const int32_t ti = MultiplyQ15(_re[bottom], wi) + MultiplyQ15(_im[bottom], wr);
+                    const int32_t ur = _re[top];
+                    const int32_t ui = _im[top];
+
+                    _re[top]    = static_cast<int16_t>((ur + tr) >> 1);
+                    _im[top]    = static_cast<int16_t>((ui + ti) >> 1);
+                    _re[bottom] = static_cast<int16_t>((ur - tr) >> 1);
+                    _im[bottom] = static_cast<int16_t>((ui - ti) >> 1);
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Clock sync
+//
+// Cabinets standing side by side share one show clock.  One of them is the master and simply runs on its own
+// millis(); the followers exchange NTP-style timestamps with it over UDP once a second, keep the exchange with
+// the shortest round trip out of the last few, track the drift between the two crystals and slew their show
+// clock offset onto the master's.  The master also hands out a show epoch and effect seed, and every cabinet
+// restarts its effects at that epoch, so the mode rotation lines up as well as beat8/beatsin8.
+//
+// Every cabinet with sync enabled answers requests, which is what tools/syncprobe.py uses to measure the phase
+// error between cabinets from a PC.
+
+enum class ClockSyncRole : uint8_t
+{
+    Off = 0,
+    Master,
+    Follower,
+    Count
+};
+
+constexpr uint16_t kClockSyncPort      = 4210;
+constexpr uint32_t kClockSyncStackSize = 4096;
+
+void BeginClockSync();
+bool SetClockSyncRole(ClockSyncRole role);
+bool FindClockSyncRole(const char * pszName, ClockSyncRole & role);
+bool RestartSyncedShow();
+void ReportClockSyncStats();
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+#include <type_traits>
+#include "RemoteDebug.h"
+
+// Deferred logging
+//
+// debugI/debugW format the message and write it to Serial and telnet on the calling task, which can take
+// milliseconds when a telnet client is slow.  logI/logW only copy the format pointer and up to kMaxLogArgs
+// word-sized arguments into a ring; the debug task formats and prints them later.
+//
+// The format must be a string literal, and a %s argument must point at storage that outlives the call (a
+// literal or a static table) because only the pointer is kept.  Integers, enums and pointers are accepted;
+// anything else fails to compile.  When the ring is full new records are dropped and counted.
+
+constexpr uint8_t kMaxLogArgs = 6;
+
+template <typename T>
+typename std::enable_if<std::is_pointer<T>::value, uint32_t>::type ToLogWord(T value)
+{
+    return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(value));
+}
+
+template <typename T>
+typename std::enable_if<!std::is_pointer<T>::value, uint32_t>::type ToLogWord(T value)
+{
+    static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "Deferred log arguments must be integers, enums or pointers to static strings");
+    static_assert(sizeof(T) <= sizeof(uint32_t), "Deferred log arguments must fit in 32 bits");
+    return static_cast<uint32_t>(value);
+}
+
+void PostLogRecord(uint8_t level, const char * pszFunction, const char * pszFormat, uint8_t argCount, const uint32_t * pArgs);
+
+template <typename... Args>
+void DeferLog(uint8_t level, const char * pszFunction, const char * pszFormat, Args... args)
+{
+    static_assert(sizeof...(Args) <= kMaxLogArgs, "Too many arguments for a deferred log record");
+    const uint32_t words[kMaxLogArgs + 1] = { ToLogWord(args)... };     // One spare so zero arguments compiles
+    PostLogRecord(level, pszFunction, pszFormat, sizeof...(Args), words);
+}
+
+#define logI(fmt, ...) DeferLog(RemoteDebug::INFO, __func__, fmt, ##__VA_ARGS__)
+#define logW(fmt, ...) DeferLog(RemoteDebug::WARNING, __func__, fmt, ##__VA_ARGS__)
+
+void DrainDeferredLog();
+void ReportDeferredLogStats();
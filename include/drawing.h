@@ -1,17 +1,60 @@
 #pragma once
 
-void IRAM_ATTR DrawLoopTaskEntryOne(void *);
-void IRAM_ATTR DrawLoopTaskEntryTwo(void *);
-void IRAM_ATTR DrawLoopTaskEntryThree(void *);
-void IRAM_ATTR DrawLoopTaskEntryFour(void *);
+constexpr uint32_t kEffectBakeStackSize = 4096;
+
+void IRAM_ATTR DrawLoopTaskEntry(void *);
 void ColorFillEffect(CRGB color, int nrOfLeds, int everyNth);
 void Heartbeat(int channel);
 void TheMachineLogo(CRGB color);
 void TheBride(CRGB color);
 void SingleLed(int index, CRGB color);
 void Eyes(CRGB color);
+uint32_t ShowBootScene();
 void FlickerSpotlight(uint8_t index, const CRGB & color);
 void FlickerSpotlights(uint8_t indexA, uint8_t indexB, const CRGB & color);
+bool RequestEffectBake(const char * pszName, uint32_t seconds, uint16_t seed);
+bool RequestEffectFingerprint(uint16_t seed);
+bool RequestShowRestart(uint32_t epochMs, uint32_t seed);
+
+// Named parts of the backglass artwork that can be filled with a single color
+enum class LedZone : uint8_t
+{
+    Jackpot = 0,
+    Eyes,
+    Heart,
+    Machine,
+    Shuttle,
+    Street,
+    Planets,
+    Bride,
+    Count
+};
+
+// Effects that can be started on demand instead of waiting for their timer
+enum class EffectTrigger : uint8_t
+{
+    GlobalHeart = 0,
+    NextJackpotMode,
+    NextMachineMode,
+    NextShuttleMode,
+    Count
+};
+
+bool FillZoneBuffers(LedZone zone, CRGB * pLeds0, CRGB * pLeds1, const CRGB & color);
+bool TriggerEffect(EffectTrigger trigger);
+void WakeDrawLoop();
+void ReportDrawTiming();
+
+// Draw counters for clients that watch the frame rate, such as tools/loadreplay.py
+struct DrawStats
+{
+    uint32_t frames;            // FastLED.show() calls since boot
+    uint32_t showAvgUs;
+    uint32_t passAvgUs;         // Zone steps plus show, see the frame governor
+    uint32_t overruns;
+};
+
+void GetDrawStats(DrawStats & stats);
 
 #define moonTopLeft 2
 #define fronthead 4
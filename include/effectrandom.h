@@ -0,0 +1,63 @@
+#pragma once
+
+// EffectRandom
+//
+// A small xorshift32 generator that each effect owns, so effects no longer share FastLED's random8 state and
+// a run can be reproduced from its seed.  The helpers mirror random8/random16 so call sites read the same.
+//
+// Like framefile.h this depends only on the C standard headers, so host-side tools can reproduce a stream.
+
+#include <stdint.h>
+
+class EffectRandom
+{
+  public:
+
+    explicit EffectRandom(uint32_t seed = 1)
+    {
+        Seed(seed);
+    }
+
+    // Seed
+    //
+    // xorshift has a single fixed point at zero, so a zero seed is replaced with a non-zero constant
+
+    void Seed(uint32_t seed)
+    {
+        _state = seed ? seed : 0x9E3779B9;
+    }
+
+    uint32_t Next()
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return _state;
+    }
+
+    uint8_t Random8()
+    {
+        return static_cast<uint8_t>(Next() >> 24);
+    }
+
+    // Returns a value in [0, lim)
+    uint8_t Random8(uint8_t lim)
+    {
+        return static_cast<uint8_t>((Random8() * lim) >> 8);
+    }
+
+    // Returns a value in [min, lim)
+    uint8_t Random8(uint8_t min, uint8_t lim)
+    {
+        return min + Random8(lim - min);
+    }
+
+    uint16_t Random16()
+    {
+        return static_cast<uint16_t>(Next() >> 16);
+    }
+
+  private:
+
+    uint32_t _state;
+};
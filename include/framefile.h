@@ -0,0 +1,198 @@
+#pragma once
+
+// Frame file format
+//
+// A frame file is a fixed header followed by frameCount frames.  The header lists up to kMaxFrameSpans spans,
+// each a run of LEDs on one channel (0 = leds0, 1 = leds1).  A raw frame is simply the pixels of every span, in
+// header order, as 3 bytes per LED in the same R,G,B order as CRGB so playback can read straight into the LED
+// buffers.  A DeltaRle frame is a uint16_t byte count followed by run tokens against the previous frame:
+//
+//   0x00-0x7F  literal run, (token + 1) pixels of R,G,B follow
+//   0x80-0xFF  skip run, (token & 0x7F) + 1 pixels are unchanged from the previous frame
+//
+// The first frame of a DeltaRle file is always encoded without a previous frame, so it only holds literal runs
+// and a looping player can restart from it at any time.  All fields are little-endian.
+//
+// This header deliberately depends on nothing but the C standard headers so that the same definitions can be
+// used by host-side tools to produce and verify recordings.
+
+#include <stdint.h>
+#include <stddef.h>
+
+constexpr uint32_t kFrameFileMagic      = 0x4644454C;  // "LEDF"
+constexpr uint16_t kFrameFileVersion    = 1;
+constexpr uint8_t  kMaxFrameSpans       = 4;
+constexpr uint8_t  kFrameFileBytesPerLed = 3;
+constexpr uint16_t kFrameFileFlagLoop   = 0x0001;       // Last frame flows back into the first one
+constexpr uint8_t  kFrameRunMax         = 128;
+constexpr uint8_t  kFrameSkipToken      = 0x80;
+
+enum class FrameEncoding : uint8_t
+{
+    Raw = 0,
+    DeltaRle,
+    Count
+};
+
+struct FrameFileSpan
+{
+    uint8_t  channel;
+    uint8_t  reserved;
+    uint16_t firstLed;
+    uint16_t ledCount;
+};
+
+struct FrameFileHeader
+{
+    uint32_t      magic;
+    uint16_t      version;
+    uint8_t       encoding;
+    uint8_t       spanCount;
+    uint16_t      frameIntervalMs;
+    uint16_t      flags;
+    uint32_t      frameCount;
+    FrameFileSpan spans[kMaxFrameSpans];
+};
+
+static_assert(sizeof(FrameFileSpan) == 6, "FrameFileSpan must stay 6 bytes, it is written to flash as-is");
+static_assert(sizeof(FrameFileHeader) == 40, "FrameFileHeader must stay 40 bytes, it is written to flash as-is");
+
+inline void InitFrameFileHeader(FrameFileHeader & header, uint16_t frameIntervalMs, FrameEncoding encoding = FrameEncoding::Raw)
+{
+    header = FrameFileHeader{};
+    header.magic = kFrameFileMagic;
+    header.version = kFrameFileVersion;
+    header.encoding = static_cast<uint8_t>(encoding);
+    header.frameIntervalMs = frameIntervalMs;
+}
+
+inline bool AddFrameFileSpan(FrameFileHeader & header, uint8_t channel, uint16_t firstLed, uint16_t ledCount)
+{
+    if (header.spanCount >= kMaxFrameSpans || ledCount == 0)
+        return false;
+
+    FrameFileSpan & span = header.spans[header.spanCount++];
+    span.channel = channel;
+    span.reserved = 0;
+    span.firstLed = firstLed;
+    span.ledCount = ledCount;
+    return true;
+}
+
+inline size_t FrameFilePixelsPerFrame(const FrameFileHeader & header)
+{
+    size_t pixels = 0;
+    for (uint8_t i = 0; i < header.spanCount && i < kMaxFrameSpans; ++i)
+        pixels += header.spans[i].ledCount;
+    return pixels;
+}
+
+inline size_t FrameFileRawFrameBytes(const FrameFileHeader & header)
+{
+    return FrameFilePixelsPerFrame(header) * kFrameFileBytesPerLed;
+}
+
+// IsValidFrameFileHeader
+//
+// Checks the magic, version and encoding, and that every span fits inside the channel it targets.  channelSizes
+// holds the LED count of each channel the caller can draw to.
+
+inline bool IsValidFrameFileHeader(const FrameFileHeader & header, const uint16_t * channelSizes, uint8_t channelCount)
+{
+    if (header.magic != kFrameFileMagic || header.version != kFrameFileVersion)
+        return false;
+    if (header.encoding >= static_cast<uint8_t>(FrameEncoding::Count))
+        return false;
+    if (header.spanCount == 0 || header.spanCount > kMaxFrameSpans || header.frameIntervalMs == 0)
+        return false;
+
+    for (uint8_t i = 0; i < header.spanCount; ++i)
+    {
+        const FrameFileSpan & span = header.spans[i];
+        if (span.channel >= channelCount || span.ledCount == 0)
+            return false;
+        if (static_cast<uint32_t>(span.firstLed) + span.ledCount > channelSizes[span.channel])
+            return false;
+    }
+    return true;
+}
+
+// FrameFileMaxEncodedBytes
+//
+// Upper bound on a DeltaRle frame, excluding its length prefix.  Every token covers at least one pixel and
+// costs one byte, so a frame can never exceed four bytes per pixel.
+
+inline size_t FrameFileMaxEncodedBytes(size_t pixelCount)
+{
+    return pixelCount * (kFrameFileBytesPerLed + 1);
+}
+
+// EncodeDeltaRleFrame
+//
+// Encodes pixelCount pixels from pCurrent against pPrevious (or as a key frame when pPrevious is null) into
+// pOut, returning the number of bytes written, or 0 if cbOut is too small.
+
+inline size_t EncodeDeltaRleFrame(const uint8_t * pPrevious, const uint8_t * pCurrent, size_t pixelCount, uint8_t * pOut, size_t cbOut)
+{
+    size_t cbWritten = 0;
+    size_t pixel = 0;
+
+    auto samePixel = [&](size_t i) {
+        return pPrevious != nullptr
+            && pPrevious[i * kFrameFileBytesPerLed] == pCurrent[i * kFrameFileBytesPerLed]
+            && pPrevious[i * kFrameFileBytesPerLed + 1] == pCurrent[i * kFrameFileBytesPerLed + 1]
+            && pPrevious[i * kFrameFileBytesPerLed + 2] == pCurrent[i * kFrameFileBytesPerLed + 2];
+    };
+
+    while (pixel < pixelCount)
+    {
+        const bool bSkip = samePixel(pixel);
+        size_t run = 1;
+        while (pixel + run < pixelCount && run < kFrameRunMax && samePixel(pixel + run) == bSkip)
+            ++run;
+
+        const size_t cbToken = 1 + (bSkip ? 0 : run * kFrameFileBytesPerLed);
+        if (cbWritten + cbToken > cbOut)
+            return 0;
+
+        pOut[cbWritten++] = static_cast<uint8_t>((bSkip ? kFrameSkipToken : 0) | (run - 1));
+        if (!bSkip)
+        {
+            for (size_t i = 0; i < run * kFrameFileBytesPerLed; ++i)
+                pOut[cbWritten++] = pCurrent[pixel * kFrameFileBytesPerLed + i];
+        }
+        pixel += run;
+    }
+    return cbWritten;
+}
+
+// DecodeDeltaRleFrame
+//
+// Applies an encoded frame on top of pPixels, which must hold the previous frame.  Returns false if the data
+// is truncated or would write past pixelCount.
+
+inline bool DecodeDeltaRleFrame(const uint8_t * pIn, size_t cbIn, uint8_t * pPixels, size_t pixelCount)
+{
+    size_t pixel = 0;
+    size_t offset = 0;
+
+    while (offset < cbIn)
+    {
+        const uint8_t token = pIn[offset++];
+        const size_t run = (token & (kFrameSkipToken - 1)) + 1;
+        if (pixel + run > pixelCount)
+            return false;
+
+        if (0 == (token & kFrameSkipToken))
+        {
+            const size_t cbRun = run * kFrameFileBytesPerLed;
+            if (offset + cbRun > cbIn)
+                return false;
+            for (size_t i = 0; i < cbRun; ++i)
+                pPixels[pixel * kFrameFileBytesPerLed + i] = pIn[offset + i];
+            offset += cbRun;
+        }
+        pixel += run;
+    }
+    return pixel == pixelCount;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+#include "framefile.h"
+
+// Frame store
+//
+// Records the frames the draw task shows to a frame file on SPIFFS and streams it back later.  Only one
+// recording or playback runs at a time; while a playback is active the live effects are paused and the draw
+// task shows the frames playback hands it.
+//
+// WriteFrameFile produces a DeltaRle file from a render callback rather than from the live output, and is what
+// the animation baker uses to store precomputed effects.
+
+constexpr uint16_t kDefaultRecordIntervalMs = 20;
+constexpr uint32_t kFrameStoreStackSize     = 4096;
+
+// Fills pPixels with the pixels of every span in the layout, in order, for the given frame
+using FrameRenderFunction = std::function<void(uint32_t frame, uint8_t * pPixels)>;
+
+bool BeginFrameStorage();
+bool StartFrameRecording(const char * pszName, uint32_t durationMs, uint16_t frameIntervalMs = kDefaultRecordIntervalMs);
+bool StartFramePlayback(const char * pszName, bool bLoop);
+void StopFrameStore();
+bool IsFramePlaybackActive();
+bool IsFrameStoreBusy();
+bool WriteFrameFile(const char * pszName, const FrameFileHeader & layout, uint32_t frameCount, const FrameRenderFunction & renderFrame);
+
+// Used by the draw task only
+
+bool TakePlaybackFrame();
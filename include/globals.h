@@ -3,13 +3,22 @@
 #define ENABLE_OTA 1
 #define ENABLE_WIFI 1
 #define ENABLE_WEBSERVER 1
+#define ENABLE_INPUT 1                  // Pinball event inputs on GPIO 34, 35, 32 and 27
+#define ENABLE_POWERSAVE 1              // Slow down after a minute without commands or input
+#define ENABLE_CLOCKSYNC 1              // Share a show clock with other cabinets over UDP, off until 'sync master/follower'
+#define ENABLE_AUDIO 0                  // Needs an I2S MEMS microphone (INMP441 or similar) on the pins below
+#define ENABLE_IRAM_RENDER 1            // Run the effects from IRAM and keep their tables in DRAM, see HOT_RENDER
+
+#define AUDIO_I2S_SCK 26
+#define AUDIO_I2S_WS  25
+#define AUDIO_I2S_SD  33
 
 #define STACK_SIZE (ESP_TASK_MAIN_STACK) // Stack size for each new thread
 
 #define NUM_CHANNELS 2
 
 #define LED_PIN0 14 // been
-#define NUM_LEDS0 8*6 + 4 + 1 // been + ogen + hart (hart is laatste ledje)
+#define NUM_LEDS0 (8*6 + 4 + 1) // been + ogen + hart (hart is laatste ledje)
 
 #define LED_PIN1 12 // overig
 #define NUM_LEDS1 121 // overig
@@ -38,6 +47,21 @@
 #include <FastLED.h>                // FastLED for the LED panels
 #include "RemoteDebug.h"
 
+// Hot render path placement
+//
+// Code and const tables normally execute from flash through the cache, and a miss stalls the core until the
+// line is fetched.  Flash writes (NVS, SPIFFS, OTA) disable the cache and throw away what was in it, so the
+// first frames after a write pay for refilling it.  HOT_RENDER puts a function in IRAM and HOT_RENDER_DATA puts
+// a table in DRAM, for what the draw task runs on every frame.  IRAM is scarce: mark only the per-frame path,
+// and turn ENABLE_IRAM_RENDER off to compare against the flash build with the "profile" console command.
+#if ENABLE_IRAM_RENDER
+    #define HOT_RENDER      IRAM_ATTR
+    #define HOT_RENDER_DATA DRAM_ATTR
+#else
+    #define HOT_RENDER
+    #define HOT_RENDER_DATA
+#endif
+
 extern RemoteDebug Debug;           // Let everyone in the project know about it.  If you don't have it, delete this
 extern CRGB leds0[];    // been
 extern CRGB leds1[];    // overig
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <FastLED.h>
+#include <stdint.h>
+
+// Heartbeat
+//
+// The double-thump brightness curve of the heart, which also drives the pulse effects when there is no live
+// audio.  It follows beat8, so it reads the show clock on the cabinet and whatever clock a host tool provides.
+//
+// HOT_RENDER and HOT_RENDER_DATA come from globals.h, which the firmware always includes first; host tools get
+// plain code and data.
+
+#ifndef HOT_RENDER
+    #define HOT_RENDER
+#endif
+#ifndef HOT_RENDER_DATA
+    #define HOT_RENDER_DATA
+#endif
+
+HOT_RENDER_DATA const uint8_t kHeartbeatTable[] = {
+    25,  61, 105, 153, 197, 233, 253, 255,
+    252, 243, 230, 213, 194, 149, 101, 105,
+    153, 197, 216, 233, 244, 253, 255, 255,
+    252, 249, 243, 237, 230, 223, 213, 206,
+    194, 184, 174, 162, 149, 138, 126, 112,
+    101,  91,  78,  69,  62,  58,  51,  47,
+     43,  39,  37,  35,  29,  25,  22,  20,
+     19,  15,  12,   9,   8,   6,   5,   3
+};
+
+constexpr uint8_t HeartbeatTableSize()
+{
+    return static_cast<uint8_t>(sizeof(kHeartbeatTable) / sizeof(kHeartbeatTable[0]));
+}
+
+inline uint8_t HOT_RENDER GetHeartbeatBrightness(uint8_t bpm = 35)
+{
+    const uint8_t steps = HeartbeatTableSize();
+    const uint8_t hbIndex = lerp8by8(0, steps, beat8(bpm));
+    return lerp8by8(0, 255, kHeartbeatTable[hbIndex]);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Pinball event input
+//
+// Lamp, solenoid and switch signals from the machine arrive on GPIO interrupts and are queued, with their
+// timestamp, in a single-producer single-consumer ring that needs no locks.  The draw task drains the ring at the
+// start of every pass and maps events to effect triggers through a rule table, then reports how long it took
+// from the edge to the frame that showed the result.
+//
+// Only one event source feeds the ring at a time: the GPIO interrupts normally, or a recorded trace from SPIFFS
+// while one is being replayed, so trigger-to-frame latency can be measured without the machine.
+
+enum class PinballEvent : uint8_t
+{
+    Jackpot = 0,
+    Drain,
+    Multiball,
+    Tilt,
+    Count
+};
+
+constexpr uint32_t kInputTraceStackSize = 3072;
+
+void BeginInput();
+void PostInputEvent(PinballEvent event, uint32_t timestampUs);
+bool StartInputTrace(const char * pszName);
+void ProcessInputEvents();
+void CompleteInputFrame();
+void ReportInputStats();
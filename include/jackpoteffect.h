@@ -0,0 +1,576 @@
+#pragma once
+
+#include <FastLED.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "ledspan.h"
+#include "particles.h"
+#include "effectrandom.h"
+#include "palettetheme.h"
+#include "heartbeat.h"
+
+// JackpotEffect
+//
+// The rotation of modes on the jackpot bar.  Everything it draws comes from the palette, pulse, random stream
+// and particle layer it is constructed with and the show time it is stepped with, and like the rest of the
+// headers it includes it needs nothing but FastLED.  The cabinet and tools/effectcheck.cpp therefore render the
+// very same frames, which is what lets the "fingerprint" console command check the cabinet against the golden
+// hashes the host tool generates into jackpotgoldens.h.
+
+constexpr uint8_t  kJackpotSegments          = 8;
+constexpr uint8_t  kJackpotLedsPerSegment    = 6;
+constexpr uint8_t  kJackpotLedCount          = kJackpotSegments * kJackpotLedsPerSegment;
+constexpr uint8_t  kJackpotDimScale          = 80;
+constexpr uint32_t kJackpotModeDurationMs    = 15000;
+constexpr uint32_t kJackpotDimmedDurationMs  = 60000;
+constexpr uint32_t kJackpotClassicIntervalMs = 220;
+constexpr uint32_t kJackpotFillIntervalMs    = 180;
+constexpr uint32_t kJackpotChaseIntervalMs   = 140;
+constexpr uint32_t kJackpotMeteorIntervalMs  = 90;
+constexpr uint32_t kJackpotRainbowIntervalMs = 240;     // Blended modes step coarsely and the blender fills in
+constexpr uint32_t kJackpotSparkleIntervalMs = 110;
+constexpr uint32_t kJackpotPulseIntervalMs   = 100;
+constexpr uint32_t kJackpotPlasmaIntervalMs  = 180;
+constexpr uint32_t kJackpotDimmedIntervalMs  = 1000;
+
+enum class JackpotMode : uint8_t
+{
+    Classic = 0,
+    AlternatingFill,
+    DualChase,
+    Meteor,
+    RainbowSweep,
+    Sparkle,
+    Pulse,
+    Plasma,
+    DimmedHold,
+    Count
+};
+
+struct JackpotRuntime
+{
+    JackpotMode mode = JackpotMode::Classic;
+    uint32_t modeStart = 0;
+    uint32_t nextFrame = 0;
+    uint32_t frameInterval = kJackpotClassicIntervalMs;
+    uint32_t modeDuration = kJackpotModeDurationMs;
+    uint8_t step = 0;
+    uint8_t secondary = 0;
+    bool forward = true;
+    uint8_t hueBase = 0;
+    bool dimOutput = true;
+};
+
+template <size_t ParticleCapacity>
+class JackpotEffect
+{
+  public:
+
+    using PaletteFunction = const CRGB * (*)();
+    using PulseFunction   = uint8_t (*)(uint8_t bpm);
+
+    // The part of the effect that changes as it runs, for callers that borrow the effect and put it back
+    struct State
+    {
+        JackpotRuntime runtime;
+        CRGB frame[kJackpotLedCount];
+    };
+
+    JackpotEffect(ParticlePool<ParticleCapacity> * pParticles, uint8_t particleLayer, const CRGB * pParticleLeds,
+                  EffectRandom * pRandom, PaletteFunction pfnPalette, PulseFunction pfnPulse)
+        : _pParticles(pParticles), _particleLayer(particleLayer), _pParticleLeds(pParticleLeds),
+          _pRandom(pRandom), _pfnPalette(pfnPalette), _pfnPulse(pfnPulse)
+    {
+    }
+
+    JackpotMode mode() const
+    {
+        return _runtime.mode;
+    }
+
+    uint32_t frameInterval() const
+    {
+        return _runtime.frameInterval;
+    }
+
+    uint32_t nextFrame() const
+    {
+        return _runtime.nextFrame;
+    }
+
+    void SaveState(State & state) const
+    {
+        state.runtime = _runtime;
+        memcpy(state.frame, _frame, sizeof(_frame));
+    }
+
+    void LoadState(const State & state)
+    {
+        _runtime = state.runtime;
+        memcpy(_frame, state.frame, sizeof(_frame));
+    }
+
+    static JackpotMode NextMode(JackpotMode mode)
+    {
+        auto next = static_cast<uint8_t>(mode) + 1;
+        const auto maxModes = static_cast<uint8_t>(JackpotMode::Count);
+        if (next >= maxModes)
+            next = 0;
+        return static_cast<JackpotMode>(next);
+    }
+
+    // ModeInterpolates
+    //
+    // Slow modes are crossfaded between their steps.  Fast or sparkly ones lose their snap if they are blended,
+    // and Pulse, which follows the heartbeat and the audio beat, would trail the beat by an interval.
+
+    static bool ModeInterpolates(JackpotMode mode)
+    {
+        switch (mode)
+        {
+            case JackpotMode::Classic:
+            case JackpotMode::AlternatingFill:
+            case JackpotMode::RainbowSweep:
+            case JackpotMode::Plasma:
+            case JackpotMode::DimmedHold:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void Reset(JackpotMode mode, uint32_t now)
+    {
+        _pParticles->ClearLayer(_particleLayer);
+        _runtime = JackpotRuntime{};
+        _runtime.mode = mode;
+        _runtime.modeStart = now;
+        _runtime.nextFrame = now;
+        _runtime.frameInterval = IntervalForMode(mode);
+        _runtime.modeDuration = DurationForMode(mode);
+        _runtime.dimOutput = true;
+
+        bool shouldClear = true;
+        switch (mode)
+        {
+            case JackpotMode::Classic:
+                _runtime.step = 0;
+                _runtime.secondary = kJackpotSegments;
+                _runtime.forward = true;
+                break;
+            case JackpotMode::AlternatingFill:
+                _runtime.step = 0;
+                _runtime.secondary = 0;
+                _runtime.dimOutput = false;
+                break;
+            case JackpotMode::DualChase:
+                _runtime.step = 0;
+                _runtime.secondary = kJackpotLedCount - 1;
+                _runtime.dimOutput = false;
+                break;
+            case JackpotMode::Meteor:
+                _runtime.step = 0;
+                break;
+            case JackpotMode::RainbowSweep:
+                _runtime.hueBase = 0;
+                break;
+            case JackpotMode::Plasma:
+                _runtime.step = 0;
+                _runtime.hueBase = 0;
+                break;
+            case JackpotMode::DimmedHold:
+                ApplyDefaultColors();
+                _runtime.step = 0;
+                shouldClear = false;
+                break;
+            case JackpotMode::Sparkle:
+            case JackpotMode::Pulse:
+            default:
+                break;
+        }
+
+        if (shouldClear)
+        {
+            ClearRange();
+        }
+    }
+
+    // Advance
+    //
+    // Rotates the mode and steps the current one when its frame is due.  Returns true if the frame changed.
+
+    bool HOT_RENDER Advance(uint32_t now)
+    {
+        if (_runtime.modeStart == 0)
+        {
+            Reset(_runtime.mode, now);
+        }
+
+        if (now - _runtime.modeStart >= _runtime.modeDuration)
+        {
+            Reset(NextMode(_runtime.mode), now);
+        }
+
+        if (now < _runtime.nextFrame)
+        {
+            return false;
+        }
+
+        StepCurrentMode();
+        _runtime.nextFrame = now + _runtime.frameInterval;
+        return true;
+    }
+
+    void HOT_RENDER Compose(LedSpan<kJackpotLedCount> out, bool bHighlightActive) const
+    {
+        if (bHighlightActive || _runtime.dimOutput)
+        {
+            for (size_t i = 0; i < kJackpotLedCount; ++i)
+            {
+                out[i] = _frame[i];
+                out[i].nscale8_video(kJackpotDimScale);
+            }
+        }
+        else
+        {
+            memcpy(out.begin(), _frame, sizeof(_frame));
+        }
+    }
+
+  private:
+
+    ParticlePool<ParticleCapacity> * _pParticles;
+    uint8_t                          _particleLayer;
+    const CRGB *                     _pParticleLeds;
+    EffectRandom *                   _pRandom;
+    PaletteFunction                  _pfnPalette;
+    PulseFunction                    _pfnPulse;
+    JackpotRuntime                   _runtime;
+    CRGB                             _frame[kJackpotLedCount] = {};
+
+    static uint32_t IntervalForMode(JackpotMode mode)
+    {
+        switch (mode)
+        {
+            case JackpotMode::Classic:
+                return kJackpotClassicIntervalMs;
+            case JackpotMode::AlternatingFill:
+                return kJackpotFillIntervalMs;
+            case JackpotMode::DualChase:
+                return kJackpotChaseIntervalMs;
+            case JackpotMode::Meteor:
+                return kJackpotMeteorIntervalMs;
+            case JackpotMode::RainbowSweep:
+                return kJackpotRainbowIntervalMs;
+            case JackpotMode::Sparkle:
+                return kJackpotSparkleIntervalMs;
+            case JackpotMode::Pulse:
+                return kJackpotPulseIntervalMs;
+            case JackpotMode::Plasma:
+                return kJackpotPlasmaIntervalMs;
+            case JackpotMode::DimmedHold:
+                return kJackpotDimmedIntervalMs;
+            default:
+                return kJackpotClassicIntervalMs;
+        }
+    }
+
+    static uint32_t DurationForMode(JackpotMode mode)
+    {
+        if (mode == JackpotMode::DimmedHold)
+        {
+            return kJackpotDimmedDurationMs;
+        }
+        return kJackpotModeDurationMs;
+    }
+
+    LedSpan<kJackpotLedCount> FrameSpan()
+    {
+        return SpanOf(_frame);
+    }
+
+    void HOT_RENDER FillSegment(uint8_t segment, const CRGB & color)
+    {
+        FillSpan(LedSpan<kJackpotLedsPerSegment>(&_frame[segment * kJackpotLedsPerSegment]), color);
+    }
+
+    void HOT_RENDER ClearRange()
+    {
+        FillSpan(FrameSpan(), CRGB::Black);
+    }
+
+    bool HOT_RENDER EmitParticle(uint8_t led, int16_t velocity, const CRGB & color, uint16_t lifeMs)
+    {
+        return _pParticles->Emit(_particleLayer, static_cast<uint16_t>(led << 8), velocity, color, lifeMs);
+    }
+
+    void HOT_RENDER AddParticles()
+    {
+        for (size_t i = 0; i < kJackpotLedCount; ++i)
+            _frame[i] += _pParticleLeds[i];
+    }
+
+    void ApplyDefaultColors()
+    {
+        const CRGB * pPalette = _pfnPalette();
+        for (uint8_t segment = 0; segment < kJackpotSegments; ++segment)
+        {
+            const CRGB color = pPalette[(segment < (kJackpotSegments / 2)) ? kPaletteSecondary : kPalettePrimary];
+            FillSegment(segment, color);
+        }
+    }
+
+    void HOT_RENDER StepClassic()
+    {
+        if (_runtime.secondary < kJackpotSegments && _runtime.secondary != _runtime.step)
+        {
+            FillSegment(_runtime.secondary, CRGB::Black);
+        }
+        FillSegment(_runtime.step, _pfnPalette()[kPalettePrimary]);
+        _runtime.secondary = _runtime.step;
+
+        if (_runtime.forward)
+        {
+            if (_runtime.step >= kJackpotSegments - 1)
+            {
+                _runtime.forward = false;
+                if (kJackpotSegments > 1)
+                    _runtime.step = kJackpotSegments - 2;
+            }
+            else
+            {
+                ++_runtime.step;
+            }
+        }
+        else
+        {
+            if (_runtime.step == 0 || kJackpotSegments == 1)
+            {
+                _runtime.forward = true;
+                if (kJackpotSegments > 1)
+                    _runtime.step = 1;
+            }
+            else
+            {
+                --_runtime.step;
+            }
+        }
+    }
+
+    void HOT_RENDER StepAlternatingFill()
+    {
+        static HOT_RENDER_DATA const uint8_t slots[] = { kPaletteSecondary, kPaletteHighlight, kPalettePrimary };
+        constexpr size_t paletteSize = sizeof(slots) / sizeof(slots[0]);
+
+        FillSegment(_runtime.step, _pfnPalette()[slots[_runtime.secondary]]);
+        ++_runtime.step;
+
+        if (_runtime.step >= kJackpotSegments)
+        {
+            _runtime.step = 0;
+            _runtime.secondary = static_cast<uint8_t>((_runtime.secondary + 1) % paletteSize);
+            if (_runtime.secondary == 0)
+            {
+                ClearRange();
+            }
+        }
+    }
+
+    void HOT_RENDER StepDualChase()
+    {
+        ClearRange();
+        uint8_t left = _runtime.step;
+        uint8_t right = _runtime.secondary;
+        const CRGB * pPalette = _pfnPalette();
+        if (left < kJackpotLedCount)
+            _frame[left] = pPalette[kPaletteAccentA];
+        if (right < kJackpotLedCount)
+            _frame[right] = pPalette[kPaletteAccentB];
+
+        if (left >= right || right == 0)
+        {
+            _runtime.step = 0;
+            _runtime.secondary = kJackpotLedCount - 1;
+        }
+        else
+        {
+            ++_runtime.step;
+            --_runtime.secondary;
+        }
+    }
+
+    // The meteor is one particle moving a LED per step; the trail is the frame fading behind it, and the head
+    // burns down to half brightness by the time it leaves the bar
+
+    void HOT_RENDER StepMeteor()
+    {
+        constexpr uint8_t trailDecay = 70;
+        constexpr int16_t meteorVelocity = 256 * 16 / kJackpotMeteorIntervalMs;
+        constexpr uint16_t meteorLifeMs = 2 * kJackpotLedCount * kJackpotMeteorIntervalMs;
+        const int totalSteps = kJackpotLedCount + kJackpotLedsPerSegment;
+
+        if (_runtime.step == 0)
+            EmitParticle(0, meteorVelocity, _pfnPalette()[kPaletteCool], meteorLifeMs);
+
+        FadeSpanToBlackBy(FrameSpan(), trailDecay);
+        AddParticles();
+        ++_runtime.step;
+        if (_runtime.step >= totalSteps)
+        {
+            _runtime.step = 0;
+        }
+    }
+
+    void HOT_RENDER StepRainbowSweep()
+    {
+        FillSpanFromPalette(FrameSpan(), _pfnPalette(), _runtime.hueBase, 4);
+        _runtime.hueBase += 6;
+    }
+
+    void HOT_RENDER StepSparkle()
+    {
+        constexpr uint8_t sparkleCount = 5;
+        constexpr uint16_t sparkleLifeMs = 700;
+        const CRGB * pPalette = _pfnPalette();
+        for (uint8_t i = 0; i < sparkleCount; ++i)
+        {
+            const uint8_t led = _pRandom->Random8(kJackpotLedCount);
+            EmitParticle(led, 0, pPalette[_pRandom->Random8()], sparkleLifeMs);
+        }
+
+        ClearRange();
+        AddParticles();
+    }
+
+    void HOT_RENDER StepPulse()
+    {
+        CRGB color = _pfnPalette()[kPaletteHighlight];
+        color.nscale8_video(_pfnPulse(28));
+        FillSpan(FrameSpan(), color);
+    }
+
+    void HOT_RENDER StepPlasma()
+    {
+        const CRGB * pPalette = _pfnPalette();
+        for (size_t i = 0; i < kJackpotLedCount; ++i)
+        {
+            const uint8_t waveA = sin8(_runtime.hueBase + i * 8);
+            const uint8_t waveB = sin8(_runtime.step + i * 16);
+            const uint8_t blend = qadd8(waveA, waveB) / 2;
+            _frame[i] = pPalette[static_cast<uint8_t>(waveA + _runtime.hueBase)];
+            _frame[i].nscale8_video(blend);
+        }
+
+        _runtime.hueBase += 6;
+        _runtime.step += 10;
+    }
+
+    void HOT_RENDER StepDimmedHold()
+    {
+        if (_runtime.step == 0)
+        {
+            ApplyDefaultColors();
+            _runtime.step = 1;
+        }
+    }
+
+    void HOT_RENDER StepCurrentMode()
+    {
+        switch (_runtime.mode)
+        {
+            case JackpotMode::Classic:
+                StepClassic();
+                break;
+            case JackpotMode::AlternatingFill:
+                StepAlternatingFill();
+                break;
+            case JackpotMode::DualChase:
+                StepDualChase();
+                break;
+            case JackpotMode::Meteor:
+                StepMeteor();
+                break;
+            case JackpotMode::RainbowSweep:
+                StepRainbowSweep();
+                break;
+            case JackpotMode::Sparkle:
+                StepSparkle();
+                break;
+            case JackpotMode::Pulse:
+                StepPulse();
+                break;
+            case JackpotMode::Plasma:
+                StepPlasma();
+                break;
+            case JackpotMode::DimmedHold:
+                StepDimmedHold();
+                break;
+            default:
+                break;
+        }
+    }
+};
+
+// JackpotFingerprint
+//
+// Renders one mode from a seed on a clock the caller advances by kFingerprintFrameMs between frames, and folds
+// every composed frame into an FNV-1a hash.  It has its own particle pool and random stream, so a run never
+// touches the live effect.  The palette is always Backglass and Pulse always follows the heartbeat, whatever the
+// zone is themed with and whatever the microphone hears, so a hash depends only on the code, the mode and the
+// seed.  The caller's clock must also be what beat8 reads: the show clock on the cabinet.
+
+constexpr uint16_t kFingerprintFrames    = 200;         // 6 s, well inside one mode
+constexpr uint32_t kFingerprintFrameMs   = 30;          // The bake rate
+constexpr uint32_t kFingerprintStartMs   = 1;           // Not 0, which Advance takes as never started
+constexpr size_t   kFingerprintParticles = 64;          // As many as the live pool has
+
+class JackpotFingerprint
+{
+  public:
+
+    JackpotFingerprint(JackpotMode mode, uint32_t seed, const CRGB * (*pfnBackglassPalette)())
+        : _random(seed),
+          _effect(&_particles, 0, _particleLeds, &_random, pfnBackglassPalette, PinnedPulse),
+          _lastStepMs(kFingerprintStartMs)
+    {
+        _effect.Reset(mode, kFingerprintStartMs);
+    }
+
+    JackpotFingerprint(const JackpotFingerprint &) = delete;
+    JackpotFingerprint & operator=(const JackpotFingerprint &) = delete;
+
+    void HOT_RENDER RenderFrame(uint32_t now)
+    {
+        const ParticleLayer layer = { _particleLeds, kJackpotLedCount };
+        _particles.Step(now - _lastStepMs, &layer, 1);
+        _lastStepMs = now;
+
+        CRGB frame[kJackpotLedCount];
+        _effect.Advance(now);
+        _effect.Compose(SpanOf(frame), false);
+
+        const uint8_t * pBytes = reinterpret_cast<const uint8_t *>(frame);
+        for (size_t i = 0; i < sizeof(frame); ++i)
+            _hash = (_hash ^ pBytes[i]) * 16777619u;
+    }
+
+    uint32_t hash() const
+    {
+        return _hash;
+    }
+
+  private:
+
+    static uint8_t PinnedPulse(uint8_t bpm)
+    {
+        return GetHeartbeatBrightness(bpm);
+    }
+
+    ParticlePool<kFingerprintParticles>  _particles;
+    CRGB                                 _particleLeds[kJackpotLedCount] = {};
+    EffectRandom                         _random;
+    JackpotEffect<kFingerprintParticles> _effect;
+    uint32_t                             _lastStepMs;
+    uint32_t                             _hash = 2166136261u;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "jackpoteffect.h"
+
+// Jackpot goldens
+//
+// The hash of every jackpot mode rendered by JackpotFingerprint from each seed, which the "fingerprint"
+// console command checks the cabinet against.  Generated by "effectcheck --write"; regenerate it whenever a
+// change to the effect is meant to change what it draws.
+
+struct JackpotGolden
+{
+    uint16_t seed;
+    uint32_t hashes[static_cast<uint8_t>(JackpotMode::Count)];
+};
+
+const JackpotGolden kJackpotGoldens[] =
+{
+    { 1, { 0xf2ca96c5u, 0xf328f9f1u, 0x3161f591u, 0xde7e39d4u, 0xa8e451b5u, 0x3bc3e63du, 0xd2b5dd85u, 0x9bf58305u, 0x0b2a9ac5u } },
+    { 42, { 0xf2ca96c5u, 0xf328f9f1u, 0x3161f591u, 0xde7e39d4u, 0xa8e451b5u, 0xdefc082du, 0xd2b5dd85u, 0x9bf58305u, 0x0b2a9ac5u } },
+    { 1337, { 0xf2ca96c5u, 0xf328f9f1u, 0x3161f591u, 0xde7e39d4u, 0xa8e451b5u, 0xa56064adu, 0xd2b5dd85u, 0x9bf58305u, 0x0b2a9ac5u } },
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <FastLED.h>
+#include <string.h>
+
+// KeyframeBlender
+//
+// Output-stage interpolation for effects that step slower than the strips can refresh.  The effect pushes a
+// keyframe whenever it steps, and the blender crossfades from what was on screen at that moment to the new
+// keyframe over the effect's own interval.  The zone then renders at the output rate instead of the effect
+// rate.  Motion trails the effect by at most one interval, which is invisible at the rates this is used for.
+//
+// The blend weight is worked out once per rendered frame and applied to the whole zone.
+
+template <size_t LedCount>
+class KeyframeBlender
+{
+  public:
+
+    // PushKeyframe
+    //
+    // Starts a blend towards pKeyframe that completes durationMs from now.  A blend that is still in progress
+    // continues from where it got to, so early keyframes (triggers, mode changes) never jump.  A keyframe that
+    // matches the current target is ignored, so an effect that holds still costs nothing once its blend is done.
+
+    void PushKeyframe(const CRGB * pKeyframe, uint32_t now, uint32_t durationMs)
+    {
+        if (0 == memcmp(_to, pKeyframe, sizeof(_to)))
+            return;
+
+        if (_bBlending)
+            Render(now, _from);
+        else
+            memcpy(_from, _to, sizeof(_from));
+
+        memcpy(_to, pKeyframe, sizeof(_to));
+        _start = now;
+        _durationMs = durationMs ? durationMs : 1;
+        _bBlending = true;
+        _bDirty = true;
+    }
+
+    // SnapToKeyframe
+    //
+    // Shows pKeyframe as-is on the next Render, for effects that must stay crisp
+
+    void SnapToKeyframe(const CRGB * pKeyframe)
+    {
+        memcpy(_to, pKeyframe, sizeof(_to));
+        _bBlending = false;
+        _bDirty = true;
+    }
+
+    // Render
+    //
+    // Writes the output for now into pOut and returns true, or returns false if it has not changed since the
+    // last call
+
+    bool Render(uint32_t now, CRGB * pOut)
+    {
+        if (!_bDirty)
+            return false;
+
+        const uint32_t elapsed = now - _start;
+        if (!_bBlending || elapsed >= _durationMs)
+        {
+            memcpy(pOut, _to, sizeof(_to));
+            _bBlending = false;
+            _bDirty = false;
+            return true;
+        }
+
+        const fract8 weight = static_cast<fract8>(elapsed * 256 / _durationMs);
+        blend(_from, _to, pOut, LedCount, weight);
+        return true;
+    }
+
+    // Invalidate
+    //
+    // Makes the next Render write the output again, for when something else has drawn over it
+
+    void Invalidate()
+    {
+        _bDirty = true;
+    }
+
+    bool IsBlending() const
+    {
+        return _bBlending;
+    }
+
+  private:
+
+    CRGB     _from[LedCount] = {};
+    CRGB     _to[LedCount] = {};
+    uint32_t _start = 0;
+    uint32_t _durationMs = 1;
+    bool     _bBlending = false;
+    bool     _bDirty = false;
+};
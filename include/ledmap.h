@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+#include "globals.h"
+
+// LED map
+//
+// Places every LED of leds0 and leds1 on the artwork so an effect can draw across the backglass as a whole
+// instead of along one strip.  The LEDs share one map index space, leds0 first and then leds1; MapLed turns a map
+// index back into its pixel.  Positions are 8-bit artwork units: x runs 0..255 from the left edge of the glass and
+// y runs 0..255 down from the top.
+//
+// BuildLedMap runs once at boot.  It works out each LED's polar angle and radius around the centre of the glass
+// and its distance to the key features, all as 8-bit fixed point: angles in 1/256 turns, lengths scaled so the
+// farthest LED is 255.  A spatial effect then costs one table read per LED instead of trigonometry per frame.
+
+constexpr uint16_t kMapLedCount = NUM_LEDS0 + NUM_LEDS1;
+
+struct LedMapPoint
+{
+    uint8_t x;
+    uint8_t y;
+    uint8_t angle;              // Around the centre of the glass, 0 points right and it turns clockwise
+    uint8_t radius;             // From the centre of the glass
+};
+
+enum class MapFeature : uint8_t
+{
+    Heart = 0,
+    Eyes,
+    Machine,
+    Count
+};
+
+void BuildLedMap();
+const LedMapPoint * GetLedMap();
+const uint8_t * GetFeatureDistances(MapFeature feature);
+
+inline CRGB & MapLed(uint16_t index)
+{
+    return index < NUM_LEDS0 ? leds0[index] : leds1[index - NUM_LEDS0];
+}
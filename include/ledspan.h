@@ -0,0 +1,117 @@
+#pragma once
+
+#include <FastLED.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// LedSpan
+//
+// A run of LEDs whose length is part of its type.  Every zone of the backglass has a compile-time size, so the
+// kernels below are instantiated per zone: the trip count is a constant the compiler can unroll, the loop index
+// stays a plain register instead of a uint8_t that has to be masked on every step, and a span or an index table
+// that does not fit its channel fails to compile instead of scribbling over the next zone.
+//
+// The kernels produce exactly what fill_solid, fadeToBlackBy and an indexed palette walk produce, so swapping
+// one in never changes a frame.
+
+template <size_t LedCount>
+class LedSpan
+{
+  public:
+
+    static_assert(LedCount > 0, "An LED span needs at least one LED");
+
+    explicit LedSpan(CRGB * pLeds) : _pLeds(pLeds)
+    {
+    }
+
+    static constexpr size_t size()
+    {
+        return LedCount;
+    }
+
+    CRGB & operator[](size_t index) const
+    {
+        return _pLeds[index];
+    }
+
+    CRGB * begin() const
+    {
+        return _pLeds;
+    }
+
+    CRGB * end() const
+    {
+        return _pLeds + LedCount;
+    }
+
+  private:
+
+    CRGB * _pLeds;
+};
+
+// MakeLedSpan
+//
+// The span of Count LEDs starting at First in a channel of ChannelLeds LEDs
+
+template <size_t First, size_t Count, size_t ChannelLeds>
+LedSpan<Count> MakeLedSpan(CRGB * pChannel)
+{
+    static_assert(First + Count <= ChannelLeds, "LED span runs past the end of its channel");
+    return LedSpan<Count>(pChannel + First);
+}
+
+// SpanOf
+//
+// The span covering a whole array, sized from its type
+
+template <size_t LedCount>
+LedSpan<LedCount> SpanOf(CRGB (&leds)[LedCount])
+{
+    return LedSpan<LedCount>(leds);
+}
+
+// IndicesWithin
+//
+// For static_asserts on the index tables of zones that are scattered over a channel
+
+template <size_t Count>
+constexpr bool IndicesWithin(const uint8_t (&indices)[Count], size_t channelLeds)
+{
+    for (size_t i = 0; i < Count; ++i)
+    {
+        if (indices[i] >= channelLeds)
+            return false;
+    }
+    return true;
+}
+
+template <size_t LedCount>
+inline void FillSpan(LedSpan<LedCount> span, const CRGB & color)
+{
+    for (size_t i = 0; i < LedCount; ++i)
+        span[i] = color;
+}
+
+template <size_t LedCount>
+inline void FadeSpanToBlackBy(LedSpan<LedCount> span, uint8_t fadeBy)
+{
+    const uint8_t scale = 255 - fadeBy;
+    for (size_t i = 0; i < LedCount; ++i)
+        span[i].nscale8(scale);
+}
+
+// FillSpanFromPalette
+//
+// Walks a 256-entry palette cache from startIndex in steps of indexStep, wrapping like a uint8_t
+
+template <size_t LedCount>
+inline void FillSpanFromPalette(LedSpan<LedCount> span, const CRGB * pPalette, uint8_t startIndex, uint8_t indexStep)
+{
+    uint32_t index = startIndex;
+    for (size_t i = 0; i < LedCount; ++i)
+    {
+        span[i] = pPalette[index & 0xFF];
+        index += indexStep;
+    }
+}
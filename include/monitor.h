@@ -0,0 +1,19 @@
+#pragma once
+
+#include <Arduino.h>
+
+// System health monitor
+//
+// Samples the stack high-water mark of every long-running task along with heap free space, largest free block
+// and fragmentation.  Warnings are logged as soon as a task's headroom or the heap trend looks bad; the full
+// report, including recommended stack sizes, is printed by the "stats" console command.
+
+void SampleSystemHealth();
+void ReportSystemHealth();
+
+// ExitMonitoredTask
+//
+// Tasks that delete themselves end with this instead of vTaskDelete(nullptr).  It clears the task's handle under
+// the same lock the monitor holds while it samples a stack, so the monitor never queries a task that is gone.
+
+void ExitMonitoredTask(TaskHandle_t & handle);
@@ -4,5 +4,6 @@
 extern bool g_bUpdateStarted;
 
 void processRemoteDebugCmd();
-bool ConnectToWiFi(uint cRetries);
+void StartNetwork();
+void ReportNetworkStats();
 void SetupOTA(const char *pszHostname);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <Arduino.h>
+
+// OTA mode
+//
+// While a flash update is being received the draw task stops running effects and sleeps, waking only when the
+// progress bar on the jackpot LEDs has to grow, so nearly all of the CPU goes to the upload.  Other background
+// work (frame store jobs, audio) is stopped for the duration.  How long the last transfer took is kept in NVS
+// so it can be compared across builds after the reboot.
+
+void BeginOtaMode();
+void UpdateOtaProgress(uint32_t progress, uint32_t total);
+void EndOtaMode(bool bSuccess);
+uint8_t GetOtaProgress();
+void ReportOtaStats();
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "drawing.h"
+#include "palettetheme.h"
+
+// Palette engine
+//
+// Every palette-driven effect samples its colors from the palette assigned to its zone instead of using
+// hard-coded colors, so the whole backglass can be themed at runtime.  A palette is defined with 16 stops and is
+// expanded once, the first time it is assigned, into a 256-entry cache; a color lookup is then a single indexed
+// load with no interpolation per pixel.  The theme slots effects sample are in palettetheme.h.
+
+enum class PaletteId : uint8_t
+{
+    Backglass = 0,
+    Rainbow,
+    Party,
+    Lava,
+    Heat,
+    Ocean,
+    Forest,
+    Cloud,
+    Count
+};
+
+void BeginPalettes();
+bool SetZonePalette(LedZone zone, PaletteId palette);
+bool SetAllZonePalettes(PaletteId palette);
+const CRGB * GetZonePalette(LedZone zone);
+const CRGB * GetPalette(PaletteId palette);
+bool FindPalette(const char * pszName, PaletteId & palette);
+const char * GetPaletteName(PaletteId palette);
+void ReportPalettes();
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <FastLED.h>
+#include <stdint.h>
+
+// Palette theme
+//
+// The Backglass palette and the theme slots that effects sample instead of fixed colors, split out of
+// palettes.h so that, like ledspan.h and particles.h, it needs nothing but FastLED.  tools/effectcheck.cpp
+// expands the same stops to render effects on the host.
+//
+// The Backglass palette reproduces the original look.  Effects that used a fixed color sample it at one of the
+// theme slots below, which land exactly on a stop of the Backglass palette and on the matching part of any
+// other palette.
+//
+// Black is off rather than a color and is never themed.  The showcase, both heart effects and the boot scene
+// keep their fixed colors too: they light the printed artwork (the spotlights, the logo, the heart) in the
+// colors it was painted for.
+
+constexpr uint16_t kPaletteSize = 256;
+
+// Theme slots, as indexes into a palette cache
+constexpr uint8_t kPalettePrimary   = 0;        // Red in the Backglass palette
+constexpr uint8_t kPaletteFlame     = 16;       // Orange-red
+constexpr uint8_t kPaletteSecondary = 32;       // Dark orange
+constexpr uint8_t kPaletteWarm      = 48;       // Orange
+constexpr uint8_t kPaletteHighlight = 64;       // Gold
+constexpr uint8_t kPaletteAccentA   = 128;      // Cyan
+constexpr uint8_t kPaletteCool      = 144;      // Deep sky blue
+constexpr uint8_t kPaletteAccentB   = 208;      // Magenta
+constexpr uint8_t kPalettePulse     = 224;      // Deep pink
+constexpr uint8_t kPaletteSparkle   = 240;      // White
+
+// The original hard-coded colors of the effects, laid out around the color wheel so that hue-based effects still
+// sweep through a full rainbow.  The white of the sparkles and scanners sits in the last stop, where a sweep
+// passes it on its way back to red.
+const TProgmemRGBPalette16 kBackglassColors FL_PROGMEM =
+{
+    CRGB::Red,       CRGB::OrangeRed,   CRGB::DarkOrange, CRGB::Orange,
+    CRGB::Gold,      CRGB::Yellow,      CRGB::LawnGreen,  CRGB::Green,
+    CRGB::Cyan,      CRGB::DeepSkyBlue, CRGB::Blue,       CRGB::BlueViolet,
+    CRGB::Purple,    CRGB::Magenta,     CRGB::DeepPink,   CRGB::White
+};
+
+// ExpandPaletteStops
+//
+// Fills a 256-entry palette cache by blending between the 16 stops
+
+inline void ExpandPaletteStops(const TProgmemRGBPalette16 & stops, CRGB * pEntries)
+{
+    const CRGBPalette16 palette(stops);
+    for (uint16_t i = 0; i < kPaletteSize; ++i)
+        pEntries[i] = ColorFromPalette(palette, static_cast<uint8_t>(i), 255, LINEARBLEND);
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <FastLED.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ParticlePool
+//
+// A fixed number of particles shared by every effect that sparkles or streaks.  The pool is a structure of
+// arrays sized at compile time, so after boot nothing is allocated, and a step is one straight pass over the
+// live particles that moves, ages, culls and draws each of them.  Live particles are kept packed at the front;
+// a dead one is replaced by the last, so the cost follows the number alive and never the capacity.
+//
+// A particle lives on a layer, a run of LEDs that belongs to one zone.  Step clears every layer and then adds the
+// particles into it; the zone mixes its layer into its own output when it steps, so particles emitted by one
+// zone never touch another.  Positions are in 1/256 LED along the layer and velocities in 1/256 LED per 16 ms;
+// a particle fades out linearly over its life and is dropped when it runs off either end of its layer.
+
+struct ParticleLayer
+{
+    CRGB *  pLeds;
+    uint8_t ledCount;
+};
+
+template <size_t Capacity>
+class ParticlePool
+{
+  public:
+
+    static_assert(Capacity > 0, "A particle pool needs room for at least one particle");
+
+    static constexpr size_t capacity()
+    {
+        return Capacity;
+    }
+
+    // Emit
+    //
+    // Adds a particle at full brightness; returns false and counts a drop when the pool is full
+
+    bool Emit(uint8_t layer, uint16_t position, int16_t velocity, const CRGB & color, uint16_t lifeMs)
+    {
+        if (_count == Capacity)
+        {
+            ++_dropped;
+            return false;
+        }
+
+        const size_t i = _count++;
+        _layer[i] = layer;
+        _position[i] = position;
+        _velocity[i] = velocity;
+        _color[i] = color;
+        _life[i] = kFullLife;
+        _fade[i] = static_cast<uint16_t>(kFullLife / (lifeMs ? lifeMs : 1));
+        return true;
+    }
+
+    // Step
+    //
+    // Advances every particle by elapsedMs and draws the survivors into the layers, which are cleared first.  A
+    // stalled pass is capped at kMaxStepMs so particles do not jump across a zone.
+
+    void Step(uint32_t elapsedMs, const ParticleLayer * pLayers, size_t layerCount)
+    {
+        for (size_t l = 0; l < layerCount; ++l)
+        {
+            for (uint8_t led = 0; led < pLayers[l].ledCount; ++led)
+                pLayers[l].pLeds[led] = CRGB::Black;
+        }
+
+        const int32_t dt = static_cast<int32_t>(elapsedMs < kMaxStepMs ? elapsedMs : kMaxStepMs);
+        size_t i = 0;
+        while (i < _count)
+        {
+            const uint32_t fade = static_cast<uint32_t>(_fade[i]) * dt;
+            const int32_t position = _position[i] + _velocity[i] * dt / 16;
+            const uint8_t layer = _layer[i];
+            if (fade >= _life[i] || layer >= layerCount || position < 0 || (position >> 8) >= pLayers[layer].ledCount)
+            {
+                Kill(i);
+                continue;
+            }
+
+            _life[i] -= fade;
+            _position[i] = static_cast<uint16_t>(position);
+            Draw(pLayers[layer], static_cast<uint16_t>(position), _color[i], _life[i] >> 8);
+            ++i;
+        }
+    }
+
+    // ClearLayer
+    //
+    // Drops every particle on one layer, for an effect that hands its zone to another
+
+    void ClearLayer(uint8_t layer)
+    {
+        size_t i = 0;
+        while (i < _count)
+        {
+            if (_layer[i] == layer)
+                Kill(i);
+            else
+                ++i;
+        }
+    }
+
+    void Clear()
+    {
+        _count = 0;
+    }
+
+    size_t size() const
+    {
+        return _count;
+    }
+
+    uint32_t dropped() const
+    {
+        return _dropped;
+    }
+
+  private:
+
+    static constexpr uint16_t kFullLife  = 65535;
+    static constexpr uint32_t kMaxStepMs = 100;
+
+    void Kill(size_t i)
+    {
+        const size_t last = --_count;
+        if (i == last)
+            return;
+        _layer[i] = _layer[last];
+        _position[i] = _position[last];
+        _velocity[i] = _velocity[last];
+        _color[i] = _color[last];
+        _life[i] = _life[last];
+        _fade[i] = _fade[last];
+    }
+
+    // A particle between two LEDs is shared between them, so slow movement glides instead of stepping
+
+    static void Draw(const ParticleLayer & layer, uint16_t position, const CRGB & color, uint8_t brightness)
+    {
+        const uint8_t led = static_cast<uint8_t>(position >> 8);
+        const uint8_t fraction = static_cast<uint8_t>(position);
+
+        layer.pLeds[led] += CRGB(color).nscale8(scale8(brightness, 255 - fraction));
+        if (fraction && led + 1 < layer.ledCount)
+            layer.pLeds[led + 1] += CRGB(color).nscale8(scale8(brightness, fraction));
+    }
+
+    uint16_t _position[Capacity];
+    int16_t  _velocity[Capacity];
+    uint16_t _life[Capacity];
+    uint16_t _fade[Capacity];           // Life lost per millisecond
+    CRGB     _color[Capacity];
+    uint8_t  _layer[Capacity];
+    size_t   _count = 0;
+    uint32_t _dropped = 0;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Idle power governor
+//
+// The cabinet spends hours in attract mode with nobody touching it.  After a minute without HTTP, WebSocket,
+// console or input activity the governor drops the CPU clock, lets the WiFi modem sleep between beacons and caps
+// the frame rate; once the output has stopped changing altogether the cap drops further.  Any activity wakes the
+// draw task, which restores full speed before it draws the next frame.
+
+void BeginPowerGovernor();
+void NotePowerActivity();
+void InhibitPowerSave(bool bInhibit);
+bool UpdatePowerGovernor(uint32_t now);
+void NotePowerFrame();
+uint32_t PowerSaveFrameMs();
+uint32_t PowerSavePollMs();
+void ReportPowerStats();
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+#include "globals.h"
+
+// Live preview
+//
+// The draw task publishes what it just showed into a front buffer, at most kDefaultPreviewFps times a second,
+// with one copy and no lock: it writes the back buffer and flips, and a reader that sees a flip land under it
+// simply copies again.  GET /frame returns the newest published frame and the /preview WebSocket streams them.
+//
+// The stream is encoded once per frame, not once per viewer, and every viewer is sent the same buffer.  A frame
+// goes out as a delta against the previous one unless a key frame is due or cheaper.  Messages start with a
+// 3-byte header, the message type and the frame sequence (little-endian uint16):
+//
+//   0x10 KeyFrame     leds0 then leds1, 3 bytes RGB each
+//   0x11 DeltaFrame   n x (LED, r, g, b), where LED counts leds0 first and then leds1 as in the key frame
+//
+// A frame in which nothing changed is not sent at all.
+
+constexpr uint16_t kPreviewLedCount    = NUM_LEDS0 + NUM_LEDS1;
+constexpr size_t   kPreviewFrameBytes  = kPreviewLedCount * 3;
+constexpr size_t   kPreviewHeaderBytes = 3;
+constexpr size_t   kMaxPreviewMessage  = kPreviewHeaderBytes + kPreviewFrameBytes;
+constexpr uint8_t  kDefaultPreviewFps  = 10;
+constexpr uint8_t  kMaxPreviewFps      = 30;
+
+void PublishPreviewFrame();
+bool CopyPreviewFrame(uint8_t * pFrame, uint16_t & sequence);
+size_t NextPreviewMessage(uint8_t * pMessage, bool bForceKeyFrame);
+void SetPreviewCapture(bool bCapture);
+bool SetPreviewRate(uint8_t fps);
+uint8_t GetPreviewRate();
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+#include "globals.h"
+#include "drawing.h"
+
+// Remote pixels
+//
+// LEDs and brightness set over HTTP or the WebSocket are handed to the draw task instead of being written into
+// leds0/leds1 and shown from the web server's task, where the next draw pass would paint over them and the
+// show() would race the draw task's own.  A writer stages its changes between BeginPixelWrites and
+// EndPixelWrites; the draw task takes them between passes, lays the held LEDs over whatever the effects drew
+// for the length of each show(), and takes them off again, so the effects never see them.
+//
+// The held LEDs are let go kRemoteHoldMs after the last write, so a client that stops sending hands the
+// backglass back to the effects.
+
+constexpr uint32_t kRemoteHoldMs = 10000;
+
+void BeginPixelWrites(bool bReplace = false);
+void WritePixel(uint8_t strip, uint16_t index, const CRGB & color);
+bool WriteZonePixels(LedZone zone, const CRGB & color);
+void EndPixelWrites();
+void PostBrightness(uint8_t brightness);
+
+// Used by the draw task only
+
+bool ApplyRemoteRequests();
+void OverlayRemotePixels();
+void LiftRemotePixels();
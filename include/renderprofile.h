@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Render profile
+//
+// Measures what flash activity costs the draw task.  A run times the zone steps of every draw pass: for the
+// first half the cabinet is left alone, for the second half a low-priority task keeps writing to NVS.  Passes
+// during the load are split into the first pass after each write, which runs with a cold flash cache, and the
+// passes between writes.  The difference between the two is the cache refill cost per frame.
+//
+// Whether the render path runs from IRAM is a build option (ENABLE_IRAM_RENDER), so comparing the two is a run
+// on each build.
+
+constexpr uint32_t kDefaultRenderProfileSeconds = 20;
+constexpr uint32_t kRenderProfileStackSize      = 3072;
+
+bool StartRenderProfile(uint32_t seconds);
+void NoteRenderPass(uint32_t renderUs);
+void ReportRenderProfile();
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Scene presets
+//
+// A scene is a complete leds0/leds1 frame captured from the live output, kept in RAM for instant recall and in
+// SPIFFS so it survives a reboot.  A scene can be limited to a set of artwork zones (a bit per LedZone); only
+// the LEDs in those zones are held and the live effects keep running everywhere else.  A scene without a zone
+// mask covers the whole backglass and pauses the live effects while it is active.
+//
+// Capture and activation are requests that the draw task carries out between frames, so a scene always
+// appears in a single show() with no intermediate states.
+
+constexpr uint8_t  kMaxScenes          = 8;
+constexpr size_t   kMaxSceneNameLength = 20;
+constexpr uint16_t kSceneAllZones      = 0;
+constexpr uint16_t kMaxSceneZoneMask   = 0xFF;          // A bit for each of the 8 LedZones
+
+bool BeginScenes();
+bool SaveScene(const char * pszName, uint16_t zoneMask = kSceneAllZones);
+bool ActivateScene(const char * pszName);
+void ClearScene();
+bool DeleteScene(const char * pszName);
+void ReportScenes();
+
+// Used by the draw task only
+
+bool ApplySceneRequests();
+bool IsSceneHoldingDisplay();
+void OverlayActiveScene();
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Show clock
+//
+// All effect timing, including FastLED's beat8/beatsin8 (via USE_GET_MILLISECOND_TIMER), reads the show clock
+// instead of millis().  Normally it is just millis(), but a task can switch itself onto a virtual clock that it
+// advances by hand, which lets the baker render effects faster than real time while the other tasks keep
+// running on the real clock.
+//
+// Outside of a virtual clock the show clock is millis() plus an offset that the clock sync keeps pointed at the
+// master cabinet, so every cabinet in a group computes the same effect phases.
+
+uint32_t ShowMillis();
+void SetShowClockOffset(uint32_t offsetMs);
+uint32_t GetShowClockOffset();
+void BeginVirtualShowTime(uint32_t startMs);
+void AdvanceVirtualShowTime(uint32_t deltaMs);
+void EndVirtualShowTime();
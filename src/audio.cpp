@@ -0,0 +1,113 @@
+#include "globals.h"
+#include "audio.h"
+#include "monitor.h"
+#include <driver/i2s.h>
+
+extern TaskHandle_t g_taskAudio;
+
+namespace
+{
+    constexpr i2s_port_t kAudioPort          = I2S_NUM_1;   // I2S0 belongs to the LED output
+    constexpr uint32_t   kSnapshotStaleMs    = 250;
+    constexpr uint8_t    kSnapshotRetries    = 4;
+
+    AudioAnalyzer     g_analyzer;
+    int32_t           g_samples[kAudioBlockSize];
+
+    AudioSnapshot     g_snapshot;
+    volatile uint32_t g_snapshotSequence = 0;              // Odd while the snapshot is being written
+
+    uint32_t g_blocks = 0;
+    uint32_t g_overruns = 0;
+    uint32_t g_maxBlockUs = 0;
+
+    bool BeginMicrophone()
+    {
+        i2s_config_t config = {};
+        config.mode = static_cast<i2s_mode_t>(I2S_MODE_MASTER | I2S_MODE_RX);
+        config.sample_rate = kAudioSampleRate;
+        config.bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT;
+        config.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+        config.communication_format = static_cast<i2s_comm_format_t>(I2S_COMM_FORMAT_I2S | I2S_COMM_FORMAT_I2S_MSB);
+        config.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1;
+        config.dma_buf_count = 4;
+        config.dma_buf_len = kAudioBlockSize;
+
+        i2s_pin_config_t pins = {};
+        pins.bck_io_num = AUDIO_I2S_SCK;
+        pins.ws_io_num = AUDIO_I2S_WS;
+        pins.data_out_num = I2S_PIN_NO_CHANGE;
+        pins.data_in_num = AUDIO_I2S_SD;
+
+        return ESP_OK == i2s_driver_install(kAudioPort, &config, 0, nullptr)
+            && ESP_OK == i2s_set_pin(kAudioPort, &pins);
+    }
+
+    void PublishSnapshot(const AudioSnapshot & snapshot)
+    {
+        ++g_snapshotSequence;
+        __sync_synchronize();
+        g_snapshot = snapshot;
+        __sync_synchronize();
+        ++g_snapshotSequence;
+    }
+}
+
+// AudioLoopTaskEntry
+//
+// Reads one block at a time from the microphone and analyzes it.  The DSP time of every block is checked
+// against kAudioBlockBudgetUs; blocks that overrun are counted so "stats" shows when the analysis is too heavy.
+
+void AudioLoopTaskEntry(void *)
+{
+    if (!BeginMicrophone())
+    {
+        debugW("Could not start the I2S microphone, audio disabled");
+        ExitMonitoredTask(g_taskAudio);
+        return;
+    }
+
+    for (;;)
+    {
+        size_t cbRead = 0;
+        i2s_read(kAudioPort, g_samples, sizeof(g_samples), &cbRead, portMAX_DELAY);
+        if (cbRead != sizeof(g_samples))
+            continue;
+
+        const uint32_t start = micros();
+        AudioSnapshot snapshot;
+        g_analyzer.Analyze(g_samples, millis(), snapshot);
+        PublishSnapshot(snapshot);
+        const uint32_t elapsed = micros() - start;
+
+        ++g_blocks;
+        g_maxBlockUs = std::max(g_maxBlockUs, elapsed);
+        if (elapsed > kAudioBlockBudgetUs)
+            ++g_overruns;
+    }
+}
+
+// GetAudioSnapshot
+//
+// Returns false if there is no recent analysis.  The retry count is bounded because the audio task runs at a
+// lower priority on the same core as drawing: if we preempted it mid-publish, spinning would never let it finish.
+
+bool GetAudioSnapshot(AudioSnapshot & snapshot)
+{
+    for (uint8_t attempt = 0; attempt < kSnapshotRetries; ++attempt)
+    {
+        const uint32_t sequence = g_snapshotSequence;
+        __sync_synchronize();
+        snapshot = g_snapshot;
+        __sync_synchronize();
+
+        if (sequence != 0 && !(sequence & 1) && sequence == g_snapshotSequence)
+            return millis() - snapshot.updatedMs < kSnapshotStaleMs;
+    }
+    return false;
+}
+
+void ReportAudioStats()
+{
+    debugI("Audio: %u blocks, %u over the %u us budget, worst %u us", g_blocks, g_overruns, kAudioBlockBudgetUs, g_maxBlockUs);
+}
@@ -0,0 +1,491 @@
+#include "globals.h"
+#include "clocksync.h"
+#include "showclock.h"
+#include "drawing.h"
+#include "deferredlog.h"
+#include <WiFi.h>
+#include <Preferences.h>
+#include <lwip/sockets.h>
+#include <esp_timer.h>
+#include <algorithm>
+
+extern TaskHandle_t g_taskSync;
+
+namespace
+{
+    constexpr uint32_t kClockSyncMagic      = 0x53504F42;   // "BOPS"
+    constexpr uint32_t kRequestIntervalMs   = 1000;
+    constexpr uint32_t kReceiveTimeoutMs    = 100;
+    constexpr uint32_t kIdlePollMs          = 500;
+    constexpr uint8_t  kSampleWindow        = 8;            // The shortest round trip out of the last eight is used
+    constexpr uint32_t kMasterLostMs        = 10000;        // Without replies for this long, go back to broadcasting
+    constexpr int64_t  kStepThresholdUs     = 50000;        // Errors above this are stepped, smaller ones slewed
+    constexpr int64_t  kSlewPpm             = 5000;         // Slewing speeds the show clock up or down by at most 0.5%
+    constexpr int64_t  kDriftMinSpanUs      = 8000000;      // Drift is measured across at least eight seconds
+    constexpr uint32_t kRestartLeadMs       = 500;          // A new epoch lies this far ahead so every cabinet hears of it in time
+    constexpr uint32_t kEpochHoldoffMs      = 2000;         // Followers asking for an epoch within this time join the current one
+    constexpr const char * kSyncPrefsNamespace = "sync";
+    constexpr const char * kSyncRoleKey        = "role";
+
+    const char * const kRoleNames[] = { "off", "master", "follower" };
+    static_assert(sizeof(kRoleNames) / sizeof(kRoleNames[0]) == static_cast<size_t>(ClockSyncRole::Count), "Every role needs a name");
+
+    enum class SyncPacketType : uint8_t
+    {
+        Request = 0,
+        Reply
+    };
+
+    // Sent as-is and little-endian on both ends.  originUs is on the requester's local clock, receiveUs and
+    // transmitUs on the responder's show clock.  A request carries the epoch the requester runs on (0 for none),
+    // a reply from the master the epoch and seed everyone should run on.
+
+    struct ClockSyncPacket
+    {
+        uint32_t magic;
+        uint8_t  type;
+        uint8_t  role;
+        uint16_t sequence;
+        uint32_t epochMs;
+        uint32_t seed;
+        uint64_t originUs;
+        uint64_t receiveUs;
+        uint64_t transmitUs;
+    };
+
+    static_assert(sizeof(ClockSyncPacket) == 40, "ClockSyncPacket must stay 40 bytes, tools/syncprobe.py reads it");
+
+    struct SyncSample
+    {
+        int64_t  offsetUs;                              // Master show clock minus our local clock
+        int64_t  localUs;                               // Local clock halfway through the exchange
+        uint32_t delayUs;                               // Round trip minus the master's turnaround
+    };
+
+    struct ClockSyncStats
+    {
+        uint32_t requestsSent = 0;
+        uint32_t repliesUsed = 0;
+        uint32_t requestsAnswered = 0;
+        uint32_t steps = 0;
+        uint32_t epochs = 0;
+        uint32_t lastDelayUs = 0;
+        int32_t  lastErrorUs = 0;                       // Newest best exchange against the prediction, i.e. the phase error
+        uint32_t maxErrorUs = 0;
+    };
+
+    volatile ClockSyncRole g_role = ClockSyncRole::Off;
+    volatile bool g_bRestartRequested = false;
+
+    // Owned by the sync task
+    int        g_socket = -1;
+    int64_t    g_appliedOffsetUs = 0;                   // What the show clock runs on right now
+    bool       g_bLocked = false;
+    SyncSample g_samples[kSampleWindow] = {};
+    uint8_t    g_sampleCount = 0;
+    uint8_t    g_sampleNext = 0;
+    int64_t    g_refOffsetUs = 0;                       // Best estimate and the local time it was taken at
+    int64_t    g_refLocalUs = 0;
+    int64_t    g_driftRefOffsetUs = 0;
+    int64_t    g_driftRefLocalUs = 0;
+    int32_t    g_driftPpb = 0;
+    uint32_t   g_masterAddress = 0;                     // 0 while we broadcast, network byte order otherwise
+    uint32_t   g_lastReplyMs = 0;
+    uint16_t   g_sequence = 0;
+    uint32_t   g_epochMs = 0;                           // Epoch we run on, 0 before the first one
+    uint32_t   g_epochSeed = 0;
+    uint32_t   g_epochIssuedMs = 0;
+    bool       g_bEpochPending = false;                 // Master: the draw task has not taken the epoch yet
+    ClockSyncStats g_stats;
+
+    int64_t LocalMicros()
+    {
+        return esp_timer_get_time();
+    }
+
+    int32_t RoundToMillis(int64_t us)
+    {
+        return static_cast<int32_t>(us >= 0 ? (us + 500) / 1000 : -((-us + 500) / 1000));
+    }
+
+    void ApplyOffset(int64_t offsetUs)
+    {
+        g_appliedOffsetUs = offsetUs;
+        SetShowClockOffset(static_cast<uint32_t>(RoundToMillis(offsetUs)));
+    }
+
+    bool OpenSocket()
+    {
+        g_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (g_socket < 0)
+            return false;
+
+        const int broadcast = 1;
+        timeval timeout = {};
+        timeout.tv_usec = kReceiveTimeoutMs * 1000;
+        sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(kClockSyncPort);
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+
+        if (setsockopt(g_socket, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast)) < 0
+            || setsockopt(g_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0
+            || bind(g_socket, reinterpret_cast<sockaddr *>(&local), sizeof(local)) < 0)
+        {
+            logW("Could not open clock sync port %u", kClockSyncPort);
+            close(g_socket);
+            g_socket = -1;
+            return false;
+        }
+        return true;
+    }
+
+    void CloseSocket()
+    {
+        if (g_socket >= 0)
+            close(g_socket);
+        g_socket = -1;
+    }
+
+    void SendPacket(const ClockSyncPacket & packet, uint32_t address, uint16_t port)
+    {
+        sockaddr_in to = {};
+        to.sin_family = AF_INET;
+        to.sin_port = htons(port);
+        to.sin_addr.s_addr = address;
+        sendto(g_socket, &packet, sizeof(packet), 0, reinterpret_cast<sockaddr *>(&to), sizeof(to));
+    }
+
+    void ResetEstimate()
+    {
+        g_bLocked = false;
+        g_sampleCount = 0;
+        g_sampleNext = 0;
+        g_driftPpb = 0;
+        g_driftRefLocalUs = 0;
+        g_masterAddress = 0;
+        g_epochMs = 0;
+        g_bEpochPending = false;
+        ApplyOffset(0);
+    }
+
+    // PredictOffset
+    //
+    // The master's show clock relative to ours at the given local time, carried forward from the best exchange
+    // by the measured drift so the show clock keeps time between exchanges and while the master is away
+
+    int64_t PredictOffset(int64_t localUs)
+    {
+        return g_refOffsetUs + (localUs - g_refLocalUs) * g_driftPpb / 1000000000;
+    }
+
+    // UpdateEstimate
+    //
+    // Picks the exchange with the shortest round trip from the window; queueing only ever adds delay, so it is
+    // the one whose midpoint is closest to the truth.  Each new best also refines the drift estimate.
+
+    void UpdateEstimate()
+    {
+        const SyncSample * pBest = &g_samples[0];
+        for (uint8_t i = 1; i < g_sampleCount; ++i)
+        {
+            if (g_samples[i].delayUs < pBest->delayUs)
+                pBest = &g_samples[i];
+        }
+        if (g_bLocked && pBest->localUs == g_refLocalUs)
+            return;
+
+        if (g_bLocked)
+        {
+            g_stats.lastErrorUs = static_cast<int32_t>(pBest->offsetUs - PredictOffset(pBest->localUs));
+            g_stats.maxErrorUs = std::max(g_stats.maxErrorUs, static_cast<uint32_t>(abs(g_stats.lastErrorUs)));
+        }
+
+        if (0 == g_driftRefLocalUs)
+        {
+            g_driftRefOffsetUs = pBest->offsetUs;
+            g_driftRefLocalUs = pBest->localUs;
+        }
+        else if (pBest->localUs - g_driftRefLocalUs >= kDriftMinSpanUs)
+        {
+            const int64_t ppb = (pBest->offsetUs - g_driftRefOffsetUs) * 1000000000 / (pBest->localUs - g_driftRefLocalUs);
+            g_driftPpb = (0 == g_driftPpb) ? static_cast<int32_t>(ppb) : static_cast<int32_t>(g_driftPpb + (ppb - g_driftPpb) / 4);
+            g_driftRefOffsetUs = pBest->offsetUs;
+            g_driftRefLocalUs = pBest->localUs;
+        }
+
+        g_refOffsetUs = pBest->offsetUs;
+        g_refLocalUs = pBest->localUs;
+    }
+
+    // SteerShowClock
+    //
+    // Moves the applied offset toward the prediction.  Small errors are slewed so effects only speed up or slow
+    // down a little; the first lock and anything larger than kStepThresholdUs are stepped.
+
+    void SteerShowClock(int64_t elapsedUs)
+    {
+        const int64_t target = PredictOffset(LocalMicros());
+        const int64_t error = target - g_appliedOffsetUs;
+
+        if (!g_bLocked || error > kStepThresholdUs || error < -kStepThresholdUs)
+        {
+            if (g_bLocked)
+                logW("Show clock stepped by %d ms", RoundToMillis(error));
+            g_bLocked = true;
+            ++g_stats.steps;
+            ApplyOffset(target);
+            return;
+        }
+
+        const int64_t maxSlew = elapsedUs * kSlewPpm / 1000000 + 1;
+        ApplyOffset(g_appliedOffsetUs + std::max(-maxSlew, std::min(error, maxSlew)));
+    }
+
+    // StartNewEpoch
+    //
+    // Master only: every cabinet restarts its effects kRestartLeadMs from now with a fresh seed
+
+    void StartNewEpoch()
+    {
+        g_epochMs = ShowMillis() + kRestartLeadMs;
+        g_epochSeed = esp_random();
+        g_epochIssuedMs = millis();
+        g_bEpochPending = true;
+        ++g_stats.epochs;
+        logI("New show epoch %u, seed %u", g_epochMs, g_epochSeed);
+    }
+
+    void SendRequest()
+    {
+        ClockSyncPacket request = {};
+        request.magic = kClockSyncMagic;
+        request.type = static_cast<uint8_t>(SyncPacketType::Request);
+        request.role = static_cast<uint8_t>(ClockSyncRole::Follower);
+        request.sequence = ++g_sequence;
+        request.epochMs = g_epochMs;
+        request.originUs = static_cast<uint64_t>(LocalMicros());
+        SendPacket(request, g_masterAddress ? g_masterAddress : htonl(INADDR_BROADCAST), kClockSyncPort);
+        ++g_stats.requestsSent;
+    }
+
+    void HandleRequest(const ClockSyncPacket & request, const sockaddr_in & from, int64_t receivedUs)
+    {
+        // A follower without an epoch gets a new one, unless the current one is recent enough for it to join
+        if (g_role == ClockSyncRole::Master
+            && request.role == static_cast<uint8_t>(ClockSyncRole::Follower)
+            && 0 == request.epochMs
+            && millis() - g_epochIssuedMs > kEpochHoldoffMs)
+        {
+            StartNewEpoch();
+        }
+
+        ClockSyncPacket reply = request;
+        reply.type = static_cast<uint8_t>(SyncPacketType::Reply);
+        reply.role = static_cast<uint8_t>(g_role);
+        reply.epochMs = g_epochMs;
+        reply.seed = g_epochSeed;
+        reply.receiveUs = static_cast<uint64_t>(receivedUs + g_appliedOffsetUs);
+        reply.transmitUs = static_cast<uint64_t>(LocalMicros() + g_appliedOffsetUs);
+        SendPacket(reply, from.sin_addr.s_addr, ntohs(from.sin_port));
+        ++g_stats.requestsAnswered;
+    }
+
+    void HandleReply(const ClockSyncPacket & reply, const sockaddr_in & from, int64_t receivedUs)
+    {
+        if (g_role != ClockSyncRole::Follower
+            || reply.role != static_cast<uint8_t>(ClockSyncRole::Master)
+            || reply.sequence != g_sequence)
+        {
+            return;                                     // Other followers answering a broadcast, or a late reply
+        }
+
+        const int64_t t1 = static_cast<int64_t>(reply.originUs);
+        const int64_t t2 = static_cast<int64_t>(reply.receiveUs);
+        const int64_t t3 = static_cast<int64_t>(reply.transmitUs);
+        const int64_t t4 = receivedUs;
+
+        SyncSample & sample = g_samples[g_sampleNext];
+        sample.offsetUs = ((t2 - t1) + (t3 - t4)) / 2;
+        sample.localUs = t1 + (t4 - t1) / 2;
+        sample.delayUs = static_cast<uint32_t>(std::max<int64_t>(0, (t4 - t1) - (t3 - t2)));
+        g_sampleNext = (g_sampleNext + 1) % kSampleWindow;
+        g_sampleCount = std::min<uint8_t>(g_sampleCount + 1, kSampleWindow);
+
+        if (0 == g_masterAddress)
+            logI("Following clock master %u.%u.%u.%u", from.sin_addr.s_addr & 0xFF, (from.sin_addr.s_addr >> 8) & 0xFF,
+                 (from.sin_addr.s_addr >> 16) & 0xFF, from.sin_addr.s_addr >> 24);
+        g_masterAddress = from.sin_addr.s_addr;
+        g_lastReplyMs = millis();
+        g_stats.lastDelayUs = sample.delayUs;
+        ++g_stats.repliesUsed;
+
+        UpdateEstimate();
+        SteerShowClock(0);
+
+        // Join the master's epoch while it still lies ahead; a stale one is refused so that the master hands out
+        // a fresh epoch instead of this cabinet starting out of step
+        if (reply.epochMs != g_epochMs && static_cast<int32_t>(reply.epochMs - ShowMillis()) > 0)
+        {
+            if (RequestShowRestart(reply.epochMs, reply.seed))
+            {
+                g_epochMs = reply.epochMs;
+                g_epochSeed = reply.seed;
+            }
+        }
+    }
+
+    void EnterRole(ClockSyncRole role)
+    {
+        ResetEstimate();
+        if (role == ClockSyncRole::Off)
+            CloseSocket();
+        else if (role == ClockSyncRole::Master)
+            StartNewEpoch();
+        logI("Clock sync is now %s", kRoleNames[static_cast<uint8_t>(role)]);
+    }
+
+    // ClockSyncTaskEntry
+    //
+    // Answers requests in every role but Off.  A follower also sends a request a second and steers its show
+    // clock after every pass; the socket timeout keeps passes at least ten a second.
+
+    void ClockSyncTaskEntry(void *)
+    {
+        ClockSyncRole lastRole = ClockSyncRole::Off;
+        uint32_t nextRequestMs = millis();
+        int64_t lastSteerUs = LocalMicros();
+
+        for (;;)
+        {
+            const ClockSyncRole role = g_role;
+            if (role != lastRole)
+            {
+                EnterRole(role);
+                lastRole = role;
+            }
+
+            if (role == ClockSyncRole::Off || !WiFi.isConnected() || (g_socket < 0 && !OpenSocket()))
+            {
+                delay(kIdlePollMs);
+                continue;
+            }
+
+            if (role == ClockSyncRole::Master)
+            {
+                if (g_bRestartRequested)
+                {
+                    g_bRestartRequested = false;
+                    StartNewEpoch();
+                }
+                if (g_bEpochPending && RequestShowRestart(g_epochMs, g_epochSeed))
+                    g_bEpochPending = false;
+            }
+            else if (static_cast<int32_t>(millis() - nextRequestMs) >= 0)
+            {
+                if (g_masterAddress && millis() - g_lastReplyMs > kMasterLostMs)
+                {
+                    logW("Clock master lost, holding the show clock on its drift");
+                    g_masterAddress = 0;
+                }
+                SendRequest();
+                nextRequestMs = millis() + kRequestIntervalMs;
+            }
+
+            ClockSyncPacket packet;
+            sockaddr_in from = {};
+            socklen_t cbFrom = sizeof(from);
+            const int cb = recvfrom(g_socket, &packet, sizeof(packet), 0, reinterpret_cast<sockaddr *>(&from), &cbFrom);
+            const int64_t receivedUs = LocalMicros();
+
+            if (cb == sizeof(packet) && packet.magic == kClockSyncMagic)
+            {
+                if (packet.type == static_cast<uint8_t>(SyncPacketType::Request))
+                    HandleRequest(packet, from, receivedUs);
+                else if (packet.type == static_cast<uint8_t>(SyncPacketType::Reply))
+                    HandleReply(packet, from, receivedUs);
+            }
+
+            const int64_t now = LocalMicros();
+            if (role == ClockSyncRole::Follower && g_bLocked)
+                SteerShowClock(now - lastSteerUs);
+            lastSteerUs = now;
+        }
+    }
+}
+
+void BeginClockSync()
+{
+    Preferences prefs;
+    if (prefs.begin(kSyncPrefsNamespace, true))
+    {
+        const uint8_t role = prefs.getUChar(kSyncRoleKey, static_cast<uint8_t>(ClockSyncRole::Off));
+        prefs.end();
+        if (role < static_cast<uint8_t>(ClockSyncRole::Count))
+            g_role = static_cast<ClockSyncRole>(role);
+    }
+
+    xTaskCreatePinnedToCore(ClockSyncTaskEntry, "ClockSync", kClockSyncStackSize, nullptr, NET_PRIORITY, &g_taskSync, NET_CORE);
+}
+
+// SetClockSyncRole
+//
+// Switches roles on the sync task and remembers the choice across reboots
+
+bool SetClockSyncRole(ClockSyncRole role)
+{
+    if (role >= ClockSyncRole::Count)
+        return false;
+
+    g_role = role;
+
+    Preferences prefs;
+    if (prefs.begin(kSyncPrefsNamespace, false))
+    {
+        prefs.putUChar(kSyncRoleKey, static_cast<uint8_t>(role));
+        prefs.end();
+    }
+    return true;
+}
+
+bool FindClockSyncRole(const char * pszName, ClockSyncRole & role)
+{
+    for (uint8_t i = 0; i < static_cast<uint8_t>(ClockSyncRole::Count); ++i)
+    {
+        if (0 == strcasecmp(pszName, kRoleNames[i]))
+        {
+            role = static_cast<ClockSyncRole>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// RestartSyncedShow
+//
+// On the master, starts a new epoch so that every cabinet in the group restarts its effects together
+
+bool RestartSyncedShow()
+{
+    if (g_role != ClockSyncRole::Master)
+        return false;
+
+    g_bRestartRequested = true;
+    return true;
+}
+
+void ReportClockSyncStats()
+{
+    const ClockSyncRole role = g_role;
+    debugI("Clock sync: %s%s, show clock offset %d ms, epoch %u",
+           kRoleNames[static_cast<uint8_t>(role)], g_bLocked ? " (locked)" : "",
+           RoundToMillis(g_appliedOffsetUs), g_epochMs);
+    if (role == ClockSyncRole::Follower)
+    {
+        debugI("  master %s, drift %d ppb, last delay %u us, phase error last %d us, max %u us",
+               g_masterAddress ? IPAddress(g_masterAddress).toString().c_str() : "searching",
+               g_driftPpb, g_stats.lastDelayUs, g_stats.lastErrorUs, g_stats.maxErrorUs);
+    }
+    debugI("  %u requests sent, %u replies used, %u requests answered, %u steps, %u epochs",
+           g_stats.requestsSent, g_stats.repliesUsed, g_stats.requestsAnswered, g_stats.steps, g_stats.epochs);
+}
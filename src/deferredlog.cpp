@@ -0,0 +1,91 @@
+#include "globals.h"
+#include "deferredlog.h"
+
+namespace
+{
+    constexpr uint8_t kLogRingSize = 64;               // Power of two
+
+    struct LogRecord
+    {
+        const char * pszFormat;
+        const char * pszFunction;
+        uint32_t     timestamp;
+        uint8_t      level;
+        uint8_t      core;
+        uint32_t     args[kMaxLogArgs];
+    };
+
+    LogRecord         g_logRing[kLogRingSize];
+    uint8_t           g_logHead = 0;                    // Next slot to write, under g_logMux
+    volatile uint8_t  g_logTail = 0;                    // Next slot to print, only moved by the debug task
+    uint32_t          g_logDropped = 0;
+    uint32_t          g_logWritten = 0;
+    uint8_t           g_logHighWater = 0;
+    portMUX_TYPE      g_logMux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+// PostLogRecord
+//
+// Any task may post; the critical section only covers copying a few words into the ring
+
+void PostLogRecord(uint8_t level, const char * pszFunction, const char * pszFormat, uint8_t argCount, const uint32_t * pArgs)
+{
+    if (!Debug.isActive(level))
+        return;
+
+    LogRecord record;
+    record.pszFormat = pszFormat;
+    record.pszFunction = pszFunction;
+    record.timestamp = millis();
+    record.level = level;
+    record.core = static_cast<uint8_t>(xPortGetCoreID());
+    for (uint8_t i = 0; i < kMaxLogArgs; ++i)
+        record.args[i] = i < argCount ? pArgs[i] : 0;
+
+    portENTER_CRITICAL(&g_logMux);
+    const uint8_t next = (g_logHead + 1) & (kLogRingSize - 1);
+    if (next == g_logTail)
+    {
+        ++g_logDropped;
+    }
+    else
+    {
+        g_logRing[g_logHead] = record;
+        g_logHead = next;
+        g_logHighWater = std::max<uint8_t>(g_logHighWater, (g_logHead - g_logTail) & (kLogRingSize - 1));
+    }
+    portEXIT_CRITICAL(&g_logMux);
+}
+
+// DrainDeferredLog
+//
+// Called from the debug task: formats and prints everything that has been posted since the last call
+
+void DrainDeferredLog()
+{
+    for (;;)
+    {
+        portENTER_CRITICAL(&g_logMux);
+        const bool bEmpty = (g_logTail == g_logHead);
+        LogRecord record;
+        if (!bEmpty)
+            record = g_logRing[g_logTail];
+        portEXIT_CRITICAL(&g_logMux);
+
+        if (bEmpty)
+            return;
+
+        // Unused argument words are passed too; printf ignores what the format doesn't ask for
+        Debug.printf("(%s)(C%u)(+%u ms) ", record.pszFunction, record.core, millis() - record.timestamp);
+        Debug.printf(record.pszFormat, record.args[0], record.args[1], record.args[2], record.args[3], record.args[4], record.args[5]);
+        Debug.print("\r\n");
+
+        g_logTail = (g_logTail + 1) & (kLogRingSize - 1);
+        ++g_logWritten;
+    }
+}
+
+void ReportDeferredLogStats()
+{
+    debugI("Log: %u deferred records written, %u dropped, ring peak %u of %u", g_logWritten, g_logDropped, g_logHighWater, kLogRingSize - 1);
+}
@@ -1,50 +1,76 @@
 #include "globals.h"
 #include "drawing.h"
+#include "framestore.h"
+#include "showclock.h"
+#include "audio.h"
+#include "input.h"
+#include "scenes.h"
+#include "keyframeblender.h"
+#include "effectrandom.h"
+#include "powersave.h"
+#include "palettes.h"
+#include "ledmap.h"
+#include "ledspan.h"
+#include "particles.h"
+#include "jackpoteffect.h"
+#include "jackpotgoldens.h"
+#include "otamode.h"
+#include "deferredlog.h"
+#include "renderprofile.h"
+#include "preview.h"
+#include "remotepixels.h"
+#include "monitor.h"
 #include <ArduinoOTA.h>             // Over-the-air helper object so we can be flashed via WiFi
+#include <algorithm>
 #include <cstring>
+#include <new>
 
 // The g_buffer_mutex is a global mutex used to protect access while adding or removing frames
 // from the led buffer.  
 
 extern uint32_t           g_FPS;
 extern bool               g_bUpdateStarted;
+extern TaskHandle_t       g_taskDraw;
+extern TaskHandle_t       g_taskBake;
 
 namespace
 {
     constexpr uint16_t kGlobalHeartIntervalSeconds = 300;   // 5 minutes
     constexpr uint32_t kGlobalHeartDurationMs      = 15000;  // run heartbeat for 15s
+    constexpr uint8_t  kGlobalHeartRippleWaves     = 2;      // Rings between the heart and the farthest LED
+    constexpr uint32_t kGlobalHeartRippleMsPerStep = 4;      // A ring moves out one 1/256 wave every 4 ms
     constexpr uint32_t kMachineModeDurationMs      = 60000;  // rotate every minute
     constexpr uint8_t  kMachineLedCount            = theMachineLastLed - theMachineFirstLed + 1;
-    constexpr uint8_t  kJackpotSegments            = 8;
-    constexpr uint8_t  kJackpotLedsPerSegment      = 6;
-    constexpr uint8_t  kJackpotLedCount            = kJackpotSegments * kJackpotLedsPerSegment;
-    constexpr uint8_t  kJackpotDimScale            = 80;
-    constexpr uint32_t kJackpotModeDurationMs      = 15000;
-    constexpr uint32_t kJackpotDimmedDurationMs    = 60000;
-    constexpr uint32_t kJackpotClassicIntervalMs   = 220;
-    constexpr uint32_t kJackpotFillIntervalMs      = 180;
-    constexpr uint32_t kJackpotChaseIntervalMs     = 140;
-    constexpr uint32_t kJackpotMeteorIntervalMs    = 90;
-    constexpr uint32_t kJackpotRainbowIntervalMs   = 120;
-    constexpr uint32_t kJackpotSparkleIntervalMs   = 110;
-    constexpr uint32_t kJackpotPulseIntervalMs     = 100;
-    constexpr uint32_t kJackpotPlasmaIntervalMs    = 90;
-    constexpr uint32_t kJackpotDimmedIntervalMs    = 1000;
     constexpr uint8_t  kPlanetCount                = 5;
     constexpr uint16_t kPlanetSparkleIntervalMs    = 150;
-    constexpr uint8_t  kPlanetSparkleDecay         = 220;
+    constexpr uint16_t kPlanetSparkleLifeMs        = 175;   // A sparkle is at 14% when the next step mixes it in
     constexpr uint8_t  kShuttleFirstLed            = 55;
     constexpr uint8_t  kShuttleLedCount            = 3;
     constexpr uint32_t kShuttleModeDurationMs      = 15000;
     constexpr uint8_t  kStreetLedCount             = 5;
     constexpr uint32_t kStreetModeDurationMs       = 12000;
     constexpr uint32_t kStreetRunnerIntervalMs     = 120;
-    constexpr uint8_t  kStreetSparkleDecay         = 210;
+    constexpr uint16_t kStreetSparkleLifeMs        = 50;    // ...and a street sparkle at 18%
     constexpr uint32_t kShowcaseDimDurationMs      = 2500;
     constexpr uint32_t kShowcaseRampDurationMs     = 2000;
     constexpr uint32_t kShowcaseHoldDurationMs     = 1000;
-
-    constexpr uint8_t kPlanetIndices[kPlanetCount] = {
+    constexpr uint32_t kShowcaseFrameMs            = 20;
+    constexpr uint32_t kHeartbeatFrameMs           = 10;
+    constexpr uint32_t kGlobalHeartFrameMs         = 30;
+    constexpr uint32_t kMachineFrameMs             = 20;
+    constexpr uint32_t kMachineSparkleFrameMs      = 30;
+    constexpr uint32_t kMachineScannerFrameMs      = 40;
+    constexpr uint32_t kMachineIdleFrameMs         = 250;
+    constexpr uint32_t kShuttleFlickerFrameMs      = 35;
+    constexpr uint32_t kShuttleWaveFrameMs         = 45;
+    constexpr uint32_t kShuttleBoostFrameMs        = 30;
+    constexpr uint32_t kStreetFrameMs              = 40;
+    constexpr uint32_t kInterpolatedFrameMs        = 16;    // Output rate while a zone blends between keyframes
+    constexpr uint32_t kPausedZoneRecheckMs        = 30;
+    constexpr uint32_t kShowClockStepMs            = 5000;      // A bigger jump between passes is a clock step, not a slow pass
+    constexpr uint32_t kMaxDrawSleepMs             = 50;
+
+    HOT_RENDER_DATA constexpr uint8_t kPlanetIndices[kPlanetCount] = {
         moonTopLeft,
         bigBluePlanetLeftSide,
         bigBluePlanetRightSide,
@@ -52,7 +78,7 @@ namespace
         jupiterLower
     };
 
-    const CRGB kPlanetBaseColors[kPlanetCount] = {
+    HOT_RENDER_DATA const CRGB kPlanetBaseColors[kPlanetCount] = {
         CRGB::AntiqueWhite,
         CRGB::DeepSkyBlue,
         CRGB::DeepSkyBlue,
@@ -60,7 +86,7 @@ namespace
         CRGB::OrangeRed
     };
 
-    constexpr uint8_t kStreetIndices[kStreetLedCount] = {
+    HOT_RENDER_DATA constexpr uint8_t kStreetIndices[kStreetLedCount] = {
         people,
         carright1,
         carright2,
@@ -68,58 +94,148 @@ namespace
         carleft2
     };
 
+    constexpr uint8_t kBrideIndices[] = {
+        3, 5, 6, 62, 63, 64, 65, 66, 67, 68, 69, 79, 88, 94, 95, 96, 97,
+        98, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 115, 116, 117, 118
+    };
+
+    static_assert(IndicesWithin(kPlanetIndices, NUM_LEDS1), "A planet LED is outside leds1");
+    static_assert(IndicesWithin(kStreetIndices, NUM_LEDS1), "A street LED is outside leds1");
+    static_assert(IndicesWithin(kBrideIndices, NUM_LEDS1), "A bride LED is outside leds1");
+
+    volatile bool g_effectTriggers[static_cast<uint8_t>(EffectTrigger::Count)] = {};
+    volatile bool g_bTriggerPending = false;           // Pull every zone's deadline in so the owner sees it now
+
+    // ConsumeTrigger
+    //
+    // Returns true once for every TriggerEffect call, on the task that owns the effect
+
+    bool HOT_RENDER ConsumeTrigger(EffectTrigger trigger)
+    {
+        volatile bool & pending = g_effectTriggers[static_cast<uint8_t>(trigger)];
+        if (!pending)
+            return false;
+        pending = false;
+        return true;
+    }
+
+    // Every effect draws from its own random stream, so one effect's consumption never changes another's
+    // sequence and a run can be reproduced from a single seed
+
+    enum class RandomStream : uint8_t
+    {
+        Planets = 0,
+        Street,
+        Machine,
+        Spotlight,
+        Jackpot,
+        Shuttle,
+        Count
+    };
+
+    EffectRandom g_randomStreams[static_cast<uint8_t>(RandomStream::Count)];
+
+    EffectRandom & HOT_RENDER Stream(RandomStream stream)
+    {
+        return g_randomStreams[static_cast<uint8_t>(stream)];
+    }
+
+    void SeedEffectStreams(uint32_t seed)
+    {
+        for (uint8_t i = 0; i < static_cast<uint8_t>(RandomStream::Count); ++i)
+            g_randomStreams[i].Seed(seed ^ ((i + 1) * 0x9E3779B1));
+    }
+
+    // Particles
+    //
+    // One pool serves every zone that sparkles or streaks.  The draw loop steps it once per pass, before any
+    // zone, which leaves each zone's layer holding its particles as of this pass.
+
+    constexpr size_t kParticleCapacity = 64;
+
+    static_assert(kParticleCapacity == kFingerprintParticles, "Fingerprints should run with the live pool size");
+
+    enum class ParticleLayerId : uint8_t
+    {
+        Jackpot = 0,
+        Planets,
+        Street,
+        Count
+    };
+
+    CRGB g_jackpotParticleLayer[kJackpotLedCount] = {};
     CRGB g_planetSparkleLayer[kPlanetCount] = {};
+    CRGB g_streetSparkleLayer[kStreetLedCount] = {};
+
+    const ParticleLayer g_particleLayers[] = {
+        { g_jackpotParticleLayer, kJackpotLedCount },
+        { g_planetSparkleLayer,   kPlanetCount },
+        { g_streetSparkleLayer,   kStreetLedCount },
+    };
+
+    static_assert(sizeof(g_particleLayers) / sizeof(g_particleLayers[0]) == static_cast<uint8_t>(ParticleLayerId::Count),
+                  "Every particle layer needs an entry in g_particleLayers");
+
+    ParticlePool<kParticleCapacity> g_particles;
+    uint32_t g_lastParticleStep = 0;
+
+    void HOT_RENDER StepParticles(uint32_t now)
+    {
+        const int32_t elapsed = static_cast<int32_t>(now - g_lastParticleStep);
+        if (elapsed < 0)
+            return;                                     // A restart scheduled ahead; hold until its epoch
+        g_particles.Step(elapsed, g_particleLayers, static_cast<uint8_t>(ParticleLayerId::Count));
+        g_lastParticleStep = now;
+    }
+
+    bool HOT_RENDER EmitParticle(ParticleLayerId layer, uint8_t led, int16_t velocity, const CRGB & color, uint16_t lifeMs)
+    {
+        return g_particles.Emit(static_cast<uint8_t>(layer), static_cast<uint16_t>(led << 8), velocity, color, lifeMs);
+    }
+
     bool g_planetHighlightActive = false;
     uint32_t g_frontheadPulseStart = 0;
-    CRGB g_streetSparkleLayer[kStreetLedCount] = {};
     bool g_globalHeartActive = false;
     const CRGB kSpotlightColor = CRGB::White;
 
-
-    void UpdatePlanetSparkles()
+    void HOT_RENDER UpdatePlanetSparkles()
     {
         for (uint8_t i = 0; i < kPlanetCount; ++i)
-        {
-            g_planetSparkleLayer[i].fadeToBlackBy(kPlanetSparkleDecay);
             leds1[kPlanetIndices[i]] += g_planetSparkleLayer[i];
-        }
 
-        const uint8_t sparkleIdx = random8(kPlanetCount);
-        g_planetSparkleLayer[sparkleIdx] += CRGB::White;
+        const uint8_t sparkleIdx = Stream(RandomStream::Planets).Random8(kPlanetCount);
+        EmitParticle(ParticleLayerId::Planets, sparkleIdx, 0, GetZonePalette(LedZone::Planets)[kPaletteSparkle], kPlanetSparkleLifeMs);
     }
 
-    void UpdateFrontheadAccent()
+    void HOT_RENDER UpdateFrontheadAccent()
     {
         if (!g_planetHighlightActive)
             return;
 
         const uint8_t pulse = beatsin8(30, 40, 220);
-        CRGB accent = CRGB::White;
+        CRGB accent = GetZonePalette(LedZone::Planets)[kPaletteSparkle];   // The forehead lights with the planets
         accent.nscale8_video(pulse);
         leds1[fronthead] = accent;
     }
 
-    void RenderStreetPulse()
+    void HOT_RENDER RenderStreetPulse()
     {
         const uint8_t wave = beatsin8(24, 60, 255);
-        for (uint8_t i = 0; i < kStreetLedCount; ++i)
+        for (size_t i = 0; i < kStreetLedCount; ++i)
         {
-            CRGB color = CRGB::White;
+            CRGB color = GetZonePalette(LedZone::Street)[kPaletteSparkle];
             color.nscale8_video(wave);
             leds1[kStreetIndices[i]] = color;
         }
     }
 
-    void RenderStreetSparkle()
+    void HOT_RENDER RenderStreetSparkle()
     {
-        for (uint8_t i = 0; i < kStreetLedCount; ++i)
-        {
-            g_streetSparkleLayer[i].fadeToBlackBy(kStreetSparkleDecay);
+        for (size_t i = 0; i < kStreetLedCount; ++i)
             leds1[kStreetIndices[i]] += g_streetSparkleLayer[i];
-        }
 
-        const uint8_t sparkleIdx = random8(kStreetLedCount);
-        g_streetSparkleLayer[sparkleIdx] += CHSV(random8(), 200, 255);
+        const uint8_t sparkleIdx = Stream(RandomStream::Street).Random8(kStreetLedCount);
+        EmitParticle(ParticleLayerId::Street, sparkleIdx, 0, GetZonePalette(LedZone::Street)[Stream(RandomStream::Street).Random8()], kStreetSparkleLifeMs);
     }
 
     enum class MachineMode : uint8_t
@@ -133,20 +249,6 @@ namespace
         Count
     };
 
-    enum class JackpotMode : uint8_t
-    {
-        Classic = 0,
-        AlternatingFill,
-        DualChase,
-        Meteor,
-        RainbowSweep,
-        Sparkle,
-        Pulse,
-        Plasma,
-        DimmedHold,
-        Count
-    };
-
     enum class ShuttleMode : uint8_t
     {
         Flicker = 0,
@@ -163,98 +265,97 @@ namespace
         Count
     };
 
-    struct JackpotRuntime
-    {
-        JackpotMode mode = JackpotMode::Classic;
-        uint32_t modeStart = 0;
-        uint32_t nextFrame = 0;
-        uint32_t frameInterval = kJackpotClassicIntervalMs;
-        uint32_t modeDuration = kJackpotModeDurationMs;
-        uint8_t step = 0;
-        uint8_t secondary = 0;
-        bool forward = true;
-        uint8_t hueBase = 0;
-        bool dimOutput = true;
-    };
+    CRGB g_jackpotKeyframe[kJackpotLedCount];
+    KeyframeBlender<kJackpotLedCount> g_jackpotBlend;
 
-    JackpotRuntime g_jackpotRuntime;
-    CRGB g_jackpotFrame[kJackpotLedCount];
-
-    static const uint8_t kHeartbeatTable[] = {
-        25,  61, 105, 153, 197, 233, 253, 255,
-        252, 243, 230, 213, 194, 149, 101, 105,
-        153, 197, 216, 233, 244, 253, 255, 255,
-        252, 249, 243, 237, 230, 223, 213, 206,
-        194, 184, 174, 162, 149, 138, 126, 112,
-        101,  91,  78,  69,  62,  58,  51,  47,
-         43,  39,  37,  35,  29,  25,  22,  20,
-         19,  15,  12,   9,   8,   6,   5,   3
-    };
+    // GetPulseBrightness
+    //
+    // Follows the music when the audio task has a live analysis: full brightness on a beat, decaying over
+    // kAudioPulseDecayMs and never below the bass level.  Otherwise falls back to the heartbeat curve.
 
-    constexpr uint8_t HeartbeatTableSize()
+    constexpr uint32_t kAudioPulseDecayMs = 250;
+
+    uint8_t HOT_RENDER GetPulseBrightness(uint8_t bpm)
     {
-        return static_cast<uint8_t>(sizeof(kHeartbeatTable) / sizeof(kHeartbeatTable[0]));
+    #if ENABLE_AUDIO
+        AudioSnapshot audio;
+        if (GetAudioSnapshot(audio))
+        {
+            const uint32_t sinceBeat = millis() - audio.lastBeatMs;
+            const uint8_t beat = sinceBeat < kAudioPulseDecayMs ? 255 - (sinceBeat * 255 / kAudioPulseDecayMs) : 0;
+            return std::max(beat, audio.bands[0]);
+        }
+    #endif
+        return GetHeartbeatBrightness(bpm);
     }
 
-    uint8_t GetHeartbeatBrightness(uint8_t bpm = 35)
+    const CRGB * HOT_RENDER GetJackpotPalette()
     {
-        const uint8_t steps = HeartbeatTableSize();
-        const uint8_t hbIndex = lerp8by8(0, steps, beat8(bpm));
-        return lerp8by8(0, 255, kHeartbeatTable[hbIndex]);
+        return GetZonePalette(LedZone::Jackpot);
     }
 
-    void FillMachineRange(const CRGB & color)
+    const CRGB * GetBackglassPalette()
     {
-        for (uint8_t i = 0; i < kMachineLedCount; ++i)
-        {
-            leds1[theMachineFirstLed + i] = color;
-        }
+        return GetPalette(PaletteId::Backglass);
     }
 
-    void SetSpotlights(const CRGB & color)
+    JackpotEffect<kParticleCapacity> g_jackpot(&g_particles, static_cast<uint8_t>(ParticleLayerId::Jackpot), g_jackpotParticleLayer,
+                                               &g_randomStreams[static_cast<uint8_t>(RandomStream::Jackpot)],
+                                               GetJackpotPalette, GetPulseBrightness);
+
+    LedSpan<kMachineLedCount> MachineSpan()
+    {
+        return MakeLedSpan<theMachineFirstLed, kMachineLedCount, NUM_LEDS1>(leds1);
+    }
+
+    void HOT_RENDER FillMachineRange(const CRGB & color)
+    {
+        FillSpan(MachineSpan(), color);
+    }
+
+    void HOT_RENDER SetSpotlights(const CRGB & color)
     {
         leds1[spotlights1] = color;
         leds1[spotlights2] = color;
     }
 
-    void RenderMachineRainbow()
+    void HOT_RENDER ComputeMachineRainbow(LedSpan<kMachineLedCount> out)
     {
-        const uint8_t baseHue = beat8(12);
-        CHSV hsv(baseHue, 240, 255);
-        for (uint8_t i = 0; i < kMachineLedCount; ++i)
-        {
-            leds1[theMachineFirstLed + i] = hsv;
-            hsv.hue += 10;
-        }
-        FastLED.show();
+        FillSpanFromPalette(out, GetZonePalette(LedZone::Machine), beat8(12), 10);
     }
 
-    void RenderMachinePulse()
+    // Render functions only write the LED buffers and return how long until they want to run again; the draw
+    // loop does the single FastLED.show() for everything that changed.
+
+    uint32_t HOT_RENDER RenderMachineRainbow()
+    {
+        ComputeMachineRainbow(MachineSpan());
+        return kMachineFrameMs;
+    }
+
+    uint32_t HOT_RENDER RenderMachinePulse()
     {
-        CRGB color = CRGB::DeepPink;
-        color.nscale8_video(GetHeartbeatBrightness(30));
+        CRGB color = GetZonePalette(LedZone::Machine)[kPalettePulse];
+        color.nscale8_video(GetPulseBrightness(30));
         FillMachineRange(color);
-        FastLED.show();
+        return kMachineFrameMs;
     }
 
-    void RenderMachineSparkle()
+    uint32_t HOT_RENDER RenderMachineSparkle()
     {
-        fadeToBlackBy(&leds1[theMachineFirstLed], kMachineLedCount, 40);
-        const uint8_t idx = random8(kMachineLedCount);
-        leds1[theMachineFirstLed + idx] = CRGB::White;
-        FastLED.show();
-        delay(30);
+        const LedSpan<kMachineLedCount> machine = MachineSpan();
+        FadeSpanToBlackBy(machine, 40);
+        machine[Stream(RandomStream::Machine).Random8(kMachineLedCount)] = GetZonePalette(LedZone::Machine)[kPaletteSparkle];
+        return kMachineSparkleFrameMs;
     }
 
-    void RenderMachineScanner()
+    uint32_t HOT_RENDER RenderMachineScanner()
     {
         static int8_t direction = 1;
         static uint8_t position = 0;
 
         FillMachineRange(CRGB::Black);
-        const uint8_t ledIndex = theMachineFirstLed + position;
-        leds1[ledIndex] = CRGB::Red;
-        FastLED.show();
+        MachineSpan()[position] = GetZonePalette(LedZone::Machine)[kPalettePrimary];
 
         if (position == 0)
             direction = 1;
@@ -262,13 +363,18 @@ namespace
             direction = -1;
 
         position = static_cast<uint8_t>(position + direction);
-        delay(40);
+        return kMachineScannerFrameMs;
     }
 
+    constexpr uint8_t  kSpotlightFlickerBursts = 6;
+    constexpr uint8_t  kSpotlightRampSteps     = 4;
+    constexpr uint32_t kSpotlightRampFrameMs   = 65;
+
     struct ShowcaseState
     {
         bool initialized = false;
         uint8_t stage = 0;
+        uint8_t flickerStep = 0;
         uint32_t stageStart = 0;
     };
 
@@ -279,16 +385,42 @@ namespace
         g_showcaseState = ShowcaseState{};
     }
 
-    uint8_t ShowcaseIntensity(uint32_t elapsed)
+    uint8_t HOT_RENDER ShowcaseIntensity(uint32_t elapsed)
     {
         if (elapsed >= kShowcaseRampDurationMs)
             return 255;
         return static_cast<uint8_t>((elapsed * 255UL) / kShowcaseRampDurationMs);
     }
 
-    void RenderMachineShowcase()
+    // StepSpotlightFlicker
+    //
+    // One step of the spotlight flicker-and-ramp that opens the showcase, the non-blocking equivalent of
+    // FlickerSpotlights.  Returns 0 once the spotlights are fully on.
+
+    uint32_t HOT_RENDER StepSpotlightFlicker(uint8_t step, const CRGB & color)
     {
-        const uint32_t now = millis();
+        if (step < kSpotlightFlickerBursts)
+        {
+            SetSpotlights((step % 2 == 0) ? CRGB(CRGB::Black) : color);
+            return Stream(RandomStream::Spotlight).Random8(25, 90);
+        }
+
+        step -= kSpotlightFlickerBursts;
+        if (step < kSpotlightRampSteps)
+        {
+            CRGB ramp = color;
+            ramp.nscale8_video(lerp8by8(30, 255, static_cast<uint8_t>((step * 255) / (kSpotlightRampSteps - 1))));
+            SetSpotlights(ramp);
+            return kSpotlightRampFrameMs;
+        }
+
+        SetSpotlights(color);
+        return 0;
+    }
+
+    uint32_t HOT_RENDER RenderMachineShowcase()
+    {
+        const uint32_t now = ShowMillis();
         if (!g_showcaseState.initialized)
         {
             g_showcaseState.initialized = true;
@@ -298,7 +430,7 @@ namespace
 
         auto advanceStage = [&](uint8_t nextStage) {
             g_showcaseState.stage = nextStage;
-            g_showcaseState.stageStart = millis();
+            g_showcaseState.stageStart = ShowMillis();
         };
 
         switch (g_showcaseState.stage)
@@ -306,9 +438,10 @@ namespace
             case 0:
             {
                 g_planetHighlightActive = false;
-                FlickerSpotlights(spotlights1, spotlights2, kSpotlightColor);
-                SetSpotlights(kSpotlightColor);
-                FastLED.show();
+                const uint32_t wait = StepSpotlightFlicker(g_showcaseState.flickerStep++, kSpotlightColor);
+                if (wait != 0)
+                    return wait;
+                g_showcaseState.flickerStep = 0;
                 advanceStage(1);
                 break;
             }
@@ -318,7 +451,6 @@ namespace
                 fadeToBlackBy(leds0, NUM_LEDS0, 20);
                 fadeToBlackBy(leds1, NUM_LEDS1, 20);
                 SetSpotlights(kSpotlightColor);
-                FastLED.show();
                 if (now - g_showcaseState.stageStart >= kShowcaseDimDurationMs)
                 {
                     advanceStage(2);
@@ -333,7 +465,6 @@ namespace
                 machineColor.nscale8_video(ShowcaseIntensity(elapsed));
                 FillMachineRange(machineColor);
                 SetSpotlights(kSpotlightColor);
-                FastLED.show();
                 if (elapsed >= kShowcaseRampDurationMs + kShowcaseHoldDurationMs)
                 {
                     advanceStage(3);
@@ -355,7 +486,6 @@ namespace
                 }
                 SetSpotlights(kSpotlightColor);
                 UpdateFrontheadAccent();
-                FastLED.show();
                 if (elapsed >= kShowcaseRampDurationMs + kShowcaseHoldDurationMs)
                 {
                     advanceStage(4);
@@ -370,7 +500,6 @@ namespace
                 foreheadColor.nscale8_video(ShowcaseIntensity(elapsed));
                 leds1[fronthead] = foreheadColor;
                 SetSpotlights(kSpotlightColor);
-                FastLED.show();
                 if (elapsed >= kShowcaseRampDurationMs + kShowcaseHoldDurationMs)
                 {
                     advanceStage(0);
@@ -382,16 +511,17 @@ namespace
                 advanceStage(0);
                 break;
         }
+        return kShowcaseFrameMs;
     }
 
-    void RenderMachineIdle()
+    uint32_t HOT_RENDER RenderMachineIdle()
     {
         static const CRGB idleColor(246, 200, 160);
         FillMachineRange(idleColor);
-        FastLED.show();
+        return kMachineIdleFrameMs;
     }
 
-    void RunMachineMode(MachineMode mode)
+    uint32_t HOT_RENDER RunMachineMode(MachineMode mode)
     {
         if (mode != MachineMode::Showcase)
         {
@@ -401,25 +531,19 @@ namespace
         switch (mode)
         {
             case MachineMode::Rainbow:
-                RenderMachineRainbow();
-                break;
+                return RenderMachineRainbow();
             case MachineMode::Pulse:
-                RenderMachinePulse();
-                break;
+                return RenderMachinePulse();
             case MachineMode::Sparkle:
-                RenderMachineSparkle();
-                break;
+                return RenderMachineSparkle();
             case MachineMode::Scanner:
-                RenderMachineScanner();
-                break;
+                return RenderMachineScanner();
             case MachineMode::Showcase:
-                RenderMachineShowcase();
-                break;
+                return RenderMachineShowcase();
             case MachineMode::Idle:
-                RenderMachineIdle();
-                break;
+                return RenderMachineIdle();
             default:
-                break;
+                return kMachineIdleFrameMs;
         }
     }
 
@@ -451,508 +575,1055 @@ namespace
         return kActiveModes[idx];
     }
 
-    void RunGlobalHeartMode()
+    uint32_t g_globalHeartStart = 0;
+
+    void StartGlobalHeartMode(uint32_t now)
     {
+        g_globalHeartStart = now;
         g_globalHeartActive = true;
-        const uint32_t start = millis();
-        while (millis() - start < kGlobalHeartDurationMs)
+    }
+
+    // RenderGlobalHeartMode
+    //
+    // While the global heartbeat runs it owns both strips and the other zones are held.  Returns false once
+    // it has run for kGlobalHeartDurationMs.
+
+    bool HOT_RENDER RenderGlobalHeartMode(uint32_t now)
+    {
+        if (now - g_globalHeartStart >= kGlobalHeartDurationMs)
         {
-            const uint8_t brightness = GetHeartbeatBrightness();
-            CRGB strip0 = CRGB::Red;
-            strip0.nscale8_video(brightness);
-            CRGB strip1 = CRGB::BlueViolet;
-            strip1.nscale8_video(brightness);
-
-            fill_solid(leds0, NUM_LEDS0, strip0);
-            fill_solid(leds1, NUM_LEDS1, strip1);
-            FastLED.show();
-            delay(30);
+            g_globalHeartActive = false;
+            g_jackpotBlend.Invalidate();
+            return false;
         }
-        g_globalHeartActive = false;
+
+        // Each beat ripples out from the heart across the whole glass, turning from red to violet as it goes
+        const uint8_t brightness = GetHeartbeatBrightness();
+        const uint8_t phase = static_cast<uint8_t>((now - g_globalHeartStart) / kGlobalHeartRippleMsPerStep);
+        const uint8_t * pDistance = GetFeatureDistances(MapFeature::Heart);
+        for (uint16_t i = 0; i < kMapLedCount; ++i)
+        {
+            CRGB color = blend(CRGB(CRGB::Red), CRGB(CRGB::BlueViolet), pDistance[i]);
+            color.nscale8_video(scale8(sin8(pDistance[i] * kGlobalHeartRippleWaves - phase), brightness));
+            MapLed(i) = color;
+        }
+        return true;
     }
 
-    CRGB DimJackpotColor(CRGB color)
+    void HOT_RENDER RenderHeartbeat(int channel)
     {
-        color.nscale8_video(kJackpotDimScale);
-        return color;
+        uint8_t brightness = GetHeartbeatBrightness();
+    #if ENABLE_AUDIO
+        AudioSnapshot audio;
+        if (GetAudioSnapshot(audio))
+            brightness = 255 - GetPulseBrightness(35);     // The heart fades by this amount, so invert the pulse
+    #endif
+      if(channel == 0) {
+        leds0[NUM_LEDS0 -1] = CRGB::Red;
+        leds0[NUM_LEDS0 -1].fadeLightBy(brightness);
+      } else if (channel == 1) {
+        leds0[NUM_LEDS0 -2] = CRGB::BlueViolet;
+        leds0[NUM_LEDS0 -2].fadeLightBy(brightness);
+        leds0[NUM_LEDS0 -3] = CRGB::BlueViolet;
+        leds0[NUM_LEDS0 -3].fadeLightBy(brightness);
+        leds0[NUM_LEDS0 -4] = CRGB::BlueViolet;
+        leds0[NUM_LEDS0 -4].fadeLightBy(brightness);
+        leds0[NUM_LEDS0 -5] = CRGB::BlueViolet;
+        leds0[NUM_LEDS0 -5].fadeLightBy(brightness);
+      }
     }
 
-    void SetJackpotLed(uint8_t index, const CRGB & color)
+    // Effect baking
+    //
+    // The jackpot rotation and the machine rainbow are deterministic given time and RNG seed, so they can be
+    // rendered ahead of time against a virtual clock and stored as a looping frame file.  Writing SPIFFS is slow,
+    // so the file is written by a low-priority bake task while the draw task renders the frames a few at a time
+    // between its own passes into a small queue that the bake task drains.  The bake keeps its own jackpot state
+    // and only swaps it in while it renders, so the live show carries on throughout.
+
+    constexpr uint16_t kBakeFrameIntervalMs = 30;
+    constexpr size_t   kBakeNameLength      = 20;
+    constexpr uint8_t  kBakeQueuedFrames    = 8;
+    constexpr uint8_t  kBakeFramesPerPass   = 4;       // Well under a millisecond added to a draw pass
+    constexpr size_t   kBakeFrameLeds       = kJackpotLedCount + kMachineLedCount;
+
+    struct BakeRequest
     {
-        g_jackpotFrame[index] = color;
+        volatile bool pending = false;
+        char name[kBakeNameLength + 1] = {};
+        uint32_t seconds = 0;
+        uint16_t seed = 0;
+    };
+
+    BakeRequest g_bakeRequest;
+
+    // A running bake.  Only the draw task writes frames and bumps rendered, and only the bake task reads them and
+    // bumps taken, so the queue needs no lock.
+
+    struct BakeState
+    {
+        volatile bool     running = false;
+        uint32_t          frameCount = 0;
+        uint32_t          clockMs = 0;                      // Virtual show time of the next frame
+        volatile uint32_t rendered = 0;
+        volatile uint32_t taken = 0;
+        CRGB              frames[kBakeQueuedFrames][kBakeFrameLeds];
+    };
+
+    BakeState g_bake;
+
+    // The jackpot state a bake borrows, put back afterwards so the live effect carries on
+
+    struct JackpotSnapshot
+    {
+        JackpotEffect<kParticleCapacity>::State jackpot;
+        EffectRandom streams[static_cast<uint8_t>(RandomStream::Count)];
+        ParticlePool<kParticleCapacity> particles;
+        uint32_t lastParticleStep;
+    };
+
+    JackpotSnapshot g_liveJackpot;
+    JackpotSnapshot g_bakeJackpot;
+
+    void SaveJackpotState(JackpotSnapshot & snapshot)
+    {
+        g_jackpot.SaveState(snapshot.jackpot);
+        memcpy(snapshot.streams, g_randomStreams, sizeof(snapshot.streams));
+        snapshot.particles = g_particles;
+        snapshot.lastParticleStep = g_lastParticleStep;
     }
 
-    void FillJackpotSegment(uint8_t segment, const CRGB & color)
+    void LoadJackpotState(const JackpotSnapshot & snapshot)
     {
-        const uint8_t base = segment * kJackpotLedsPerSegment;
-        for (uint8_t i = 0; i < kJackpotLedsPerSegment; ++i)
-        {
-            SetJackpotLed(base + i, color);
-        }
+        g_jackpot.LoadState(snapshot.jackpot);
+        memcpy(g_randomStreams, snapshot.streams, sizeof(snapshot.streams));
+        g_particles = snapshot.particles;
+        g_lastParticleStep = snapshot.lastParticleStep;
     }
 
-    void ClearJackpotRange()
+    void SaveLiveJackpot()
     {
-        for (uint8_t i = 0; i < kJackpotLedCount; ++i)
-        {
-            g_jackpotFrame[i] = CRGB::Black;
-        }
+        SaveJackpotState(g_liveJackpot);
     }
 
-    void ShowJackpotDimmed()
+    void RestoreLiveJackpot()
     {
-        const bool shouldDim = g_planetHighlightActive || g_jackpotRuntime.dimOutput;
-        for (uint8_t i = 0; i < kJackpotLedCount; ++i)
+        LoadJackpotState(g_liveJackpot);
+    }
+
+    // Starts a bake from an empty particle pool on virtual time, so it does not depend on
+    // what the live zones had in flight
+
+    void ResetParticlesForRun()
+    {
+        g_particles.Clear();
+        g_lastParticleStep = ShowMillis();
+    }
+
+    // BakeTaskEntry
+    //
+    // Writes the frames the draw task queues to the frame file, then deletes itself
+
+    void BakeTaskEntry(void *)
+    {
+        FrameFileHeader layout;
+        InitFrameFileHeader(layout, kBakeFrameIntervalMs);
+        layout.flags = kFrameFileFlagLoop;
+        AddFrameFileSpan(layout, 0, 0, kJackpotLedCount);
+        AddFrameFileSpan(layout, 1, theMachineFirstLed, kMachineLedCount);
+
+        const uint32_t start = millis();
+        const bool bWritten = WriteFrameFile(g_bakeRequest.name, layout, g_bake.frameCount, [](uint32_t frame, uint8_t * pPixels)
         {
-            leds0[i] = shouldDim ? DimJackpotColor(g_jackpotFrame[i]) : g_jackpotFrame[i];
-        }
-        FastLED.show();
+            while (g_bake.rendered <= frame)
+                vTaskDelay(1);
+            __sync_synchronize();
+            memcpy(pPixels, g_bake.frames[frame % kBakeQueuedFrames], sizeof(g_bake.frames[0]));
+            __sync_synchronize();
+            g_bake.taken = frame + 1;
+            WakeDrawLoop();
+        });
+        if (bWritten)
+            debugI("Baked %u s of effects in %u ms", g_bakeRequest.seconds, millis() - start);
+        else
+            debugW("Baking %u s of effects failed", g_bakeRequest.seconds);
+
+        g_bake.running = false;
+        ExitMonitoredTask(g_taskBake);
     }
 
-    void ApplyJackpotDefaultColors()
+    // StartEffectBake
+    //
+    // Sets up the bake's own jackpot state from the requested seed and starts the bake task
+
+    void StartEffectBake()
     {
-        for (uint8_t segment = 0; segment < kJackpotSegments; ++segment)
+        SaveLiveJackpot();
+        SeedEffectStreams(g_bakeRequest.seed);
+        BeginVirtualShowTime(1);
+        g_jackpot.Reset(JackpotMode::Classic, ShowMillis());
+        ResetParticlesForRun();
+        g_bake.clockMs = ShowMillis();
+        EndVirtualShowTime();
+        SaveJackpotState(g_bakeJackpot);
+        RestoreLiveJackpot();
+
+        g_bake.frameCount = g_bakeRequest.seconds * 1000 / kBakeFrameIntervalMs;
+        g_bake.rendered = 0;
+        g_bake.taken = 0;
+        g_bake.running = true;
+        g_bakeRequest.pending = false;
+        if (pdPASS != xTaskCreatePinnedToCore(BakeTaskEntry, "Bake", kEffectBakeStackSize, nullptr, tskIDLE_PRIORITY + 1, &g_taskBake, NET_CORE))
         {
-            const CRGB color = (segment < (kJackpotSegments / 2)) ? CRGB::DarkOrange : CRGB::Red;
-            FillJackpotSegment(segment, color);
+            g_bake.running = false;
+            logW("Could not start the bake task");
         }
     }
 
-    uint32_t JackpotIntervalForMode(JackpotMode mode)
+    // RenderBakeFrames
+    //
+    // Called by the draw task on every pass.  Starts a requested bake and tops up its queue by at most
+    // kBakeFramesPerPass frames.
+
+    void RenderBakeFrames()
     {
-        switch (mode)
+        if (g_bakeRequest.pending && !g_bake.running)
+            StartEffectBake();
+        if (!g_bake.running)
+            return;
+
+        const uint32_t rendered = g_bake.rendered;
+        const uint32_t count = std::min({ g_bake.frameCount - rendered,
+                                          kBakeQueuedFrames - (rendered - g_bake.taken),
+                                          static_cast<uint32_t>(kBakeFramesPerPass) });
+        if (count == 0)
+            return;
+
+        SaveLiveJackpot();
+        LoadJackpotState(g_bakeJackpot);
+        BeginVirtualShowTime(g_bake.clockMs);
+        for (uint32_t frame = rendered; frame < rendered + count; ++frame)
         {
-            case JackpotMode::Classic:
-                return kJackpotClassicIntervalMs;
-            case JackpotMode::AlternatingFill:
-                return kJackpotFillIntervalMs;
-            case JackpotMode::DualChase:
-                return kJackpotChaseIntervalMs;
-            case JackpotMode::Meteor:
-                return kJackpotMeteorIntervalMs;
-            case JackpotMode::RainbowSweep:
-                return kJackpotRainbowIntervalMs;
-            case JackpotMode::Sparkle:
-                return kJackpotSparkleIntervalMs;
-            case JackpotMode::Pulse:
-                return kJackpotPulseIntervalMs;
-            case JackpotMode::Plasma:
-                return kJackpotPlasmaIntervalMs;
-            case JackpotMode::DimmedHold:
-                return kJackpotDimmedIntervalMs;
-            default:
-                return kJackpotClassicIntervalMs;
+            CRGB * pOut = g_bake.frames[frame % kBakeQueuedFrames];
+            StepParticles(ShowMillis());
+            g_jackpot.Advance(ShowMillis());
+            g_jackpot.Compose(LedSpan<kJackpotLedCount>(pOut), false);
+            ComputeMachineRainbow(LedSpan<kMachineLedCount>(pOut + kJackpotLedCount));
+            AdvanceVirtualShowTime(kBakeFrameIntervalMs);
         }
+        g_bake.clockMs = ShowMillis();
+        EndVirtualShowTime();
+        SaveJackpotState(g_bakeJackpot);
+        RestoreLiveJackpot();
+
+        __sync_synchronize();
+        g_bake.rendered = rendered + count;
     }
 
-    uint32_t JackpotDurationForMode(JackpotMode mode)
+    // Effect fingerprints
+    //
+    // Renders every jackpot mode from a seed with JackpotFingerprint, on virtual time, and checks the hash of the
+    // frames against the golden hashes tools/effectcheck.cpp produced from the same code on the host.  A mode
+    // passes if it drew exactly what the host did and its average frame, hashing included, stayed within
+    // kFingerprintFrameBudgetUs.  Seeds without goldens still report their hashes and timings.
+
+    constexpr uint32_t kFingerprintFrameBudgetUs = 250;
+
+    volatile bool g_bFingerprintPending = false;
+    uint16_t g_fingerprintSeed = 0;
+
+    const JackpotGolden * FindJackpotGolden(uint16_t seed)
     {
-        if (mode == JackpotMode::DimmedHold)
+        for (const JackpotGolden & golden : kJackpotGoldens)
         {
-            return kJackpotDimmedDurationMs;
+            if (golden.seed == seed)
+                return &golden;
         }
-        return kJackpotModeDurationMs;
+        return nullptr;
     }
 
-    void ResetJackpotRuntime(JackpotMode mode, uint32_t now)
+    // BenchmarkZoneKernels
+    //
+    // Times the span kernels against the runtime-count calls and uint8_t loops they replaced, at one zone's size.
+    // The jackpot modes are built from these (fill for Pulse and the segment modes, fade for Meteor and Sparkle,
+    // the palette walk for RainbowSweep and the machine rainbow), so this is where their gain comes from.
+
+    constexpr uint16_t kKernelBenchIterations = 200;
+
+    template <size_t LedCount>
+    void BenchmarkZoneKernels(const char * pszZone)
     {
-        g_jackpotRuntime = JackpotRuntime{};
-        g_jackpotRuntime.mode = mode;
-        g_jackpotRuntime.modeStart = now;
-        g_jackpotRuntime.nextFrame = now;
-        g_jackpotRuntime.frameInterval = JackpotIntervalForMode(mode);
-        g_jackpotRuntime.modeDuration = JackpotDurationForMode(mode);
-        g_jackpotRuntime.dimOutput = true;
+        CRGB leds[LedCount];
+        const LedSpan<LedCount> span = SpanOf(leds);
+        const CRGB * pPalette = GetZonePalette(LedZone::Jackpot);
+        volatile size_t runtimeCount = LedCount;       // Stops the compiler from specialising the generic calls itself
 
-        bool shouldClear = true;
-        switch (mode)
+        auto nanosPerCall = [](auto kernel)
         {
-            case JackpotMode::Classic:
-                g_jackpotRuntime.step = 0;
-                g_jackpotRuntime.secondary = kJackpotSegments;
-                g_jackpotRuntime.forward = true;
-                break;
-            case JackpotMode::AlternatingFill:
-                g_jackpotRuntime.step = 0;
-                g_jackpotRuntime.secondary = 0;
-                g_jackpotRuntime.dimOutput = false;
-                break;
-            case JackpotMode::DualChase:
-                g_jackpotRuntime.step = 0;
-                g_jackpotRuntime.secondary = kJackpotLedCount - 1;
-                g_jackpotRuntime.dimOutput = false;
-                break;
-            case JackpotMode::Meteor:
-                g_jackpotRuntime.step = 0;
-                break;
-            case JackpotMode::RainbowSweep:
-                g_jackpotRuntime.hueBase = 0;
-                break;
-            case JackpotMode::Plasma:
-                g_jackpotRuntime.step = 0;
-                g_jackpotRuntime.hueBase = 0;
-                break;
-            case JackpotMode::DimmedHold:
-                ApplyJackpotDefaultColors();
-                g_jackpotRuntime.step = 0;
-                shouldClear = false;
-                break;
-            case JackpotMode::Sparkle:
-            case JackpotMode::Pulse:
-            default:
-                break;
+            const uint32_t start = micros();
+            for (uint16_t i = 0; i < kKernelBenchIterations; ++i)
+                kernel(static_cast<uint8_t>(i));
+            return (micros() - start) * 1000 / kKernelBenchIterations;
+        };
+
+        const uint32_t fillGeneric = nanosPerCall([&](uint8_t i) { fill_solid(leds, runtimeCount, pPalette[i]); });
+        const uint32_t fillSpan = nanosPerCall([&](uint8_t i) { FillSpan(span, pPalette[i]); });
+        const uint32_t fadeGeneric = nanosPerCall([&](uint8_t) { fadeToBlackBy(leds, runtimeCount, 40); });
+        const uint32_t fadeSpan = nanosPerCall([&](uint8_t) { FadeSpanToBlackBy(span, 40); });
+        const uint32_t walkGeneric = nanosPerCall([&](uint8_t i)
+        {
+            const size_t count = runtimeCount;
+            for (uint8_t led = 0; led < count; ++led)
+                leds[led] = pPalette[static_cast<uint8_t>(i + led * 4)];
+        });
+        const uint32_t walkSpan = nanosPerCall([&](uint8_t i) { FillSpanFromPalette(span, pPalette, i, 4); });
+
+        logI("%s kernels, %u LEDs, generic/specialised ns:", pszZone, static_cast<unsigned>(LedCount));
+        logI("  fill %u/%u, fade %u/%u, palette walk %u/%u", fillGeneric, fillSpan, fadeGeneric, fadeSpan, walkGeneric, walkSpan);
+    }
+
+    // BenchmarkParticles
+    //
+    // Times a step of a full pool of Capacity particles moving over a jackpot-sized layer.  Pools this size are
+    // only ever made here, for the run, to see what a bigger live pool would cost.
+
+    constexpr uint16_t kParticleBenchSteps = 50;
+
+    template <size_t Capacity>
+    void BenchmarkParticles()
+    {
+        ParticlePool<Capacity> * pPool = new (std::nothrow) ParticlePool<Capacity>;
+        if (nullptr == pPool)
+        {
+            logW("No memory to benchmark %u particles", static_cast<unsigned>(Capacity));
+            return;
         }
 
-        if (shouldClear)
+        CRGB leds[kJackpotLedCount];
+        const ParticleLayer layer = { leds, kJackpotLedCount };
+        EffectRandom random(Capacity);
+        uint32_t totalUs = 0;
+        for (uint16_t step = 0; step < kParticleBenchSteps; ++step)
         {
-            ClearJackpotRange();
+            while (pPool->size() < Capacity)
+            {
+                const uint16_t position = static_cast<uint16_t>(random.Random8(kJackpotLedCount) << 8);
+                pPool->Emit(0, position, static_cast<int8_t>(random.Random8()), CRGB(random.Next() & 0xFFFFFF), 2000);
+            }
+            const uint32_t start = micros();
+            pPool->Step(16, &layer, 1);
+            totalUs += micros() - start;
         }
+        logI("Particles: %u in %u bytes, step avg %u us, %u ns per particle", static_cast<unsigned>(Capacity),
+             static_cast<unsigned>(sizeof(*pPool)), totalUs / kParticleBenchSteps, static_cast<unsigned>(totalUs * 1000 / kParticleBenchSteps / Capacity));
+        delete pPool;
     }
 
-    void StepJackpotClassic()
+    void RunEffectFingerprint()
     {
-        if (g_jackpotRuntime.secondary < kJackpotSegments && g_jackpotRuntime.secondary != g_jackpotRuntime.step)
+        if (nullptr == GetBackglassPalette())
         {
-            FillJackpotSegment(g_jackpotRuntime.secondary, CRGB::Black);
+            logW("Fingerprint seed %u: FAIL, no Backglass palette", g_fingerprintSeed);
+            return;
         }
-        FillJackpotSegment(g_jackpotRuntime.step, CRGB::Red);
-        g_jackpotRuntime.secondary = g_jackpotRuntime.step;
 
-        if (g_jackpotRuntime.forward)
+        const JackpotGolden * pGolden = FindJackpotGolden(g_fingerprintSeed);
+        bool bHashesMatch = nullptr != pGolden;
+        bool bAllWithinBudget = true;
+        for (uint8_t mode = 0; mode < static_cast<uint8_t>(JackpotMode::Count); ++mode)
         {
-            if (g_jackpotRuntime.step >= kJackpotSegments - 1)
+            auto * pRun = new (std::nothrow) JackpotFingerprint(static_cast<JackpotMode>(mode), g_fingerprintSeed, GetBackglassPalette);
+            if (nullptr == pRun)
             {
-                g_jackpotRuntime.forward = false;
-                if (kJackpotSegments > 1)
-                    g_jackpotRuntime.step = kJackpotSegments - 2;
+                logW("No memory to fingerprint jackpot mode %u", mode);
+                bHashesMatch = false;
+                continue;
             }
-            else
+
+            uint32_t totalUs = 0;
+            uint32_t maxUs = 0;
+            BeginVirtualShowTime(kFingerprintStartMs);
+            for (uint16_t i = 0; i < kFingerprintFrames; ++i)
             {
-                ++g_jackpotRuntime.step;
+                const uint32_t start = micros();
+                pRun->RenderFrame(ShowMillis());
+                const uint32_t elapsed = micros() - start;
+
+                totalUs += elapsed;
+                maxUs = std::max(maxUs, elapsed);
+                AdvanceVirtualShowTime(kFingerprintFrameMs);
             }
-        }
-        else
-        {
-            if (g_jackpotRuntime.step == 0 || kJackpotSegments == 1)
+            EndVirtualShowTime();
+            const uint32_t hash = pRun->hash();
+            delete pRun;
+
+            const uint32_t avgUs = totalUs / kFingerprintFrames;
+            const bool bWithinBudget = avgUs <= kFingerprintFrameBudgetUs;
+            bAllWithinBudget &= bWithinBudget;
+            if (pGolden)
             {
-                g_jackpotRuntime.forward = true;
-                if (kJackpotSegments > 1)
-                    g_jackpotRuntime.step = 1;
+                const bool bMatch = hash == pGolden->hashes[mode];
+                bHashesMatch &= bMatch;
+                logI("Jackpot mode %u: hash %08x %s, avg %u us %s, max %u us", mode, hash, bMatch ? "PASS" : "FAIL",
+                     avgUs, bWithinBudget ? "PASS" : "FAIL", maxUs);
+                if (!bMatch)
+                    logW("Jackpot mode %u: golden hash is %08x", mode, pGolden->hashes[mode]);
             }
             else
             {
-                --g_jackpotRuntime.step;
+                logI("Jackpot mode %u: hash %08x, avg %u us %s, max %u us", mode, hash, avgUs, bWithinBudget ? "PASS" : "FAIL", maxUs);
             }
         }
+
+        if (nullptr == pGolden)
+            logW("Fingerprint seed %u: no golden hashes for this seed, budget %s", g_fingerprintSeed, bAllWithinBudget ? "PASS" : "FAIL");
+        else if (bHashesMatch && bAllWithinBudget)
+            logI("Fingerprint seed %u: PASS", g_fingerprintSeed);
+        else
+            logW("Fingerprint seed %u: FAIL, hashes %s, %u us frame budget %s", g_fingerprintSeed, bHashesMatch ? "match" : "differ",
+                 kFingerprintFrameBudgetUs, bAllWithinBudget ? "met" : "exceeded");
+
+        BenchmarkZoneKernels<kJackpotLedCount>("Jackpot");
+        BenchmarkZoneKernels<kMachineLedCount>("Machine");
+        BenchmarkZoneKernels<kShuttleLedCount>("Shuttle");
+        BenchmarkParticles<64>();
+        BenchmarkParticles<256>();
+        BenchmarkParticles<1024>();
+
+        g_bFingerprintPending = false;
     }
 
-    void StepJackpotAlternatingFill()
+    LedSpan<kShuttleLedCount> ShuttleSpan()
     {
-        static const CRGB palette[] = { CRGB::DarkOrange, CRGB::Gold, CRGB::Red };
-        constexpr size_t paletteSize = sizeof(palette) / sizeof(palette[0]);
-
-        FillJackpotSegment(g_jackpotRuntime.step, palette[g_jackpotRuntime.secondary]);
-        ++g_jackpotRuntime.step;
+        return MakeLedSpan<kShuttleFirstLed, kShuttleLedCount, NUM_LEDS1>(leds1);
+    }
 
-        if (g_jackpotRuntime.step >= kJackpotSegments)
+    uint32_t HOT_RENDER RenderShuttleFlicker()
+    {
+        const CRGB * pPalette = GetZonePalette(LedZone::Shuttle);
+        const LedSpan<kShuttleLedCount> segment = ShuttleSpan();
+        for (size_t i = 0; i < kShuttleLedCount; ++i)
         {
-            g_jackpotRuntime.step = 0;
-            g_jackpotRuntime.secondary = static_cast<uint8_t>((g_jackpotRuntime.secondary + 1) % paletteSize);
-            if (g_jackpotRuntime.secondary == 0)
-            {
-                ClearJackpotRange();
-            }
+            const uint8_t heat = Stream(RandomStream::Shuttle).Random8(160, 255);
+            segment[i] = pPalette[kPaletteFlame + Stream(RandomStream::Shuttle).Random8(8)];
+            segment[i].nscale8_video(heat);
         }
+        return kShuttleFlickerFrameMs;
     }
 
-    void StepJackpotDualChase()
+    uint32_t HOT_RENDER RenderShuttleWave()
     {
-        ClearJackpotRange();
-        uint8_t left = g_jackpotRuntime.step;
-        uint8_t right = g_jackpotRuntime.secondary;
-        if (left < kJackpotLedCount)
-            SetJackpotLed(left, CRGB::Cyan);
-        if (right < kJackpotLedCount)
-            SetJackpotLed(right, CRGB::Magenta);
-
-        if (left >= right || right == 0)
+        static uint8_t offset = 0;
+        const CRGB * pPalette = GetZonePalette(LedZone::Shuttle);
+        const LedSpan<kShuttleLedCount> segment = ShuttleSpan();
+        for (size_t i = 0; i < kShuttleLedCount; ++i)
         {
-            g_jackpotRuntime.step = 0;
-            g_jackpotRuntime.secondary = kJackpotLedCount - 1;
+            const uint8_t wave = sin8(offset + i * 32);
+            segment[i] = pPalette[kPaletteFlame / 2 + wave / 8];
+            segment[i].nscale8_video(150 + (wave >> 2));
         }
-        else
+        offset += 6;
+        return kShuttleWaveFrameMs;
+    }
+
+    uint32_t HOT_RENDER RenderShuttleBoost()
+    {
+        const uint8_t pulse = beatsin8(18, 150, 255);
+        const CRGB * pPalette = GetZonePalette(LedZone::Shuttle);
+        const LedSpan<kShuttleLedCount> segment = ShuttleSpan();
+        for (size_t i = 0; i < kShuttleLedCount; ++i)
         {
-            ++g_jackpotRuntime.step;
-            --g_jackpotRuntime.secondary;
+            const uint8_t blendAmount = static_cast<uint8_t>((i * 255) / kShuttleLedCount);
+            CRGB heat = pPalette[kPaletteWarm];
+            heat.nscale8_video(pulse);
+            segment[i] = blend(pPalette[kPaletteSparkle], heat, blendAmount);
         }
+        return kShuttleBoostFrameMs;
     }
 
-    void StepJackpotMeteor()
+    uint32_t HOT_RENDER RunShuttleMode(ShuttleMode mode)
     {
-        constexpr uint8_t meteorSize = 5;
-        constexpr uint8_t trailDecay = 70;
-        const int totalSteps = kJackpotLedCount + kJackpotLedsPerSegment;
-
-        fadeToBlackBy(g_jackpotFrame, kJackpotLedCount, trailDecay);
-        for (uint8_t i = 0; i < meteorSize; ++i)
+        switch (mode)
         {
-            int idx = static_cast<int>(g_jackpotRuntime.step) - i;
-            if (idx >= 0 && idx < kJackpotLedCount)
-            {
-                g_jackpotFrame[idx] = CRGB::DeepSkyBlue;
-            }
+            case ShuttleMode::Flicker:
+                return RenderShuttleFlicker();
+            case ShuttleMode::Wave:
+                return RenderShuttleWave();
+            case ShuttleMode::Boost:
+                return RenderShuttleBoost();
+            default:
+                return kShuttleFlickerFrameMs;
         }
-        ++g_jackpotRuntime.step;
-        if (g_jackpotRuntime.step >= totalSteps)
+    }
+
+    ShuttleMode NextShuttleMode(ShuttleMode mode)
+    {
+        auto next = static_cast<uint8_t>(mode) + 1;
+        const auto maxModes = static_cast<uint8_t>(ShuttleMode::Count);
+        if (next >= maxModes)
+            next = 0;
+        return static_cast<ShuttleMode>(next);
+    }
+
+    void HOT_RENDER RunStreetMode(StreetMode mode)
+    {
+        switch (mode)
         {
-            g_jackpotRuntime.step = 0;
+            case StreetMode::Pulse:
+                RenderStreetPulse();
+                break;
+            case StreetMode::Sparkle:
+                RenderStreetSparkle();
+                break;
+            default:
+                break;
         }
     }
 
-    void StepJackpotRainbowSweep()
+    StreetMode NextStreetMode(StreetMode mode)
     {
-        for (uint8_t i = 0; i < kJackpotLedCount; ++i)
+        auto next = static_cast<uint8_t>(mode) + 1;
+        const auto maxModes = static_cast<uint8_t>(StreetMode::Count);
+        if (next >= maxModes)
+            next = 0;
+        return static_cast<StreetMode>(next);
+    }
+
+    // Zone steps
+    //
+    // Every part of the backglass is a zone with a step function that the draw loop calls once its deadline
+    // has passed.  A step renders one frame into the LED buffers, runs to completion without blocking, and
+    // returns the number of milliseconds until it wants to run again.
+
+    bool HOT_RENDER IsDue(uint32_t now, uint32_t deadline)
+    {
+        return static_cast<int32_t>(now - deadline) >= 0;
+    }
+
+    struct ShuttleZoneState
+    {
+        ShuttleMode mode = ShuttleMode::Flicker;
+        uint32_t lastModeChange = 0;
+    };
+
+    struct StreetZoneState
+    {
+        StreetMode mode = StreetMode::Pulse;
+        uint32_t lastModeChange = 0;
+    };
+
+    struct MachineZoneState
+    {
+        MachineMode activeMode = MachineMode::Rainbow;
+        MachineMode mode = MachineMode::Rainbow;
+        uint32_t lastModeChange = 0;
+    };
+
+    ShuttleZoneState g_shuttleZone;
+    StreetZoneState  g_streetZone;
+    MachineZoneState g_machineZone;
+
+    uint32_t HOT_RENDER StepShuttleZone(uint32_t now)
+    {
+        if (ConsumeTrigger(EffectTrigger::NextShuttleMode) || now - g_shuttleZone.lastModeChange >= kShuttleModeDurationMs)
         {
-            g_jackpotFrame[i] = CHSV(g_jackpotRuntime.hueBase + i * 4, 240, 255);
+            g_shuttleZone.mode = NextShuttleMode(g_shuttleZone.mode);
+            g_shuttleZone.lastModeChange = now;
         }
-        g_jackpotRuntime.hueBase += 3;
+        return RunShuttleMode(g_shuttleZone.mode);
     }
 
-    void StepJackpotSparkle()
+    uint32_t HOT_RENDER StepStreetZone(uint32_t now)
     {
-        constexpr uint8_t sparkleCount = 5;
-        fadeToBlackBy(g_jackpotFrame, kJackpotLedCount, 40);
-        for (uint8_t i = 0; i < sparkleCount; ++i)
+        if (now - g_streetZone.lastModeChange >= kStreetModeDurationMs)
         {
-            g_jackpotFrame[random8(kJackpotLedCount)] += CHSV(random8(), 200, 255);
+            g_streetZone.mode = NextStreetMode(g_streetZone.mode);
+            g_streetZone.lastModeChange = now;
         }
+        RunStreetMode(g_streetZone.mode);
+        return kStreetFrameMs;
     }
 
-    void StepJackpotPulse()
+    uint32_t HOT_RENDER StepPlanetZone(uint32_t)
     {
-        CRGB color = CRGB::Gold;
-        color.nscale8_video(GetHeartbeatBrightness(28));
-        fill_solid(g_jackpotFrame, kJackpotLedCount, color);
+        UpdatePlanetSparkles();
+        return kPlanetSparkleIntervalMs;
     }
 
-    void StepJackpotPlasma()
+    uint32_t HOT_RENDER StepHeartZone(uint32_t now)
     {
-        for (uint8_t i = 0; i < kJackpotLedCount; ++i)
+        EVERY_N_SECONDS(kGlobalHeartIntervalSeconds)
+        {
+            StartGlobalHeartMode(now);
+        }
+        if (ConsumeTrigger(EffectTrigger::GlobalHeart))
         {
-            const uint8_t waveA = sin8(g_jackpotRuntime.hueBase + i * 8);
-            const uint8_t waveB = sin8(g_jackpotRuntime.step + i * 16);
-            const uint8_t blend = qadd8(waveA, waveB) / 2;
-            g_jackpotFrame[i] = CHSV(waveA + g_jackpotRuntime.hueBase, 200, blend);
+            StartGlobalHeartMode(now);
         }
 
-        g_jackpotRuntime.hueBase += 3;
-        g_jackpotRuntime.step += 5;
+        if (g_globalHeartActive && RenderGlobalHeartMode(now))
+            return kGlobalHeartFrameMs;
+
+        RenderHeartbeat(0);
+        return kHeartbeatFrameMs;
     }
 
-    void StepJackpotDimmedHold()
+    uint32_t HOT_RENDER StepJackpotZone(uint32_t now)
     {
-        if (g_jackpotRuntime.step == 0)
+        if (g_bFingerprintPending)
         {
-            ApplyJackpotDefaultColors();
-            g_jackpotRuntime.step = 1;
+            RunEffectFingerprint();
         }
+
+        if (ConsumeTrigger(EffectTrigger::NextJackpotMode))
+        {
+            g_jackpot.Reset(g_jackpot.NextMode(g_jackpot.mode()), now);
+        }
+
+        // A keyframe that matches the last one (DimmedHold between its steps) changes nothing and is not blended,
+        // so once a blend completes the zone sleeps until the next keyframe is due
+        if (g_jackpot.Advance(now))
+        {
+            g_jackpot.Compose(SpanOf(g_jackpotKeyframe), g_planetHighlightActive);
+            if (g_jackpot.ModeInterpolates(g_jackpot.mode()))
+                g_jackpotBlend.PushKeyframe(g_jackpotKeyframe, now, g_jackpot.frameInterval());
+            else
+                g_jackpotBlend.SnapToKeyframe(g_jackpotKeyframe);
+        }
+        g_jackpotBlend.Render(now, leds0);
+
+        const uint32_t untilKeyframe = IsDue(now, g_jackpot.nextFrame()) ? 1 : g_jackpot.nextFrame() - now;
+        return g_jackpotBlend.IsBlending() ? std::min(untilKeyframe, kInterpolatedFrameMs) : untilKeyframe;
     }
 
-    void StepCurrentJackpotMode()
+    uint32_t HOT_RENDER StepMachineZone(uint32_t now)
     {
-        switch (g_jackpotRuntime.mode)
+        if (ConsumeTrigger(EffectTrigger::NextMachineMode) || now - g_machineZone.lastModeChange >= kMachineModeDurationMs)
         {
-            case JackpotMode::Classic:
-                StepJackpotClassic();
-                break;
-            case JackpotMode::AlternatingFill:
-                StepJackpotAlternatingFill();
-                break;
-            case JackpotMode::DualChase:
-                StepJackpotDualChase();
-                break;
-            case JackpotMode::Meteor:
-                StepJackpotMeteor();
-                break;
-            case JackpotMode::RainbowSweep:
-                StepJackpotRainbowSweep();
-                break;
-            // case JackpotMode::Sparkle:
-            //     StepJackpotSparkle();
-            //     break;
-            case JackpotMode::Pulse:
-                StepJackpotPulse();
-                break;
-            case JackpotMode::Plasma:
-                StepJackpotPlasma();
-                break;
-            case JackpotMode::DimmedHold:
-                StepJackpotDimmedHold();
-                break;
-            default:
-                break;
+            g_machineZone.lastModeChange = now;
+            if (g_machineZone.mode == MachineMode::Idle)
+            {
+                g_machineZone.activeMode = NextActiveMachineMode(g_machineZone.activeMode);
+                g_machineZone.mode = g_machineZone.activeMode;
+            }
+            else
+            {
+                g_machineZone.mode = MachineMode::Idle;
+            }
+            logI("Switching The Machine mode to %u", static_cast<unsigned>(g_machineZone.mode));
         }
+        return RunMachineMode(g_machineZone.mode);
     }
 
-    JackpotMode NextJackpotMode(JackpotMode mode)
+    // Critical zones always run at the rate their effect asks for; the frame governor stretches the intervals
+    // of Low zones first, and of Normal zones only when that is not enough
+
+    enum class ZonePriority : uint8_t
     {
-        auto next = static_cast<uint8_t>(mode) + 1;
-        const auto maxModes = static_cast<uint8_t>(JackpotMode::Count);
-        if (next >= maxModes)
-            next = 0;
-        return static_cast<JackpotMode>(next);
+        Critical = 0,
+        Normal,
+        Low
+    };
+
+    struct DrawZone
+    {
+        const char * name;
+        uint32_t (*step)(uint32_t now);
+        bool heldByGlobalHeart;             // The global heartbeat draws over this zone while it runs
+        ZonePriority priority;
+        uint32_t nextDue;
+        uint16_t rateScalePct;              // Interval stretch applied by the governor, 100 = as the effect asks
+        uint32_t avgStepUs;
+        uint32_t avgLateUs;                 // How far past its deadline the zone actually got stepped
+    };
+
+    DrawZone g_drawZones[] = {
+        { "Heart",      StepHeartZone,   false, ZonePriority::Critical, 0, 100, 0, 0 },
+        { "Jackpot",    StepJackpotZone, true,  ZonePriority::Critical, 0, 100, 0, 0 },
+        { "TheMachine", StepMachineZone, true,  ZonePriority::Normal,   0, 100, 0, 0 },
+        { "Shuttle",    StepShuttleZone, true,  ZonePriority::Normal,   0, 100, 0, 0 },
+        { "Street",     StepStreetZone,  true,  ZonePriority::Low,      0, 100, 0, 0 },
+        { "Planets",    StepPlanetZone,  true,  ZonePriority::Low,      0, 100, 0, 0 },
+    };
+
+    // Frame governor
+    //
+    // Tracks what a draw pass costs (zone steps plus show) against kFrameBudgetUs, and how late the critical
+    // zones get stepped, which is where WiFi and HTTP load on the core shows up.  On overrun it stretches the
+    // intervals of the least important zones a notch at a time; once there is headroom again it gives the rate
+    // back, most important zones first.
+
+    constexpr uint32_t kFrameBudgetUs      = 6000;     // Leaves room inside the 10 ms heartbeat
+    constexpr uint32_t kCriticalLateUs     = 3000;
+    constexpr uint8_t  kHeadroomPct        = 60;
+    constexpr uint32_t kGovernorPeriodMs   = 500;
+    constexpr uint16_t kRateScaleStepPct   = 25;
+    constexpr uint16_t kMaxRateScalePct    = 400;
+
+    struct FrameGovernor
+    {
+        uint32_t avgPassUs = 0;
+        uint32_t lastAdjust = 0;
+        uint32_t overruns = 0;
+    };
+
+    FrameGovernor g_frameGovernor;
+
+    uint32_t HOT_RENDER RunningAverage(uint32_t average, uint32_t sample)
+    {
+        return average ? (average * 7 + sample) / 8 : sample;
     }
 
-    void UpdateJackpotAnimations()
+    // Moves every zone of one priority a notch slower (delta > 0) or faster; returns false if none could move
+
+    bool ScaleZoneRates(ZonePriority priority, int16_t delta)
     {
-        const uint32_t now = millis();
-        if (g_jackpotRuntime.modeStart == 0)
+        bool bChanged = false;
+        for (DrawZone & zone : g_drawZones)
         {
-            ResetJackpotRuntime(g_jackpotRuntime.mode, now);
+            if (zone.priority != priority)
+                continue;
+            const int16_t scaled = constrain(static_cast<int16_t>(zone.rateScalePct) + delta, 100, static_cast<int16_t>(kMaxRateScalePct));
+            bChanged |= (scaled != zone.rateScalePct);
+            zone.rateScalePct = static_cast<uint16_t>(scaled);
         }
+        return bChanged;
+    }
 
-        if (now - g_jackpotRuntime.modeStart >= g_jackpotRuntime.modeDuration)
+    void UpdateFrameGovernor(uint32_t now, uint32_t passUs)
+    {
+        g_frameGovernor.avgPassUs = RunningAverage(g_frameGovernor.avgPassUs, passUs);
+        if (now - g_frameGovernor.lastAdjust < kGovernorPeriodMs)
+            return;
+        g_frameGovernor.lastAdjust = now;
+
+        uint32_t criticalLateUs = 0;
+        for (const DrawZone & zone : g_drawZones)
         {
-            ResetJackpotRuntime(NextJackpotMode(g_jackpotRuntime.mode), now);
+            if (zone.priority == ZonePriority::Critical)
+                criticalLateUs = std::max(criticalLateUs, zone.avgLateUs);
         }
 
-        if (now < g_jackpotRuntime.nextFrame)
+        if (g_frameGovernor.avgPassUs > kFrameBudgetUs || criticalLateUs > kCriticalLateUs)
         {
-            return;
+            ++g_frameGovernor.overruns;
+            if (!ScaleZoneRates(ZonePriority::Low, kRateScaleStepPct))
+                ScaleZoneRates(ZonePriority::Normal, kRateScaleStepPct);
+        }
+        else if (g_frameGovernor.avgPassUs < kFrameBudgetUs * kHeadroomPct / 100 && criticalLateUs < kCriticalLateUs / 2)
+        {
+            if (!ScaleZoneRates(ZonePriority::Normal, -kRateScaleStepPct))
+                ScaleZoneRates(ZonePriority::Low, -kRateScaleStepPct);
         }
-
-        StepCurrentJackpotMode();
-        ShowJackpotDimmed();
-        g_jackpotRuntime.nextFrame = now + g_jackpotRuntime.frameInterval;
     }
 
-    CRGB * GetShuttleSegment()
+    // Power save paces the passes 40 to 100 ms apart, so every zone reads as that late while it runs.  Once it
+    // ends the lateness is measured afresh, or the governor would throttle zones for the backlog it left behind.
+
+    void ResetZoneLateness()
     {
-        return &leds1[kShuttleFirstLed];
+        for (DrawZone & zone : g_drawZones)
+            zone.avgLateUs = 0;
     }
 
-    void RenderShuttleFlicker()
+    // RedrawAllZones
+    //
+    // Makes every zone due at now, for when something else has drawn over them.  The jackpot blender only
+    // renders when its output changes, so it is told to put its output back as well.
+
+    void RedrawAllZones(uint32_t now)
     {
-        CRGB * segment = GetShuttleSegment();
-        for (uint8_t i = 0; i < kShuttleLedCount; ++i)
-        {
-            const uint8_t heat = random8(160, 255);
-            segment[i] = CHSV(10 + random8(8), 255, heat);
-        }
-        FastLED.show();
-        delay(35);
+        for (DrawZone & zone : g_drawZones)
+            zone.nextDue = now;
+        g_jackpotBlend.Invalidate();
     }
 
-    void RenderShuttleWave()
+    // Output timing
+    //
+    // How long a show() takes is dominated by clocking the pixels out, so this is the number to watch when
+    // changing the output driver.  The average is a running average over roughly the last 16 frames.
+
+    struct ShowTiming
     {
-        static uint8_t offset = 0;
-        CRGB * segment = GetShuttleSegment();
-        for (uint8_t i = 0; i < kShuttleLedCount; ++i)
-        {
-            const uint8_t wave = sin8(offset + i * 32);
-            segment[i] = CHSV(5 + wave / 6, 220, 150 + (wave >> 2));
-        }
-        offset += 6;
+        uint32_t lastMicros = 0;
+        uint32_t avgMicros = 0;
+        uint32_t maxMicros = 0;
+        uint32_t frames = 0;
+    };
+
+    ShowTiming g_showTiming;
+    uint32_t g_firstLightMicros = 0;                        // micros() when the boot scene went out
+
+    void HOT_RENDER TimedShow()
+    {
+        const uint32_t start = micros();
         FastLED.show();
-        delay(45);
+        const uint32_t elapsed = micros() - start;
+        PublishPreviewFrame();
+
+        g_showTiming.lastMicros = elapsed;
+        g_showTiming.avgMicros = g_showTiming.frames ? (g_showTiming.avgMicros * 15 + elapsed) / 16 : elapsed;
+        g_showTiming.maxMicros = std::max(g_showTiming.maxMicros, elapsed);
+        ++g_showTiming.frames;
     }
 
-    void RenderShuttleBoost()
+    // OTA progress
+    //
+    // During an OTA the whole backglass goes dark except for the jackpot bar, which fills up with the transfer.
+    // The bar's colors are worked out once when the update starts, so a redraw is only a copy.
+
+    constexpr uint32_t kOtaRecheckMs = 1000;            // The progress callback wakes us before this runs out
+
+    CRGB g_otaBar[kJackpotLedCount];
+    uint8_t g_otaLitLeds = UINT8_MAX;
+
+    void PrepareOtaProgress()
     {
-        const uint8_t pulse = beatsin8(18, 150, 255);
-        CRGB * segment = GetShuttleSegment();
-        for (uint8_t i = 0; i < kShuttleLedCount; ++i)
-        {
-            const uint8_t blendAmount = static_cast<uint8_t>((i * 255) / kShuttleLedCount);
-            CRGB heat = CRGB::Orange;
-            heat.nscale8_video(pulse);
-            segment[i] = blend(CRGB::White, heat, blendAmount);
-        }
-        FastLED.show();
-        delay(30);
+        const CRGB * pPalette = GetZonePalette(LedZone::Jackpot);
+        for (uint8_t i = 0; i < kJackpotLedCount; ++i)
+            g_otaBar[i] = pPalette[static_cast<uint8_t>(kPaletteAccentA + i * 16 / kJackpotLedCount)];
+
+        fill_solid(leds0, NUM_LEDS0, CRGB::Black);
+        fill_solid(leds1, NUM_LEDS1, CRGB::Black);
+        g_otaLitLeds = UINT8_MAX;
     }
 
-    void RunShuttleMode(ShuttleMode mode)
+    // Returns true if the bar changed and needs to be shown
+    bool RenderOtaProgress()
     {
-        switch (mode)
-        {
-            case ShuttleMode::Flicker:
-                RenderShuttleFlicker();
-                break;
-            case ShuttleMode::Wave:
-                RenderShuttleWave();
-                break;
-            case ShuttleMode::Boost:
-                RenderShuttleBoost();
-                break;
-            default:
-                break;
-        }
+        const uint8_t lit = static_cast<uint8_t>((GetOtaProgress() * kJackpotLedCount + 254) / 255);
+        if (lit == g_otaLitLeds)
+            return false;
+
+        memcpy(leds0, g_otaBar, lit * sizeof(CRGB));
+        fill_solid(leds0 + lit, kJackpotLedCount - lit, CRGB::Black);
+        g_otaLitLeds = lit;
+        return true;
     }
 
-    ShuttleMode NextShuttleMode(ShuttleMode mode)
+    // A show restart lines every zone up on a shared epoch and seed so that cabinets in a group run the same
+    // modes in the same order.  The clock sync requests it, the draw task applies it.
+
+    struct ShowRestartRequest
     {
-        auto next = static_cast<uint8_t>(mode) + 1;
-        const auto maxModes = static_cast<uint8_t>(ShuttleMode::Count);
-        if (next >= maxModes)
-            next = 0;
-        return static_cast<ShuttleMode>(next);
+        uint32_t epochMs = 0;
+        uint32_t seed = 0;
+        volatile bool pending = false;
+    };
+
+    ShowRestartRequest g_showRestart;
+    uint32_t g_showRestarts = 0;
+
+    // ResetShowState
+    //
+    // Puts every zone back at its first mode as of epochMs.  The zones are not due before the epoch, so a
+    // restart announced ahead of time starts on every cabinet at the same show time.
+
+    void ResetShowState(uint32_t epochMs, uint32_t seed)
+    {
+        g_jackpot.Reset(JackpotMode::Classic, epochMs);
+        g_shuttleZone = ShuttleZoneState{};
+        g_streetZone = StreetZoneState{};
+        g_machineZone = MachineZoneState{};
+        g_shuttleZone.lastModeChange = epochMs;
+        g_streetZone.lastModeChange = epochMs;
+        g_machineZone.lastModeChange = epochMs;
+        ResetShowcaseState();
+        g_globalHeartActive = false;
+        g_particles.Clear();
+        g_lastParticleStep = epochMs;
+        RedrawAllZones(epochMs);
+        SeedEffectStreams(seed);
     }
 
-    void RunStreetMode(StreetMode mode)
+    // RunDueZones
+    //
+    // Steps every zone whose deadline has passed and returns true if any of them drew.  nextWake is lowered
+    // to the earliest deadline that is still ahead.
+
+    bool HOT_RENDER RunDueZones(uint32_t now, uint32_t & nextWake)
     {
-        switch (mode)
+        StepParticles(now);
+
+        bool bDrew = false;
+        for (DrawZone & zone : g_drawZones)
         {
-            case StreetMode::Pulse:
-                RenderStreetPulse();
-                break;
-            case StreetMode::Sparkle:
-                RenderStreetSparkle();
-                break;
-            default:
-                break;
+            if (IsDue(now, zone.nextDue))
+            {
+                if (g_globalHeartActive && zone.heldByGlobalHeart)
+                {
+                    zone.nextDue = now + kPausedZoneRecheckMs;
+                }
+                else
+                {
+                    zone.avgLateUs = RunningAverage(zone.avgLateUs, (now - zone.nextDue) * 1000);
+                    const uint32_t start = micros();
+                    const uint32_t interval = zone.step(now);
+                    zone.avgStepUs = RunningAverage(zone.avgStepUs, micros() - start);
+                    zone.nextDue = now + interval * zone.rateScalePct / 100;
+                    bDrew = true;
+                }
+            }
+
+            if (static_cast<int32_t>(zone.nextDue - nextWake) < 0)
+                nextWake = zone.nextDue;
         }
+        return bDrew;
     }
+}
 
-    StreetMode NextStreetMode(StreetMode mode)
+void PostDrawHandler(uint32_t sleepMs)
+{
+    // Sleep until the next zone is due, but always yield for at least a tick.  A trigger or input event
+    // notifies the task and ends the sleep early.
+    const TickType_t ticks = pdMS_TO_TICKS(sleepMs);
+    ulTaskNotifyTake(pdTRUE, ticks ? ticks : 1);
+}
+
+// WakeDrawLoop
+//
+// Ends the draw task's sleep so a trigger is drawn on the next pass instead of at the next deadline
+
+void WakeDrawLoop()
+{
+    if (g_taskDraw)
+        xTaskNotifyGive(g_taskDraw);
+}
+
+// RequestShowRestart
+//
+// Asks the draw task to restart the show at epochMs on the show clock with the given effect seed.  Returns false
+// while an earlier restart has not been applied yet.
+
+bool RequestShowRestart(uint32_t epochMs, uint32_t seed)
+{
+    if (g_showRestart.pending)
+        return false;
+
+    g_showRestart.epochMs = epochMs;
+    g_showRestart.seed = seed;
+    g_showRestart.pending = true;
+    WakeDrawLoop();
+    return true;
+}
+
+// RequestEffectBake
+//
+// Queues a bake of the jackpot rotation and machine rainbow into a looping frame file that can be played back
+// with StartFramePlayback.  The draw task starts it on its next pass; StopFrameStore ends it early.
+
+bool RequestEffectBake(const char * pszName, uint32_t seconds, uint16_t seed)
+{
+    if (g_bakeRequest.pending || g_bake.running || nullptr == pszName || strlen(pszName) > kBakeNameLength || seconds == 0)
+        return false;
+
+    strcpy(g_bakeRequest.name, pszName);
+    g_bakeRequest.seconds = seconds;
+    g_bakeRequest.seed = seed;
+    g_bakeRequest.pending = true;
+    WakeDrawLoop();
+    return true;
+}
+
+// RequestEffectFingerprint
+//
+// Asks the draw task to check per-mode frame hashes and timings for the given seed, see RunEffectFingerprint
+
+bool RequestEffectFingerprint(uint16_t seed)
+{
+    if (g_bFingerprintPending)
+        return false;
+
+    g_fingerprintSeed = seed;
+    g_bFingerprintPending = true;
+    WakeDrawLoop();
+    return true;
+}
+
+// FillZoneBuffers
+//
+// Fills one artwork zone in the given pair of channel buffers, which need not be the live ones
+
+bool FillZoneBuffers(LedZone zone, CRGB * pLeds0, CRGB * pLeds1, const CRGB & color)
+{
+    switch (zone)
     {
-        auto next = static_cast<uint8_t>(mode) + 1;
-        const auto maxModes = static_cast<uint8_t>(StreetMode::Count);
-        if (next >= maxModes)
-            next = 0;
-        return static_cast<StreetMode>(next);
+        case LedZone::Jackpot:
+            FillSpan(MakeLedSpan<0, kJackpotLedCount, NUM_LEDS0>(pLeds0), color);
+            break;
+        case LedZone::Eyes:
+            FillSpan(MakeLedSpan<NUM_LEDS0 - 5, 4, NUM_LEDS0>(pLeds0), color);
+            break;
+        case LedZone::Heart:
+            pLeds0[NUM_LEDS0 - 1] = color;
+            break;
+        case LedZone::Machine:
+            FillSpan(MakeLedSpan<theMachineFirstLed, kMachineLedCount, NUM_LEDS1>(pLeds1), color);
+            break;
+        case LedZone::Shuttle:
+            FillSpan(MakeLedSpan<kShuttleFirstLed, kShuttleLedCount, NUM_LEDS1>(pLeds1), color);
+            break;
+        case LedZone::Street:
+            for (uint8_t index : kStreetIndices)
+                pLeds1[index] = color;
+            break;
+        case LedZone::Planets:
+            for (uint8_t index : kPlanetIndices)
+                pLeds1[index] = color;
+            break;
+        case LedZone::Bride:
+            for (uint8_t index : kBrideIndices)
+                pLeds1[index] = color;
+            break;
+        default:
+            return false;
     }
+    return true;
 }
 
-void PostDrawHandler()
+bool TriggerEffect(EffectTrigger trigger)
 {
-    // Once an OTA flash update has started, we don't want to hog the CPU or it goes quite slowly, 
-    // so we'll pause to share the CPU a bit once the update has begun
-    if (g_bUpdateStarted)
-        delay(1000);
-    
-    // If we didn't draw anything, we near-busy-wait so that we are continually checking the clock for an packet
-    // whose time has come
-    delay(5);
+    if (trigger >= EffectTrigger::Count)
+        return false;
+    g_effectTriggers[static_cast<uint8_t>(trigger)] = true;
+    g_bTriggerPending = true;
+    NotePowerActivity();
+    return true;
+}
+
+namespace
+{
+    // The boot scene painters only touch the buffers, so callers decide when the frame goes out
+
+    constexpr size_t kMachineLogoLedCount = 12;        // The logo lights two more LEDs than the machine zone
+
+    void PaintMachineLogo(const CRGB & color)
+    {
+        FillSpan(MakeLedSpan<theMachineFirstLed, kMachineLogoLedCount, NUM_LEDS1>(leds1), color);
+    }
+
+    void PaintBride(const CRGB & color)
+    {
+        for (uint8_t index : kBrideIndices)
+            leds1[index] = color;
+    }
+
+    void PaintEyes(const CRGB & color)
+    {
+        FillSpan(MakeLedSpan<NUM_LEDS0 - 5, 4, NUM_LEDS0>(leds0), color);     // oog rechts .. oog links
+    }
 }
 
 void TheMachineLogo(CRGB color = CRGB(246,200,160))
 {
-        int start = 8;
-        for (int i = start; i < start+12; i++) {
-			leds1[i] = color;
-        }
-        FastLED.show();
+    PaintMachineLogo(color);
+    FastLED.show();
 }
 
 void TheBride(CRGB color = CRGB(246,200,160))
 {
-        uint leds[] = {3,5,6,62,63,64,65,66,67,68,69,79,88,94,95,96,97,98,103,104,105,106,107,108,109,110,111,112,113,115,116,117,118};
-
-        for (uint i = 0; i < 33 ; i++) {
-			leds1[leds[i]] = color;
-        }
-        FastLED.show();
+    PaintBride(color);
+    FastLED.show();
 }
 
 void SingleLed(int index, CRGB color = CRGB(246,200,160))
@@ -961,6 +1632,31 @@ void SingleLed(int index, CRGB color = CRGB(246,200,160))
     FastLED.show();
 }
 
+// ShowBootScene
+//
+// Composes the whole boot picture (logo, bride, eyes and the loose highlights) and sends it with a single
+// show(), so the cabinet is lit a few milliseconds after the LED drivers exist.  Returns micros() at the moment
+// the frame went out, which is how long the app took from start to first light.
+
+uint32_t ShowBootScene()
+{
+    constexpr uint8_t kBootHighlights[] = {
+        fingersLeftCorner, moonTopLeft, moonTopLeft+1, moonTopLeft+2, bigBluePlanetLeftSide, bigBluePlanetRightSide,
+        jupiterUpper, jupiterLower, people, carright1, carright2, carleft1, carleft2, apple
+    };
+
+    PaintMachineLogo(CRGB::White);
+    PaintBride(CRGB::White);
+    PaintEyes(CRGB::BlueViolet);
+    for (uint8_t index : kBootHighlights)
+        leds1[index] = CRGB::White;
+    leds1[fronthead] = CRGB::Red;
+
+    TimedShow();
+    g_firstLightMicros = micros();
+    return g_firstLightMicros;
+}
+
 void ColorFillEffect(CRGB color = CRGB(246,200,160), int nrOfLeds = 10, int everyNth = 10)
 {
 		for (int i = 0; i < nrOfLeds; i+= everyNth) {
@@ -1032,137 +1728,165 @@ void FlickerSpotlights(uint8_t indexA, uint8_t indexB, const CRGB & color)
 
 void Heartbeat(int channel)
 {
-    const uint8_t brightness = GetHeartbeatBrightness();
-  if(channel == 0) {
-    leds0[NUM_LEDS0 -1] = CRGB::Red;
-    leds0[NUM_LEDS0 -1].fadeLightBy(brightness);
-  } else if (channel == 1) {
-    leds0[NUM_LEDS0 -2] = CRGB::BlueViolet;
-    leds0[NUM_LEDS0 -2].fadeLightBy(brightness);
-    leds0[NUM_LEDS0 -3] = CRGB::BlueViolet;
-    leds0[NUM_LEDS0 -3].fadeLightBy(brightness);
-    leds0[NUM_LEDS0 -4] = CRGB::BlueViolet;
-    leds0[NUM_LEDS0 -4].fadeLightBy(brightness);
-    leds0[NUM_LEDS0 -5] = CRGB::BlueViolet;
-    leds0[NUM_LEDS0 -5].fadeLightBy(brightness);
-  }
+  RenderHeartbeat(channel);
   FastLED.show();
   //FastLED.setBrightness( lerp8by8( 0, 255, brightness ) ); // interpolate to max MAX_BRIGHTNESS
 }
 
 void Eyes(CRGB color = CRGB(246,200,160))
 {
-    leds0[NUM_LEDS0 -2] = color;   // oog links
-    leds0[NUM_LEDS0 -3] = color;   // oog 2e links
-    leds0[NUM_LEDS0 -4] = color;   // oog 2e rechts
-    leds0[NUM_LEDS0 -5] = color;   // oog rechts
-
+    PaintEyes(color);
     FastLED.show();
 }
 
-// shuttle flames
-void IRAM_ATTR DrawLoopTaskEntryOne(void *)
+void ReportDrawTiming()
 {
-    ShuttleMode currentMode = ShuttleMode::Flicker;
-    uint32_t lastModeChange = millis();
-    uint32_t lastSparkleUpdate = millis();
-    StreetMode currentStreetMode = StreetMode::Pulse;
-    uint32_t lastStreetModeChange = millis();
+    debugI("First light %u us after start, %u show restarts", g_firstLightMicros, g_showRestarts);
+    debugI("Show: %u frames, last %u us, avg %u us, max %u us",
+           g_showTiming.frames, g_showTiming.lastMicros, g_showTiming.avgMicros, g_showTiming.maxMicros);
+    debugI("Frame: avg %u us of a %u us budget, %u overruns", g_frameGovernor.avgPassUs, kFrameBudgetUs, g_frameGovernor.overruns);
+    debugI("Particles: %u of %u live, %u dropped", static_cast<unsigned>(g_particles.size()), static_cast<unsigned>(g_particles.capacity()), g_particles.dropped());
+    for (const DrawZone & zone : g_drawZones)
+    {
+        debugI("  %-10s step avg %u us, late avg %u us, rate %u%%",
+               zone.name, zone.avgStepUs, zone.avgLateUs, 10000 / zone.rateScalePct);
+    }
+}
+
+// GetDrawStats
+//
+// A snapshot of the draw counters; the fields are read one by one, so they may straddle a frame
+
+void GetDrawStats(DrawStats & stats)
+{
+    stats.frames = g_showTiming.frames;
+    stats.showAvgUs = g_showTiming.avgMicros;
+    stats.passAvgUs = g_frameGovernor.avgPassUs;
+    stats.overruns = g_frameGovernor.overruns;
+}
+
+// DrawLoopTaskEntry
+//
+// The single draw task.  Zones are stepped cooperatively as their deadlines come up, everything drawn in a pass
+// goes out with one FastLED.show(), and the task sleeps until the next deadline.
 
+void IRAM_ATTR DrawLoopTaskEntry(void *)
+{
+    ResetShowState(ShowMillis(), esp_random());
+
+    bool bOtaShown = false;
+    bool bPlaybackShown = false;
+    uint32_t lastNow = ShowMillis();
     for (;;)
     {
-        if (g_globalHeartActive)
-        {
-            PostDrawHandler();
-            continue;
-        }
+        // Effects run on the show clock, which the clock sync may step when it first locks onto a master
+        const uint32_t now = ShowMillis();
+        const uint32_t passStart = micros();
+        uint32_t nextWake = now + kMaxDrawSleepMs;
 
-        const uint32_t now = millis();
-        if (now - lastModeChange >= kShuttleModeDurationMs)
-        {
-            currentMode = NextShuttleMode(currentMode);
-            lastModeChange = now;
-        }
+        if (static_cast<int32_t>(now - lastNow) < 0 || now - lastNow > kShowClockStepMs)
+            RedrawAllZones(now);
+        lastNow = now;
 
-        if (now - lastStreetModeChange >= kStreetModeDurationMs)
+        if (g_showRestart.pending)
         {
-            currentStreetMode = NextStreetMode(currentStreetMode);
-            lastStreetModeChange = now;
+            ResetShowState(g_showRestart.epochMs, g_showRestart.seed);
+            g_showRestart.pending = false;
+            ++g_showRestarts;
         }
 
-        if (now - lastSparkleUpdate >= kPlanetSparkleIntervalMs)
+        // The governor runs on every pass, OTA included, so its timers never go stale.  Input goes first: a
+        // switch hit counts as activity, and the clock should be back up before the trigger is drawn.
+#if ENABLE_INPUT
+        ProcessInputEvents();
+#endif
+        if (UpdatePowerGovernor(millis()))
+            ResetZoneLateness();
+
+        // An OTA gets the CPU to itself: no effects, just the progress bar whenever it grows.  Power save is held
+        // off for the length of it, which also brings an idle cabinet back to full speed on the next pass.
+        if (g_bUpdateStarted)
         {
-            UpdatePlanetSparkles();
-            lastSparkleUpdate = now;
+            if (!bOtaShown)
+            {
+                PrepareOtaProgress();
+                InhibitPowerSave(true);
+            }
+            bOtaShown = true;
+            if (RenderOtaProgress())
+                TimedShow();
+            PostDrawHandler(kOtaRecheckMs);
+            continue;
         }
-
-        RunStreetMode(currentStreetMode);
-        RunShuttleMode(currentMode);
-        PostDrawHandler();
-    }
-}
-
-// heart
-void IRAM_ATTR DrawLoopTaskEntryTwo(void *) 
-{
-    for (;;)
-    {
-        Heartbeat(0);
-        EVERY_N_SECONDS(kGlobalHeartIntervalSeconds)
+        if (bOtaShown)
         {
-            RunGlobalHeartMode();
+            // A failed update; the effects redraw everything from here and the idle minute starts over
+            bOtaShown = false;
+            InhibitPowerSave(false);
+            RedrawAllZones(now);
         }
-        PostDrawHandler();
-    }
-}
 
-// jackpot (been)
-void IRAM_ATTR DrawLoopTaskEntryThree(void *)
-{
-    ResetJackpotRuntime(JackpotMode::Classic, millis());
-    for (;;)
-    {
-        if (!g_globalHeartActive)
+        const bool bSceneChanged = ApplySceneRequests();
+        const bool bRemoteChanged = ApplyRemoteRequests();
+        RenderBakeFrames();
+        if (g_bTriggerPending || bSceneChanged)
         {
-            UpdateJackpotAnimations();
+            g_bTriggerPending = false;
+            RedrawAllZones(now);
         }
 
-        PostDrawHandler();
-    }
-}
-
-// the machine logo
-void IRAM_ATTR DrawLoopTaskEntryFour(void *)
-{
-    MachineMode currentActiveMode = MachineMode::Rainbow;
-    MachineMode currentMode = currentActiveMode;
-    uint32_t lastModeChange = millis();
+        // Playback has drawn over every zone, so the effects redraw everything once it stops
+        const bool bPlayback = IsFramePlaybackActive();
+        if (bPlaybackShown && !bPlayback)
+            RedrawAllZones(now);
+        bPlaybackShown = bPlayback;
 
-    for (;;)
-    {
-        if (g_globalHeartActive)
+        if (bPlayback)
         {
-            PostDrawHandler();
-            continue;
+            if (TakePlaybackFrame())
+            {
+                OverlayRemotePixels();
+                TimedShow();
+                NotePowerFrame();
+                LiftRemotePixels();
+            }
+            nextWake = now + kPausedZoneRecheckMs;
         }
-
-        const uint32_t now = millis();
-        if (now - lastModeChange >= kMachineModeDurationMs)
+        else if (IsSceneHoldingDisplay())
         {
-            lastModeChange = now;
-            if (currentMode == MachineMode::Idle)
+            if (bSceneChanged || bRemoteChanged)
             {
-                currentActiveMode = NextActiveMachineMode(currentActiveMode);
-                currentMode = currentActiveMode;
+                OverlayRemotePixels();
+                TimedShow();
+                NotePowerFrame();
+                LiftRemotePixels();
             }
-            else
+        }
+        else
+        {
+            const uint32_t renderStart = micros();
+            const bool bDrew = RunDueZones(now, nextWake);
+            if (bDrew)
+                NoteRenderPass(micros() - renderStart);
+            if (bDrew || bSceneChanged || bRemoteChanged)
             {
-                currentMode = MachineMode::Idle;
+                OverlayActiveScene();
+                OverlayRemotePixels();
+                TimedShow();
+                NotePowerFrame();
+                LiftRemotePixels();
+#if ENABLE_INPUT
+                CompleteInputFrame();
+#endif
+                // Power save paces the passes on purpose, which must not read as overrun
+                if (0 == PowerSaveFrameMs())
+                    UpdateFrameGovernor(now, micros() - passStart);
             }
-            debugI("Switching The Machine mode to %u", static_cast<unsigned>(currentMode));
         }
 
-        RunMachineMode(currentMode);
-        PostDrawHandler();
+        // In power save a pass takes at least PowerSaveFrameMs, which caps the frame rate
+        const uint32_t elapsed = ShowMillis() - now;
+        const uint32_t budget = std::max(nextWake - now, PowerSaveFrameMs());
+        PostDrawHandler(elapsed < budget ? budget - elapsed : 0);
     }
 }
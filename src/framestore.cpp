@@ -0,0 +1,373 @@
+#include "globals.h"
+#include "framestore.h"
+#include "framefile.h"
+#include "drawing.h"
+#include "preview.h"
+#include "monitor.h"
+#include <SPIFFS.h>
+#include <atomic>
+
+extern TaskHandle_t g_taskFrameStore;
+
+namespace
+{
+    constexpr size_t   kMaxFrameNameLength = 20;        // SPIFFS object names are limited to 31 characters
+
+    enum class FrameStoreJob : uint8_t
+    {
+        None = 0,
+        Record,
+        Play
+    };
+
+    struct FrameStoreRequest
+    {
+        FrameStoreJob job = FrameStoreJob::None;
+        char path[kMaxFrameNameLength + 8] = {};
+        uint32_t durationMs = 0;
+        uint16_t frameIntervalMs = kDefaultRecordIntervalMs;
+        bool loop = false;
+    };
+
+    FrameStoreRequest g_frameStoreRequest;
+    std::atomic<bool> g_bFrameStoreBusy(false);        // Claimed with exchange: jobs start from the web, console and bake tasks
+    volatile bool g_bFramePlayback = false;
+    volatile bool g_bFrameStoreStop = false;
+
+    const uint16_t kChannelSizes[NUM_CHANNELS] = { NUM_LEDS0, NUM_LEDS1 };
+
+    // Scratch buffers for DeltaRle frames, shared because only one job runs at a time
+
+    constexpr size_t kMaxFramePixels = NUM_LEDS0 + NUM_LEDS1;
+    uint8_t g_framePixels[kMaxFramePixels * kFrameFileBytesPerLed];
+    uint8_t g_framePrevious[kMaxFramePixels * kFrameFileBytesPerLed];
+    uint8_t g_frameEncoded[kMaxFramePixels * (kFrameFileBytesPerLed + 1)];
+
+    static_assert(kMaxFramePixels * kFrameFileBytesPerLed == kPreviewFrameBytes, "A recording is a published preview frame");
+    static_assert(sizeof(g_frameEncoded) <= UINT16_MAX, "A DeltaRle frame's length prefix is a uint16_t");
+
+    // Playback hands each frame to the draw task through a single slot: the frame store fills it and sets the
+    // flag, the draw task shows it and clears the flag.
+
+    FrameFileHeader g_playbackHeader;
+    uint8_t g_playbackFrame[kMaxFramePixels * kFrameFileBytesPerLed];
+    volatile bool g_bPlaybackFramePending = false;
+
+    CRGB * ChannelBuffer(uint8_t channel)
+    {
+        return channel == 0 ? leds0 : leds1;
+    }
+
+    bool MakeFramePath(const char * pszName, char * pszPath, size_t cchPath)
+    {
+        if (nullptr == pszName || 0 == *pszName || strlen(pszName) > kMaxFrameNameLength)
+            return false;
+        snprintf(pszPath, cchPath, "/%s.led", pszName);
+        return true;
+    }
+
+    void RecordFrames(const FrameStoreRequest & request)
+    {
+        File file = SPIFFS.open(request.path, FILE_WRITE);
+        if (!file)
+        {
+            debugW("Could not create %s", request.path);
+            return;
+        }
+
+        FrameFileHeader header;
+        InitFrameFileHeader(header, request.frameIntervalMs);
+        AddFrameFileSpan(header, 0, 0, NUM_LEDS0);
+        AddFrameFileSpan(header, 1, 0, NUM_LEDS1);
+        file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header));
+
+        // Frames are taken from what the draw task published after its last show(), never from the LED buffers
+        // it may be drawing into, so a recording cannot catch a frame half drawn.  Leds0 then leds1 is exactly
+        // the span layout above.
+        SetPreviewCapture(true);
+        const uint32_t start = millis();
+        TickType_t lastWake = xTaskGetTickCount();
+        while (!g_bFrameStoreStop && millis() - start < request.durationMs)
+        {
+            uint16_t sequence;
+            if (CopyPreviewFrame(g_framePixels, sequence))
+            {
+                if (file.write(g_framePixels, FrameFileRawFrameBytes(header)) != FrameFileRawFrameBytes(header))
+                {
+                    debugW("Flash full after %u frames", header.frameCount);
+                    break;
+                }
+                ++header.frameCount;
+            }
+            vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(request.frameIntervalMs));
+        }
+        SetPreviewCapture(false);
+
+        file.seek(0);
+        file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header));
+        file.close();
+        debugI("Recorded %u frames to %s", header.frameCount, request.path);
+    }
+
+    void ScatterFramePixels(const FrameFileHeader & header, const uint8_t * pPixels)
+    {
+        for (uint8_t i = 0; i < header.spanCount; ++i)
+        {
+            const FrameFileSpan & span = header.spans[i];
+            memcpy(ChannelBuffer(span.channel) + span.firstLed, pPixels, span.ledCount * kFrameFileBytesPerLed);
+            pPixels += span.ledCount * kFrameFileBytesPerLed;
+        }
+    }
+
+    // ReadFrame
+    //
+    // Reads the next frame into g_framePixels, which for a DeltaRle file must still hold the frame before it
+
+    bool ReadFrame(File & file, const FrameFileHeader & header)
+    {
+        if (header.encoding == static_cast<uint8_t>(FrameEncoding::Raw))
+            return file.read(g_framePixels, FrameFileRawFrameBytes(header)) == FrameFileRawFrameBytes(header);
+
+        uint16_t cbFrame = 0;
+        return file.read(reinterpret_cast<uint8_t *>(&cbFrame), sizeof(cbFrame)) == sizeof(cbFrame)
+            && cbFrame <= sizeof(g_frameEncoded)
+            && file.read(g_frameEncoded, cbFrame) == cbFrame
+            && DecodeDeltaRleFrame(g_frameEncoded, cbFrame, g_framePixels, FrameFilePixelsPerFrame(header));
+    }
+
+    // Waits for the draw task to take the previous frame, then hands it this one; false if the job was stopped
+
+    bool PostPlaybackFrame(const FrameFileHeader & header)
+    {
+        while (g_bPlaybackFramePending)
+        {
+            if (g_bFrameStoreStop)
+                return false;
+            vTaskDelay(1);
+        }
+        memcpy(g_playbackFrame, g_framePixels, FrameFileRawFrameBytes(header));
+        __sync_synchronize();
+        g_bPlaybackFramePending = true;
+        WakeDrawLoop();
+        return true;
+    }
+
+    void PlayFrames(const FrameStoreRequest & request)
+    {
+        File file = SPIFFS.open(request.path, FILE_READ);
+        if (!file)
+        {
+            debugW("Could not open %s", request.path);
+            return;
+        }
+
+        FrameFileHeader header;
+        if (file.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) != sizeof(header)
+            || !IsValidFrameFileHeader(header, kChannelSizes, NUM_CHANNELS)
+            || FrameFilePixelsPerFrame(header) > kMaxFramePixels
+            || header.frameCount == 0)
+        {
+            debugW("%s is not a valid frame file", request.path);
+            file.close();
+            return;
+        }
+
+        g_playbackHeader = header;
+        g_bPlaybackFramePending = false;
+        g_bFramePlayback = true;
+        TickType_t lastWake = xTaskGetTickCount();
+        do
+        {
+            file.seek(sizeof(header));
+            for (uint32_t frame = 0; frame < header.frameCount && !g_bFrameStoreStop; ++frame)
+            {
+                if (!ReadFrame(file, header))
+                {
+                    debugW("%s is truncated at frame %u", request.path, frame);
+                    g_bFrameStoreStop = true;
+                    break;
+                }
+                if (!PostPlaybackFrame(header))
+                    break;
+                vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(header.frameIntervalMs));
+            }
+        } while (request.loop && !g_bFrameStoreStop);
+
+        g_bFramePlayback = false;
+        file.close();
+    }
+
+    // FrameStoreTaskEntry
+    //
+    // Runs a single record or playback job and then deletes itself
+
+    void FrameStoreTaskEntry(void *)
+    {
+        const FrameStoreRequest request = g_frameStoreRequest;
+
+        if (request.job == FrameStoreJob::Record)
+            RecordFrames(request);
+        else if (request.job == FrameStoreJob::Play)
+            PlayFrames(request);
+
+        g_bFrameStoreBusy = false;
+        ExitMonitoredTask(g_taskFrameStore);
+    }
+
+    bool StartFrameStoreJob(const FrameStoreRequest & request)
+    {
+        if (g_bFrameStoreBusy.exchange(true))
+        {
+            debugW("Frame store is busy, stop it first");
+            return false;
+        }
+
+        g_frameStoreRequest = request;
+        g_bFrameStoreStop = false;
+        if (pdPASS != xTaskCreatePinnedToCore(FrameStoreTaskEntry, "FrameStore", kFrameStoreStackSize, nullptr, DRAWING_PRIORITY, &g_taskFrameStore, DRAWING_CORE))
+        {
+            g_bFrameStoreBusy = false;
+            return false;
+        }
+        return true;
+    }
+}
+
+bool BeginFrameStorage()
+{
+    if (!SPIFFS.begin(true))
+    {
+        debugW("SPIFFS mount failed, frame recording disabled");
+        return false;
+    }
+    return true;
+}
+
+bool StartFrameRecording(const char * pszName, uint32_t durationMs, uint16_t frameIntervalMs)
+{
+    FrameStoreRequest request;
+    request.job = FrameStoreJob::Record;
+    request.durationMs = durationMs;
+    request.frameIntervalMs = frameIntervalMs ? frameIntervalMs : kDefaultRecordIntervalMs;
+    if (!MakeFramePath(pszName, request.path, sizeof(request.path)))
+        return false;
+
+    debugI("Recording %s for %u ms", request.path, durationMs);
+    return StartFrameStoreJob(request);
+}
+
+bool StartFramePlayback(const char * pszName, bool bLoop)
+{
+    FrameStoreRequest request;
+    request.job = FrameStoreJob::Play;
+    request.loop = bLoop;
+    if (!MakeFramePath(pszName, request.path, sizeof(request.path)))
+        return false;
+
+    if (!SPIFFS.exists(request.path))
+    {
+        debugW("%s does not exist", request.path);
+        return false;
+    }
+
+    debugI("Playing %s%s", request.path, bLoop ? " (looped)" : "");
+    return StartFrameStoreJob(request);
+}
+
+void StopFrameStore()
+{
+    g_bFrameStoreStop = true;
+}
+
+bool IsFramePlaybackActive()
+{
+    return g_bFramePlayback;
+}
+
+bool IsFrameStoreBusy()
+{
+    return g_bFrameStoreBusy;
+}
+
+// WriteFrameFile
+//
+// Renders frameCount frames through renderFrame and stores them as a DeltaRle file with the spans, interval and
+// flags of layout.  Each frame is encoded against the one before it, except the first, which stands alone so a
+// looping player can start over.  Fails while a recording or playback runs, as they share the frame buffers,
+// and ends the file early on StopFrameStore.
+
+bool WriteFrameFile(const char * pszName, const FrameFileHeader & layout, uint32_t frameCount, const FrameRenderFunction & renderFrame)
+{
+    char path[kMaxFrameNameLength + 8];
+    if (!MakeFramePath(pszName, path, sizeof(path))
+        || !IsValidFrameFileHeader(layout, kChannelSizes, NUM_CHANNELS)
+        || FrameFilePixelsPerFrame(layout) > kMaxFramePixels)
+    {
+        return false;
+    }
+
+    if (g_bFrameStoreBusy.exchange(true))
+    {
+        debugW("Frame store is busy, stop it first");
+        return false;
+    }
+    g_bFrameStoreStop = false;
+
+    File file = SPIFFS.open(path, FILE_WRITE);
+    if (!file)
+    {
+        debugW("Could not create %s", path);
+        g_bFrameStoreBusy = false;
+        return false;
+    }
+
+    FrameFileHeader header = layout;
+    header.encoding = static_cast<uint8_t>(FrameEncoding::DeltaRle);
+    header.frameCount = 0;
+    file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header));
+
+    const size_t pixelCount = FrameFilePixelsPerFrame(header);
+    uint32_t cbTotal = sizeof(header);
+    bool bWritten = true;
+    for (uint32_t frame = 0; frame < frameCount && !g_bFrameStoreStop; ++frame)
+    {
+        renderFrame(frame, g_framePixels);
+        const uint16_t cbFrame = static_cast<uint16_t>(EncodeDeltaRleFrame(frame ? g_framePrevious : nullptr, g_framePixels, pixelCount,
+                                                                           g_frameEncoded, sizeof(g_frameEncoded)));
+        if (file.write(reinterpret_cast<const uint8_t *>(&cbFrame), sizeof(cbFrame)) != sizeof(cbFrame)
+            || file.write(g_frameEncoded, cbFrame) != cbFrame)
+        {
+            debugW("Flash full after %u frames", header.frameCount);
+            bWritten = false;
+            break;
+        }
+        memcpy(g_framePrevious, g_framePixels, pixelCount * kFrameFileBytesPerLed);
+        ++header.frameCount;
+        cbTotal += sizeof(cbFrame) + cbFrame;
+    }
+
+    file.seek(0);
+    file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header));
+    file.close();
+    g_bFrameStoreBusy = false;
+
+    debugI("Wrote %u frames to %s, %u bytes (%u raw)", header.frameCount, path, cbTotal,
+           static_cast<uint32_t>(sizeof(header) + header.frameCount * FrameFileRawFrameBytes(header)));
+    return bWritten && header.frameCount == frameCount;
+}
+
+// TakePlaybackFrame
+//
+// Copies the frame playback has handed over, if there is a new one, into leds0/leds1; the caller shows it
+
+bool TakePlaybackFrame()
+{
+    if (!g_bPlaybackFramePending)
+        return false;
+
+    __sync_synchronize();
+    ScatterFramePixels(g_playbackHeader, g_playbackFrame);
+    __sync_synchronize();
+    g_bPlaybackFramePending = false;
+    return true;
+}
@@ -0,0 +1,230 @@
+#include "globals.h"
+#include "input.h"
+#include "drawing.h"
+#include "monitor.h"
+#include <SPIFFS.h>
+
+extern TaskHandle_t g_taskDraw;
+extern TaskHandle_t g_taskInputTrace;
+
+namespace
+{
+    constexpr uint8_t  kEventRingSize      = 32;           // Power of two
+    constexpr uint32_t kDebounceUs         = 20000;
+    constexpr size_t   kMaxTraceNameLength = 20;
+
+    struct InputPin
+    {
+        uint8_t      pin;
+        PinballEvent event;
+    };
+
+    // OnInputEdge can run while the flash cache is disabled, so the pin table, the ring and everything else it
+    // touches are kept in DRAM, and PushEvent in IRAM.
+    //
+    // The machine's signals come in through opto-couplers.  GPIO 36 and 39 are avoided: they see short false
+    // edges whenever WiFi or the ADC powers up (ESP32 errata 3.11), which would keep firing effects and hold
+    // off power save.
+
+    DRAM_ATTR constexpr InputPin kInputPins[] = {
+        { 34, PinballEvent::Jackpot   },
+        { 35, PinballEvent::Drain     },
+        { 32, PinballEvent::Multiball },
+        { 27, PinballEvent::Tilt      },
+    };
+
+    struct EventRule
+    {
+        PinballEvent  event;
+        EffectTrigger trigger;
+    };
+
+    constexpr EventRule kEventRules[] = {
+        { PinballEvent::Jackpot,   EffectTrigger::NextJackpotMode },
+        { PinballEvent::Drain,     EffectTrigger::GlobalHeart     },
+        { PinballEvent::Multiball, EffectTrigger::NextMachineMode },
+        { PinballEvent::Multiball, EffectTrigger::NextShuttleMode },
+    };
+
+    struct QueuedEvent
+    {
+        PinballEvent event;
+        uint32_t     timestampUs;
+    };
+
+    DRAM_ATTR QueuedEvent g_eventRing[kEventRingSize];
+    volatile uint8_t      g_eventHead = 0;                  // Written only by the producer
+    volatile uint8_t      g_eventTail = 0;                  // Written only by the draw task
+    volatile uint32_t     g_droppedEvents = 0;
+    volatile bool         g_bTraceActive = false;
+    DRAM_ATTR uint32_t    g_lastEdgeUs[sizeof(kInputPins) / sizeof(kInputPins[0])] = {};
+
+    // Latency from the oldest event applied in a pass to the end of that pass's show()
+    uint32_t g_pendingEventUs = 0;
+    bool     g_bEventPending = false;
+    uint32_t g_latencyLastUs = 0;
+    uint32_t g_latencyMaxUs = 0;
+    uint32_t g_latencyTotalUs = 0;
+    uint32_t g_eventsApplied = 0;
+
+    char g_traceName[kMaxTraceNameLength + 8] = {};
+
+    bool IRAM_ATTR PushEvent(PinballEvent event, uint32_t timestampUs)
+    {
+        const uint8_t head = g_eventHead;
+        const uint8_t next = (head + 1) & (kEventRingSize - 1);
+        if (next == g_eventTail)
+        {
+            ++g_droppedEvents;
+            return false;
+        }
+
+        g_eventRing[head] = { event, timestampUs };
+        __sync_synchronize();
+        g_eventHead = next;
+        return true;
+    }
+
+    void IRAM_ATTR OnInputEdge(void * pArg)
+    {
+        const uint8_t index = static_cast<uint8_t>(reinterpret_cast<uintptr_t>(pArg));
+        const uint32_t now = micros();
+        if (g_bTraceActive || now - g_lastEdgeUs[index] < kDebounceUs)
+            return;
+        g_lastEdgeUs[index] = now;
+
+        if (PushEvent(kInputPins[index].event, now) && g_taskDraw)
+        {
+            BaseType_t bWoken = pdFALSE;
+            vTaskNotifyGiveFromISR(g_taskDraw, &bWoken);
+            if (bWoken)
+                portYIELD_FROM_ISR();
+        }
+    }
+
+    // InputTraceTaskEntry
+    //
+    // Replays a recorded trace: one "<milliseconds> <event>" pair per line, times relative to the start
+
+    void InputTraceTaskEntry(void *)
+    {
+        File file = SPIFFS.open(g_traceName, FILE_READ);
+        if (file)
+        {
+            const uint32_t start = millis();
+            String line;
+            uint8_t ch;
+            while (file.read(&ch, 1) == 1)
+            {
+                if (ch != '\n')
+                {
+                    line += static_cast<char>(ch);
+                    continue;
+                }
+
+                const int split = line.indexOf(' ');
+                if (split > 0)
+                {
+                    const uint32_t at = line.substring(0, split).toInt();
+                    const long event = line.substring(split + 1).toInt();
+                    while (millis() - start < at)
+                        delay(1);
+                    if (event >= 0 && event < static_cast<long>(PinballEvent::Count))
+                        PostInputEvent(static_cast<PinballEvent>(event), micros());
+                }
+                line = "";
+            }
+            file.close();
+        }
+        else
+        {
+            debugW("Could not open %s", g_traceName);
+        }
+
+        g_bTraceActive = false;
+        ExitMonitoredTask(g_taskInputTrace);
+    }
+}
+
+void BeginInput()
+{
+    for (uint8_t i = 0; i < sizeof(kInputPins) / sizeof(kInputPins[0]); ++i)
+    {
+        pinMode(kInputPins[i].pin, INPUT);
+        attachInterruptArg(kInputPins[i].pin, OnInputEdge, reinterpret_cast<void *>(static_cast<uintptr_t>(i)), RISING);
+    }
+}
+
+// PostInputEvent
+//
+// Queues an event from task context and wakes the draw task.  Only the active source may call this: GPIO edges
+// are ignored while a trace is replaying so the ring keeps a single producer.
+
+void PostInputEvent(PinballEvent event, uint32_t timestampUs)
+{
+    if (PushEvent(event, timestampUs))
+        WakeDrawLoop();
+}
+
+bool StartInputTrace(const char * pszName)
+{
+    if (g_bTraceActive || nullptr == pszName || strlen(pszName) > kMaxTraceNameLength)
+        return false;
+
+    snprintf(g_traceName, sizeof(g_traceName), "/%s.evt", pszName);
+    g_bTraceActive = true;
+    if (pdPASS != xTaskCreatePinnedToCore(InputTraceTaskEntry, "InputTrace", kInputTraceStackSize, nullptr, DRAWING_PRIORITY, &g_taskInputTrace, DRAWING_CORE))
+    {
+        g_bTraceActive = false;
+        return false;
+    }
+    return true;
+}
+
+// ProcessInputEvents
+//
+// Called by the draw task before it steps the zones: applies the rules for every queued event
+
+void ProcessInputEvents()
+{
+    while (g_eventTail != g_eventHead)
+    {
+        __sync_synchronize();
+        const QueuedEvent queued = g_eventRing[g_eventTail];
+        g_eventTail = (g_eventTail + 1) & (kEventRingSize - 1);
+
+        for (const EventRule & rule : kEventRules)
+        {
+            if (rule.event == queued.event)
+                TriggerEffect(rule.trigger);
+        }
+
+        if (!g_bEventPending)
+        {
+            g_pendingEventUs = queued.timestampUs;
+            g_bEventPending = true;
+        }
+        ++g_eventsApplied;
+    }
+}
+
+// CompleteInputFrame
+//
+// Called by the draw task after a show(); closes the latency measurement for the events it just applied
+
+void CompleteInputFrame()
+{
+    if (!g_bEventPending)
+        return;
+
+    g_latencyLastUs = micros() - g_pendingEventUs;
+    g_latencyMaxUs = std::max(g_latencyMaxUs, g_latencyLastUs);
+    g_latencyTotalUs += g_latencyLastUs;
+    g_bEventPending = false;
+}
+
+void ReportInputStats()
+{
+    debugI("Input: %u events, %u dropped, latency last %u us, max %u us",
+           g_eventsApplied, g_droppedEvents, g_latencyLastUs, g_latencyMaxUs);
+}
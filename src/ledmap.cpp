@@ -0,0 +1,184 @@
+#include "globals.h"
+#include "ledmap.h"
+#include "drawing.h"
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+    constexpr uint8_t kJackpotSegments       = 8;
+    constexpr uint8_t kJackpotLedsPerSegment = 6;
+    constexpr uint8_t kJackpotLeftX          = 60;      // Segments are vertical bars, wired bottom to top
+    constexpr uint8_t kJackpotSegmentPitch   = 19;
+    constexpr uint8_t kJackpotBottomY        = 236;
+    constexpr uint8_t kJackpotLedPitch       = 12;
+    constexpr uint8_t kGlassCentre           = 128;
+
+    // A known spot on the artwork.  The LEDs between two anchors of the same strip follow its wiring from one
+    // anchor to the next, so only the ends of each run are listed; move an anchor to recalibrate its run.
+
+    struct MapAnchor
+    {
+        uint8_t led;
+        uint8_t x;
+        uint8_t y;
+    };
+
+    const MapAnchor kChannel0Anchors[] = {
+        { NUM_LEDS0 - 5, 148, 78 },                     // oog rechts
+        { NUM_LEDS0 - 4, 140, 78 },
+        { NUM_LEDS0 - 3, 116, 78 },
+        { NUM_LEDS0 - 2, 108, 78 },                     // oog links
+        { NUM_LEDS0 - 1, 128, 118 },                    // hart
+    };
+
+    const MapAnchor kChannel1Anchors[] = {
+        { 0,                      16,  12 },
+        { moonTopLeft,            28,  22 },
+        { fronthead,              56,  40 },
+        { 6,                      64,  44 },
+        { theMachineFirstLed,     72,  18 },
+        { 19,                     184, 18 },            // End of the logo as TheMachineLogo lights it
+        { spotlights2,            236, 44 },
+        { people,                 208, 228 },
+        { carright1,              188, 236 },
+        { carright2,              176, 236 },
+        { carleft1,               96,  236 },
+        { carleft2,               84,  236 },
+        { fingersLeftCorner,      10,  244 },
+        { 55,                     20,  160 },           // Shuttle
+        { 57,                     36,  136 },
+        { 62,                     84,  96 },            // Bride's arm
+        { 69,                     108, 60 },
+        { bigBluePlanetLeftSide,  196, 100 },
+        { bigBluePlanetRightSide, 220, 100 },
+        { 79,                     120, 52 },
+        { apple,                  150, 150 },
+        { jupiterUpper,           238, 136 },
+        { jupiterLower,           238, 156 },
+        { spotlights1,            24,  56 },
+        { 88,                     104, 70 },            // Bride's outline, down the left and back up the right
+        { 94,                     100, 140 },
+        { 98,                     104, 190 },
+        { 103,                    152, 190 },
+        { 113,                    156, 70 },
+        { 118,                    128, 56 },
+        { NUM_LEDS1 - 1,          128, 40 },
+    };
+
+    struct MapPosition
+    {
+        uint8_t x;
+        uint8_t y;
+    };
+
+    LedMapPoint g_ledMap[kMapLedCount] = {};
+    uint8_t     g_featureDistances[static_cast<uint8_t>(MapFeature::Count)][kMapLedCount] = {};
+
+    // InterpolateAnchors
+    //
+    // Positions the LEDs firstLed..firstLed+ledCount-1 of one strip from its anchors, which must be in LED
+    // order.  LEDs before the first or after the last anchor sit on that anchor.
+
+    void InterpolateAnchors(const MapAnchor * pAnchors, size_t anchorCount, MapPosition * pPositions, uint16_t firstLed, uint16_t ledCount)
+    {
+        size_t next = 0;
+        for (uint16_t led = firstLed; led < firstLed + ledCount; ++led)
+        {
+            while (next < anchorCount && pAnchors[next].led < led)
+                ++next;
+
+            MapPosition & position = pPositions[led];
+            if (next == 0 || next == anchorCount || pAnchors[next].led == led)
+            {
+                const MapAnchor & anchor = pAnchors[next == anchorCount ? anchorCount - 1 : next];
+                position = { anchor.x, anchor.y };
+                continue;
+            }
+
+            const MapAnchor & from = pAnchors[next - 1];
+            const MapAnchor & to = pAnchors[next];
+            const int32_t span = to.led - from.led;
+            const int32_t step = led - from.led;
+            position.x = static_cast<uint8_t>(from.x + (static_cast<int32_t>(to.x) - from.x) * step / span);
+            position.y = static_cast<uint8_t>(from.y + (static_cast<int32_t>(to.y) - from.y) * step / span);
+        }
+    }
+
+    // FillDistances
+    //
+    // Distance of every LED from a point, scaled so the farthest LED is 255
+
+    void FillDistances(const MapPosition * pPositions, float x, float y, uint8_t * pOut)
+    {
+        float distances[kMapLedCount];
+        float farthest = 1.0f;
+        for (uint16_t i = 0; i < kMapLedCount; ++i)
+        {
+            distances[i] = hypotf(pPositions[i].x - x, pPositions[i].y - y);
+            farthest = std::max(farthest, distances[i]);
+        }
+        for (uint16_t i = 0; i < kMapLedCount; ++i)
+            pOut[i] = static_cast<uint8_t>(lrintf(distances[i] * 255.0f / farthest));
+    }
+
+    void FeatureCentre(const MapPosition * pPositions, uint16_t firstIndex, uint16_t count, float & x, float & y)
+    {
+        x = y = 0.0f;
+        for (uint16_t i = firstIndex; i < firstIndex + count; ++i)
+        {
+            x += pPositions[i].x;
+            y += pPositions[i].y;
+        }
+        x /= count;
+        y /= count;
+    }
+}
+
+void BuildLedMap()
+{
+    MapPosition positions[kMapLedCount];
+
+    for (uint8_t segment = 0; segment < kJackpotSegments; ++segment)
+    {
+        for (uint8_t led = 0; led < kJackpotLedsPerSegment; ++led)
+        {
+            positions[segment * kJackpotLedsPerSegment + led] = {
+                static_cast<uint8_t>(kJackpotLeftX + segment * kJackpotSegmentPitch),
+                static_cast<uint8_t>(kJackpotBottomY - led * kJackpotLedPitch)
+            };
+        }
+    }
+    const uint16_t jackpotLeds = kJackpotSegments * kJackpotLedsPerSegment;
+    InterpolateAnchors(kChannel0Anchors, sizeof(kChannel0Anchors) / sizeof(kChannel0Anchors[0]), positions, jackpotLeds, NUM_LEDS0 - jackpotLeds);
+    InterpolateAnchors(kChannel1Anchors, sizeof(kChannel1Anchors) / sizeof(kChannel1Anchors[0]), positions + NUM_LEDS0, 0, NUM_LEDS1);
+
+    uint8_t radii[kMapLedCount];
+    FillDistances(positions, kGlassCentre, kGlassCentre, radii);
+    for (uint16_t i = 0; i < kMapLedCount; ++i)
+    {
+        const float angle = atan2f(positions[i].y - static_cast<float>(kGlassCentre), positions[i].x - static_cast<float>(kGlassCentre));
+        g_ledMap[i].x = positions[i].x;
+        g_ledMap[i].y = positions[i].y;
+        g_ledMap[i].angle = static_cast<uint8_t>(lrintf(angle * 128.0f / static_cast<float>(M_PI)));
+        g_ledMap[i].radius = radii[i];
+    }
+
+    float x, y;
+    FeatureCentre(positions, NUM_LEDS0 - 1, 1, x, y);
+    FillDistances(positions, x, y, g_featureDistances[static_cast<uint8_t>(MapFeature::Heart)]);
+    FeatureCentre(positions, NUM_LEDS0 - 5, 4, x, y);
+    FillDistances(positions, x, y, g_featureDistances[static_cast<uint8_t>(MapFeature::Eyes)]);
+    FeatureCentre(positions, NUM_LEDS0 + theMachineFirstLed, 12, x, y);
+    FillDistances(positions, x, y, g_featureDistances[static_cast<uint8_t>(MapFeature::Machine)]);
+}
+
+const LedMapPoint * HOT_RENDER GetLedMap()
+{
+    return g_ledMap;
+}
+
+const uint8_t * HOT_RENDER GetFeatureDistances(MapFeature feature)
+{
+    return g_featureDistances[static_cast<uint8_t>(feature) < static_cast<uint8_t>(MapFeature::Count) ? static_cast<uint8_t>(feature) : 0];
+}
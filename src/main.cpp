@@ -4,6 +4,16 @@
 #include <Preferences.h>
 #include "network.h"                            // For WiFi credentials
 #include "drawing.h"
+#include "framestore.h"
+#include "monitor.h"
+#include "audio.h"
+#include "input.h"
+#include "scenes.h"
+#include "powersave.h"
+#include "palettes.h"
+#include "ledmap.h"
+#include "deferredlog.h"
+#include "clocksync.h"
 #include "apiwebserver.h"
 
 //
@@ -18,6 +28,10 @@ TaskHandle_t g_taskAudio  = nullptr;
 TaskHandle_t g_taskNet    = nullptr;
 TaskHandle_t g_taskRemote = nullptr;
 TaskHandle_t g_taskSocket = nullptr;
+TaskHandle_t g_taskFrameStore = nullptr;
+TaskHandle_t g_taskProfile = nullptr;
+TaskHandle_t g_taskInputTrace = nullptr;
+TaskHandle_t g_taskBake = nullptr;
 
 //
 // Global Variables
@@ -74,7 +88,10 @@ void IRAM_ATTR DebugLoopTaskEntry(void *)
     Debug.setCallBackProjectCmds(&processRemoteDebugCmd);   // Func called to handle any debug externsions we add
 
     while (!WiFi.isConnected())                             // Wait for wifi, no point otherwise
+    {
+        DrainDeferredLog();                                 // Serial still gets the deferred records meanwhile
         delay(100);
+    }
 
     Debug.begin(cszHostname, RemoteDebug::INFO);            // Initialize the WiFi debug server
 
@@ -86,7 +103,8 @@ void IRAM_ATTR DebugLoopTaskEntry(void *)
                 Debug.handle();
             }
         #endif
-        delay(10);        
+        DrainDeferredLog();
+        delay(PowerSavePollMs());
     }    
 }
 
@@ -96,50 +114,42 @@ void setup() {
     Serial.begin(115200);
     esp_log_level_set("*", ESP_LOG_WARN);        // set all components to ERROR level  
 
-    if (WiFi.isConnected() == false && ConnectToWiFi(10) == false)
-    {
-        Serial.printf("Not connected");
-    }
-
     // Re-route debug output to the serial port
     Debug.setSerialEnabled(true);
 
-    debugI("Starting DebugLoopTaskEntry");
-    xTaskCreatePinnedToCore(DebugLoopTaskEntry, "Debug Loop", STACK_SIZE, nullptr, DEBUG_PRIORITY, &g_taskDebug, DEBUG_CORE);
+    // Light the cabinet before anything that can wait on the network or flash
 
-    debugI("Adding %d LEDs to FastLED.", NUM_LEDS0);
     FastLED.addLeds<WS2812B, LED_PIN0, GRB>(leds0, NUM_LEDS0);  // been
-
-    debugI("Adding %d LEDs to FastLED.", NUM_LEDS0);
     FastLED.addLeds<WS2812B, LED_PIN1, GRB>(leds1, NUM_LEDS1);  // overig
     const uint8_t startupBrightness = LoadSavedBrightness();
     FastLED.setBrightness(startupBrightness);
-    debugI("Startup brightness set to %u", startupBrightness);
-
-    TheMachineLogo(CRGB::White);
-    TheBride(CRGB::White);
-    Eyes(CRGB::BlueViolet);
-
-    SingleLed(fingersLeftCorner, CRGB::White);
-    SingleLed(moonTopLeft, CRGB::White);
-    SingleLed(moonTopLeft+1, CRGB::White);
-    SingleLed(moonTopLeft+2, CRGB::White);
-    SingleLed(bigBluePlanetLeftSide, CRGB::White);
-    SingleLed(bigBluePlanetRightSide, CRGB::White);
-    SingleLed(jupiterUpper, CRGB::White);
-    SingleLed(jupiterLower, CRGB::White);
-    SingleLed(fronthead, CRGB::Red);
-    SingleLed(people, CRGB::White);
-    SingleLed(carright1, CRGB::White);
-    SingleLed(carright2, CRGB::White);
-    SingleLed(carleft1, CRGB::White);
-    SingleLed(carleft2, CRGB::White);
-    SingleLed(apple, CRGB::White);
-
-    xTaskCreatePinnedToCore(DrawLoopTaskEntryOne, "Shuttle", STACK_SIZE, nullptr, DRAWING_PRIORITY, &g_taskDraw, DRAWING_CORE);
-    xTaskCreatePinnedToCore(DrawLoopTaskEntryTwo, "Heart", STACK_SIZE, nullptr, DRAWING_PRIORITY, &g_taskDraw, DRAWING_CORE);
-    xTaskCreatePinnedToCore(DrawLoopTaskEntryThree, "Jackpot", STACK_SIZE, nullptr, DRAWING_PRIORITY, &g_taskDraw, DRAWING_CORE);
-    xTaskCreatePinnedToCore(DrawLoopTaskEntryFour, "TheMachine", STACK_SIZE, nullptr, DRAWING_PRIORITY, &g_taskDraw, DRAWING_CORE);
+
+    const uint32_t firstLightMicros = ShowBootScene();
+    debugI("First light %u us after start, %d + %d LEDs at brightness %u", firstLightMicros, NUM_LEDS0, NUM_LEDS1, startupBrightness);
+
+    debugI("Starting DebugLoopTaskEntry");
+    xTaskCreatePinnedToCore(DebugLoopTaskEntry, "Debug Loop", STACK_SIZE, nullptr, DEBUG_PRIORITY, &g_taskDebug, DEBUG_CORE);
+
+    StartNetwork();
+    #if ENABLE_CLOCKSYNC
+        BeginClockSync();
+    #endif
+
+    if (BeginFrameStorage())
+        BeginScenes();
+    BeginPowerGovernor();
+    BeginPalettes();
+    BuildLedMap();
+
+    xTaskCreatePinnedToCore(DrawLoopTaskEntry, "Draw", STACK_SIZE, nullptr, DRAWING_PRIORITY, &g_taskDraw, DRAWING_CORE);
+
+    #if ENABLE_INPUT
+        BeginInput();
+    #endif
+
+    #if ENABLE_AUDIO
+        xTaskCreatePinnedToCore(AudioLoopTaskEntry, "Audio", STACK_SIZE, nullptr, AUDIO_PRIORITY, &g_taskAudio, AUDIO_CORE);
+    #endif
 }
 
 void loop() {
@@ -151,6 +161,14 @@ void loop() {
           }
         #endif 
 
+        #if ENABLE_WEBSERVER
+            EVERY_N_SECONDS(1)
+            {
+                g_WebServer.cleanupClients();
+            }
+            g_WebServer.sendPreview();
+        #endif
+
         EVERY_N_SECONDS(5)
         {
             debugI("IP: %s, Mem: %u LargestBlk: %u PSRAM Free: %u/%u LED FPS: %d",
@@ -159,8 +177,9 @@ void loop() {
                    ESP.getMaxAllocHeap(),
                    ESP.getFreePsram(), ESP.getPsramSize(),
                    FastLED.getFPS());
+            SampleSystemHealth();
         }
 
-        delay(10);        
+        delay(PowerSavePollMs());
     }
 }
\ No newline at end of file
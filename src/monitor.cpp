@@ -0,0 +1,181 @@
+#include "globals.h"
+#include "monitor.h"
+#include "framestore.h"
+#include "clocksync.h"
+#include "input.h"
+#include "renderprofile.h"
+#include "drawing.h"
+
+extern TaskHandle_t g_taskDraw;
+extern TaskHandle_t g_taskDebug;
+extern TaskHandle_t g_taskAudio;
+extern TaskHandle_t g_taskFrameStore;
+extern TaskHandle_t g_taskNet;
+extern TaskHandle_t g_taskSync;
+extern TaskHandle_t g_taskProfile;
+extern TaskHandle_t g_taskInputTrace;
+extern TaskHandle_t g_taskBake;
+
+namespace
+{
+    constexpr uint32_t kAsyncTcpStackSize    = 8192 * 2;    // As created by AsyncTCP
+    constexpr uint32_t kLoopTaskStackSize    = 8192;        // CONFIG_ARDUINO_LOOP_STACK_SIZE
+    constexpr uint32_t kStackWarnBytes       = 512;         // Warn when a stack has less than this left
+    constexpr uint32_t kStackSlackBytes      = 1024;        // Margin added on top of the deepest use seen
+    constexpr uint8_t  kFragmentationWarnPct = 50;
+    constexpr uint8_t  kHeapTrendSamples     = 12;          // One minute at the 5 second sample rate
+
+    struct MonitoredTask
+    {
+        const char *   name;
+        TaskHandle_t * pHandle;             // Our own tasks; null for tasks looked up by name
+        uint32_t       stackSize;
+        uint32_t       minFree;             // Smallest high-water mark seen, in bytes
+    };
+
+    MonitoredTask g_monitoredTasks[] = {
+        { "Draw",       &g_taskDraw,       STACK_SIZE,              UINT32_MAX },
+        { "Debug Loop", &g_taskDebug,      STACK_SIZE,              UINT32_MAX },
+        { "FrameStore", &g_taskFrameStore, kFrameStoreStackSize,    UINT32_MAX },
+        { "Audio",      &g_taskAudio,      STACK_SIZE,              UINT32_MAX },
+        { "Network",    &g_taskNet,        STACK_SIZE,              UINT32_MAX },
+        { "ClockSync",  &g_taskSync,       kClockSyncStackSize,     UINT32_MAX },
+        { "Profile",    &g_taskProfile,    kRenderProfileStackSize, UINT32_MAX },
+        { "InputTrace", &g_taskInputTrace, kInputTraceStackSize,    UINT32_MAX },
+        { "Bake",       &g_taskBake,       kEffectBakeStackSize,    UINT32_MAX },
+        { "async_tcp",  nullptr,           kAsyncTcpStackSize,      UINT32_MAX },
+        { "loopTask",   nullptr,           kLoopTaskStackSize,      UINT32_MAX },
+    };
+
+    struct HeapStats
+    {
+        uint32_t freeBytes = 0;
+        uint32_t largestBlock = 0;
+        uint32_t minEverFree = 0;
+        uint8_t  fragmentationPct = 0;
+    };
+
+    HeapStats g_heapNow;
+    uint32_t  g_heapTrendStart = 0;         // Free heap at the start of the current trend window
+    uint8_t   g_heapTrendCount = 0;
+    uint8_t   g_heapShrinkingWindows = 0;
+
+    portMUX_TYPE g_taskExitMux = portMUX_INITIALIZER_UNLOCKED;  // Held while a handle is sampled or cleared
+
+    // SampleTaskStack
+    //
+    // Returns the task's free stack in bytes, or UINT32_MAX if it isn't running.  Our own tasks can delete
+    // themselves at any time, so their handle is read and used under g_taskExitMux; the ones looked up by name
+    // never exit, and xTaskGetHandle can't be called from inside a critical section anyway.
+
+    uint32_t SampleTaskStack(const MonitoredTask & task)
+    {
+        // On the ESP32 the high-water mark is reported in bytes, not words
+        if (nullptr == task.pHandle)
+        {
+            const TaskHandle_t handle = xTaskGetHandle(task.name);
+            return handle ? uxTaskGetStackHighWaterMark(handle) : UINT32_MAX;
+        }
+
+        portENTER_CRITICAL(&g_taskExitMux);
+        const TaskHandle_t handle = *task.pHandle;
+        const uint32_t freeNow = handle ? uxTaskGetStackHighWaterMark(handle) : UINT32_MAX;
+        portEXIT_CRITICAL(&g_taskExitMux);
+        return freeNow;
+    }
+
+    uint32_t RecommendedStackSize(const MonitoredTask & task)
+    {
+        const uint32_t used = task.stackSize - task.minFree;
+        return ((used + kStackSlackBytes + 255) / 256) * 256;
+    }
+
+    void SampleStacks()
+    {
+        for (MonitoredTask & task : g_monitoredTasks)
+        {
+            const uint32_t freeNow = SampleTaskStack(task);
+            if (UINT32_MAX == freeNow)
+                continue;
+
+            if (freeNow < task.minFree)
+            {
+                if (task.minFree != UINT32_MAX)
+                    debugW("%s stack headroom shrank to %u bytes", task.name, freeNow);
+                task.minFree = freeNow;
+            }
+
+            if (freeNow < kStackWarnBytes)
+                debugW("%s stack nearly exhausted: %u of %u bytes left", task.name, freeNow, task.stackSize);
+        }
+    }
+
+    void SampleHeap()
+    {
+        g_heapNow.freeBytes = ESP.getFreeHeap();
+        g_heapNow.largestBlock = ESP.getMaxAllocHeap();
+        g_heapNow.minEverFree = ESP.getMinFreeHeap();
+        g_heapNow.fragmentationPct = g_heapNow.freeBytes
+            ? static_cast<uint8_t>(100 - (g_heapNow.largestBlock * 100ULL) / g_heapNow.freeBytes)
+            : 100;
+
+        if (g_heapNow.fragmentationPct >= kFragmentationWarnPct)
+            debugW("Heap fragmented %u%%: largest block %u of %u free", g_heapNow.fragmentationPct, g_heapNow.largestBlock, g_heapNow.freeBytes);
+
+        // A heap that ends lower than it started for several windows in a row is leaking, not just busy
+        if (g_heapTrendCount == 0)
+            g_heapTrendStart = g_heapNow.freeBytes;
+
+        if (++g_heapTrendCount >= kHeapTrendSamples)
+        {
+            g_heapTrendCount = 0;
+            if (g_heapNow.freeBytes < g_heapTrendStart)
+            {
+                if (++g_heapShrinkingWindows >= 3)
+                    debugW("Free heap has shrunk for %u minutes, now %u bytes", g_heapShrinkingWindows, g_heapNow.freeBytes);
+            }
+            else
+            {
+                g_heapShrinkingWindows = 0;
+            }
+        }
+    }
+}
+
+// ExitMonitoredTask
+//
+// The handle is only cleared if it is still ours, so a task that has already released its busy flag can't wipe
+// out the handle of a newer one started in the meantime.
+
+void ExitMonitoredTask(TaskHandle_t & handle)
+{
+    portENTER_CRITICAL(&g_taskExitMux);
+    if (handle == xTaskGetCurrentTaskHandle())
+        handle = nullptr;
+    portEXIT_CRITICAL(&g_taskExitMux);
+
+    vTaskDelete(nullptr);
+}
+
+// SampleSystemHealth
+//
+// Call periodically (the main loop does so every 5 seconds)
+
+void SampleSystemHealth()
+{
+    SampleStacks();
+    SampleHeap();
+}
+
+void ReportSystemHealth()
+{
+    debugI("Heap: %u free, %u largest block, %u min ever, %u%% fragmented",
+           g_heapNow.freeBytes, g_heapNow.largestBlock, g_heapNow.minEverFree, g_heapNow.fragmentationPct);
+
+    for (const MonitoredTask & task : g_monitoredTasks)
+    {
+        if (task.minFree == UINT32_MAX)
+            continue;
+        debugI("%-10s stack %5u, min free %5u, recommended %5u", task.name, task.stackSize, task.minFree, RecommendedStackSize(task));
+    }
+}
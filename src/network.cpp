@@ -2,8 +2,21 @@
 #include "network.h"
 #include <ArduinoOTA.h>             // Over-the-air helper object so we can be flashed via WiFi
 #include "apiwebserver.h"
+#include "framestore.h"
+#include "drawing.h"
+#include "monitor.h"
+#include "audio.h"
+#include "input.h"
+#include "scenes.h"
+#include "powersave.h"
+#include "palettes.h"
+#include "otamode.h"
+#include "deferredlog.h"
+#include "clocksync.h"
+#include "renderprofile.h"
 
 extern DRAM_ATTR ApiWebServer g_WebServer;
+extern TaskHandle_t g_taskNet;
 
 // processRemoteDebugCmd
 // 
@@ -13,69 +26,275 @@ extern DRAM_ATTR ApiWebServer g_WebServer;
 void processRemoteDebugCmd() 
 {
     String str = Debug.getLastCommand();
+    NotePowerActivity();
     if (str.equalsIgnoreCase("stats"))
     {
         debugI("Displaying statistics....");
+        ReportSystemHealth();
+        ReportDrawTiming();
+        ReportNetworkStats();
+        #if ENABLE_AUDIO
+            ReportAudioStats();
+        #endif
+        #if ENABLE_INPUT
+            ReportInputStats();
+        #endif
+        ReportPowerStats();
+        ReportOtaStats();
+        ReportDeferredLogStats();
+        ReportRenderProfile();
+        #if ENABLE_CLOCKSYNC
+            ReportClockSyncStats();
+        #endif
+    }
+    else if (str.startsWith("record "))            // record <name> <seconds>
+    {
+        String args = str.substring(7);
+        const int split = args.indexOf(' ');
+        const String name = split < 0 ? args : args.substring(0, split);
+        const uint32_t seconds = split < 0 ? 10 : args.substring(split + 1).toInt();
+        if (!StartFrameRecording(name.c_str(), seconds * 1000))
+            debugW("Could not start recording %s", name.c_str());
+    }
+    else if (str.startsWith("play "))              // play <name> [loop]
+    {
+        String args = str.substring(5);
+        const bool bLoop = args.endsWith(" loop");
+        if (bLoop)
+            args = args.substring(0, args.length() - 5);
+        if (!StartFramePlayback(args.c_str(), bLoop))
+            debugW("Could not play %s", args.c_str());
+    }
+    else if (str.startsWith("bake "))              // bake <name> <seconds> [seed]
+    {
+        String args = str.substring(5);
+        const int split = args.indexOf(' ');
+        const String name = split < 0 ? args : args.substring(0, split);
+        String rest = split < 0 ? String("60") : args.substring(split + 1);
+        const int seedSplit = rest.indexOf(' ');
+        const uint16_t seed = seedSplit < 0 ? 1337 : rest.substring(seedSplit + 1).toInt();
+        if (!RequestEffectBake(name.c_str(), rest.toInt(), seed))
+            debugW("Could not start bake of %s", name.c_str());
+    }
+    else if (str.startsWith("fingerprint"))        // fingerprint [seed]
+    {
+        const uint16_t seed = str.length() > 12 ? str.substring(12).toInt() : 1337;
+        if (!RequestEffectFingerprint(seed))
+            debugW("A fingerprint run is already pending");
+    }
+    else if (str.startsWith("profile"))            // profile [seconds]
+    {
+        const uint32_t seconds = str.length() > 8 ? str.substring(8).toInt() : kDefaultRenderProfileSeconds;
+        if (!StartRenderProfile(seconds))
+            debugW("Could not start a render profile of %u seconds", seconds);
+    }
+    else if (str.startsWith("scene save "))        // scene save <name> [zonemask]
+    {
+        String args = str.substring(11);
+        const int split = args.indexOf(' ');
+        const String name = split < 0 ? args : args.substring(0, split);
+        uint16_t zoneMask = kSceneAllZones;
+        if (split >= 0 && !ApiWebServer::parseZoneMask(args.substring(split + 1).c_str(), zoneMask))
+            debugW("Zone mask must be a number up to 0x%02x", kMaxSceneZoneMask);
+        else if (!SaveScene(name.c_str(), zoneMask))
+            debugW("Could not save scene %s", name.c_str());
+    }
+    else if (str.startsWith("scene delete "))      // scene delete <name>
+    {
+        const String name = str.substring(13);
+        if (!DeleteScene(name.c_str()))
+            debugW("Could not delete scene %s", name.c_str());
+    }
+    else if (str.equalsIgnoreCase("scene clear"))
+    {
+        ClearScene();
+    }
+    else if (str.startsWith("scene "))             // scene <name>
+    {
+        const String name = str.substring(6);
+        if (!ActivateScene(name.c_str()))
+            debugW("No scene called %s", name.c_str());
+    }
+    else if (str.startsWith("palette "))           // palette <name> [zone]
+    {
+        String args = str.substring(8);
+        const int split = args.indexOf(' ');
+        const String name = split < 0 ? args : args.substring(0, split);
+        PaletteId palette;
+        if (!FindPalette(name.c_str(), palette))
+            debugW("No palette called %s", name.c_str());
+        else if (split < 0)
+            SetAllZonePalettes(palette);
+        else if (!SetZonePalette(static_cast<LedZone>(args.substring(split + 1).toInt()), palette))
+            debugW("Could not set palette %s", name.c_str());
+    }
+    else if (str.equalsIgnoreCase("palettes"))
+    {
+        ReportPalettes();
+    }
+    else if (str.equalsIgnoreCase("scenes"))
+    {
+        ReportScenes();
+    }
+#if ENABLE_INPUT
+    else if (str.startsWith("replay "))            // replay <name>, plays back /<name>.evt as pinball events
+    {
+        const String name = str.substring(7);
+        if (!StartInputTrace(name.c_str()))
+            debugW("Could not replay %s", name.c_str());
+    }
+#endif
+#if ENABLE_CLOCKSYNC
+    else if (str.equalsIgnoreCase("sync"))
+    {
+        ReportClockSyncStats();
+    }
+    else if (str.equalsIgnoreCase("sync restart"))   // master only, every cabinet restarts its effects together
+    {
+        if (!RestartSyncedShow())
+            debugW("Only the clock master can restart the show");
+    }
+    else if (str.startsWith("sync "))              // sync master|follower|off
+    {
+        const String name = str.substring(5);
+        ClockSyncRole role;
+        if (!FindClockSyncRole(name.c_str(), role) || !SetClockSyncRole(role))
+            debugW("No clock sync role called %s", name.c_str());
+    }
+#endif
+    else if (str.equalsIgnoreCase("stop"))
+    {
+        StopFrameStore();
     }
 }
 
-// ConnectToWiFi
-//
-// Connect to the pre-configured WiFi network.  
-//
-// BUGBUG I'm guessing this is exposed in all builds so anyone can call it and it just returns false if wifi
-// isn't being used, but do we need that?  If no one really needs to call it put the whole thing in the ifdef
-bool ConnectToWiFi(uint cRetries)
+namespace
 {
-    #if !ENABLE_WIFI
-        return false;
-    #endif
+    constexpr uint32_t kWiFiAttemptMs   = 10000;        // How long one WiFi.begin gets before we call it failed
+    constexpr uint32_t kWiFiPollMs      = 100;
+    constexpr uint32_t kWiFiCheckMs     = 1000;         // Link check interval once connected
+    constexpr uint32_t kWiFiBackoffMinMs = 1000;
+    constexpr uint32_t kWiFiBackoffMaxMs = 60000;
+
+    struct NetworkStats
+    {
+        uint32_t attempts = 0;
+        uint32_t connects = 0;
+        uint32_t drops = 0;
+        uint32_t firstConnectMs = 0;                    // millis() of the first successful connect
+        uint32_t lastConnectMs = 0;
+        uint32_t backoffMs = 0;                         // Current wait before the next attempt, 0 while connected
+        bool     bServicesStarted = false;
+    };
+
+    NetworkStats g_networkStats;
+
+    // TryConnectToWiFi
+    //
+    // One connection attempt to the pre-configured network, giving up after timeoutMs
 
-    for (uint iPass = 0; iPass < cRetries; iPass++)
+    bool TryConnectToWiFi(uint32_t timeoutMs)
     {
-        Serial.printf("Pass %u of %u: Connecting to Wifi SSID: %s - ESP32 Free Memory: %u, PSRAM:%u, PSRAM Free: %u\n",
-            iPass, cRetries, cszSSID, ESP.getFreeHeap(), ESP.getPsramSize(), ESP.getFreePsram());
+        ++g_networkStats.attempts;
+        debugI("WiFi attempt %u: connecting to SSID %s", g_networkStats.attempts, cszSSID);
 
-        //WiFi.disconnect();
+        WiFi.disconnect();
         WiFi.begin(cszSSID, cszPassword);
 
-        for (uint i = 0; i < 10; i++)
+        const uint32_t start = millis();
+        while (!WiFi.isConnected() && millis() - start < timeoutMs)
+            delay(kWiFiPollMs);
+
+        return WiFi.isConnected();
+    }
+
+    // StartNetworkServices
+    //
+    // OTA and the web server listen on any address, so they only need starting on the first connect and keep
+    // working across reconnects
+
+    void StartNetworkServices()
+    {
+        #if ENABLE_OTA
+            debugI("Publishing OTA...");
+            SetupOTA(cszHostname);
+        #endif
+
+        #if ENABLE_WEBSERVER
+            debugI("Starting Web Server...");
+            g_WebServer.begin();
+            debugI("Web Server begin called!");
+        #endif
+
+        g_networkStats.bServicesStarted = true;
+    }
+
+    // NetworkTaskEntry
+    //
+    // Brings WiFi up in the background and keeps it up.  Failed attempts back off exponentially from one second
+    // to a minute so a missing access point doesn't keep the radio busy, and a dropped link is retried right away.
+
+    void NetworkTaskEntry(void *)
+    {
+        uint32_t backoffMs = kWiFiBackoffMinMs;
+        bool bWasConnected = false;
+
+        for (;;)
         {
             if (WiFi.isConnected())
             {
-                Serial.printf("Connected to AP with BSSID: %s\n", WiFi.BSSIDstr().c_str());
-                break;
+                delay(kWiFiCheckMs);
+                continue;
             }
-            else
+
+            if (bWasConnected)
             {
-                delay(1000);
+                bWasConnected = false;
+                ++g_networkStats.drops;
+                backoffMs = kWiFiBackoffMinMs;
+                debugW("WiFi connection lost, reconnecting");
             }
-        }
 
-        if (WiFi.isConnected())
-            break;
-    }
+            if (TryConnectToWiFi(kWiFiAttemptMs))
+            {
+                bWasConnected = true;
+                backoffMs = kWiFiBackoffMinMs;
+                g_networkStats.backoffMs = 0;
+                g_networkStats.lastConnectMs = millis();
+                if (0 == g_networkStats.connects++)
+                    g_networkStats.firstConnectMs = g_networkStats.lastConnectMs;
+                debugI("Connected to AP with BSSID: %s, IP: %s",
+                       WiFi.BSSIDstr().c_str(), WiFi.localIP().toString().c_str());
 
-    if (false == WiFi.isConnected())
-    {
-        Serial.printf("Giving up on WiFi\n");
-        return false;
-    }
+                if (!g_networkStats.bServicesStarted)
+                    StartNetworkServices();
+                continue;
+            }
 
-    #if ENABLE_OTA
-        Serial.printf("Publishing OTA...");
-        SetupOTA(cszHostname);
-    #endif
+            g_networkStats.backoffMs = backoffMs;
+            debugW("WiFi not connected, retrying in %u ms", backoffMs);
+            delay(backoffMs);
+            backoffMs = std::min(backoffMs * 2, kWiFiBackoffMaxMs);
+        }
+    }
+}
 
-    Serial.printf("Received IP: %s", WiFi.localIP().toString().c_str());
+// StartNetwork
+//
+// Hands WiFi, OTA and the web server to the network task so setup() never waits on the access point
 
-    #if ENABLE_WEBSERVER
-        debugI("Starting Web Server...");
-        g_WebServer.begin();
-        debugI("Web Server begin called!");
+void StartNetwork()
+{
+    #if ENABLE_WIFI
+        xTaskCreatePinnedToCore(NetworkTaskEntry, "Network", STACK_SIZE, nullptr, NET_PRIORITY, &g_taskNet, NET_CORE);
     #endif
+}
 
-    return true;
+void ReportNetworkStats()
+{
+    debugI("WiFi: %s, %u attempts, %u connects, %u drops, first connect %u ms after start, backoff %u ms",
+           WiFi.isConnected() ? "connected" : "down", g_networkStats.attempts, g_networkStats.connects,
+           g_networkStats.drops, g_networkStats.firstConnectMs, g_networkStats.backoffMs);
 }
 
 // SetupOTA
@@ -96,7 +315,7 @@ void SetupOTA(const char *pszHostname)
 
     ArduinoOTA
         .onStart([]() {
-            g_bUpdateStarted = true;
+            BeginOtaMode();
 
             String type;
             if (ArduinoOTA.getCommand() == U_FLASH)
@@ -108,23 +327,23 @@ void SetupOTA(const char *pszHostname)
             Serial.printf("%s", type.c_str());
         })
         .onEnd([]() {
+            EndOtaMode(true);
             Serial.printf("\nEnd OTA");
         })
         .onProgress([](unsigned int progress, unsigned int total) 
         {
+            UpdateOtaProgress(progress, total);
+
+            // Printing every block slows the transfer down, so only report once a second
             static uint last_time = millis();
             if (millis() - last_time > 1000)
             {
                 last_time = millis();
                 Serial.printf("Progress: %u%%\r", (progress / (total / 100)));
             }
-            else
-            {
-                Serial.printf("Progress: %u%%\r", (progress / (total / 100)));
-            }
-            
         })
         .onError([](ota_error_t error) {
+            EndOtaMode(false);
             Serial.printf("Error[%u]: ", error);
             if (error == OTA_AUTH_ERROR)
             {
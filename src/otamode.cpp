@@ -0,0 +1,104 @@
+#include "globals.h"
+#include "otamode.h"
+#include "drawing.h"
+#include "framestore.h"
+#include "powersave.h"
+#include <Preferences.h>
+
+extern bool         g_bUpdateStarted;
+extern TaskHandle_t g_taskAudio;
+
+namespace
+{
+    constexpr const char * kOtaPrefsNamespace = "ota";
+    constexpr const char * kOtaDurationKey    = "ms";
+    constexpr const char * kOtaBytesKey       = "bytes";
+
+    uint32_t g_otaStart = 0;
+    uint32_t g_otaBytes = 0;
+    volatile uint8_t g_otaProgress = 0;
+}
+
+// BeginOtaMode
+//
+// Called from ArduinoOTA's onStart, on the loop task
+
+void BeginOtaMode()
+{
+    g_otaStart = millis();
+    g_otaBytes = 0;
+    g_otaProgress = 0;
+
+    StopFrameStore();
+    #if ENABLE_AUDIO
+        if (g_taskAudio)
+            vTaskSuspend(g_taskAudio);
+    #endif
+
+    // Full CPU clock and no modem sleep for the transfer
+    NotePowerActivity();
+    g_bUpdateStarted = true;
+    WakeDrawLoop();
+}
+
+// UpdateOtaProgress
+//
+// Called from onProgress for every received block; only wakes the draw task when the bar has to change
+
+void UpdateOtaProgress(uint32_t progress, uint32_t total)
+{
+    if (total == 0)
+        return;
+
+    g_otaBytes = total;
+    const uint8_t fraction = static_cast<uint8_t>(static_cast<uint64_t>(progress) * 255 / total);
+    if (fraction != g_otaProgress)
+    {
+        g_otaProgress = fraction;
+        WakeDrawLoop();
+    }
+}
+
+void EndOtaMode(bool bSuccess)
+{
+    const uint32_t elapsed = millis() - g_otaStart;
+    if (bSuccess)
+    {
+        debugI("OTA of %u bytes took %u ms (%u KB/s)", g_otaBytes, elapsed, elapsed ? g_otaBytes / elapsed : 0);
+
+        Preferences prefs;
+        if (prefs.begin(kOtaPrefsNamespace, false))
+        {
+            prefs.putULong(kOtaDurationKey, elapsed);
+            prefs.putULong(kOtaBytesKey, g_otaBytes);
+            prefs.end();
+        }
+        return;                                     // ArduinoOTA reboots straight after this
+    }
+
+    // A failed update leaves us running the old firmware, so pick everything up again
+    #if ENABLE_AUDIO
+        if (g_taskAudio)
+            vTaskResume(g_taskAudio);
+    #endif
+    g_bUpdateStarted = false;
+    WakeDrawLoop();
+}
+
+uint8_t GetOtaProgress()
+{
+    return g_otaProgress;
+}
+
+void ReportOtaStats()
+{
+    Preferences prefs;
+    if (prefs.begin(kOtaPrefsNamespace, true))
+    {
+        const uint32_t elapsed = prefs.getULong(kOtaDurationKey, 0);
+        const uint32_t bytes = prefs.getULong(kOtaBytesKey, 0);
+        prefs.end();
+        if (elapsed)
+            debugI("Last OTA: %u bytes in %u ms (%u KB/s)", bytes, elapsed, bytes / elapsed);
+    }
+}
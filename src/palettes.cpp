@@ -0,0 +1,136 @@
+#include "globals.h"
+#include "palettes.h"
+#include <new>
+
+namespace
+{
+    struct PaletteDefinition
+    {
+        const char * name;
+        const TProgmemRGBPalette16 * pStops;
+    };
+
+    const PaletteDefinition kPalettes[static_cast<uint8_t>(PaletteId::Count)] = {
+        { "backglass", &kBackglassColors  },
+        { "rainbow",   &RainbowColors_p   },
+        { "party",     &PartyColors_p     },
+        { "lava",      &LavaColors_p      },
+        { "heat",      &HeatColors_p      },
+        { "ocean",     &OceanColors_p     },
+        { "forest",    &ForestColors_p    },
+        { "cloud",     &CloudColors_p     },
+    };
+
+    struct PaletteCache
+    {
+        CRGB entries[kPaletteSize];
+    };
+
+    // Only palettes that have been assigned at some point take up a cache
+    PaletteCache * volatile g_paletteCaches[static_cast<uint8_t>(PaletteId::Count)] = {};
+
+    PaletteId g_zonePaletteIds[static_cast<uint8_t>(LedZone::Count)] = {};
+    const CRGB * volatile g_zonePalettes[static_cast<uint8_t>(LedZone::Count)] = {};
+
+    // ExpandPalette
+    //
+    // Returns the cache for a palette, filling it the first time, or null if there is no memory for it.  HTTP and
+    // the console may race to expand the same palette, in which case the loser throws its copy away.
+
+    const CRGB * ExpandPalette(PaletteId palette)
+    {
+        const uint8_t index = static_cast<uint8_t>(palette);
+        if (nullptr == g_paletteCaches[index])
+        {
+            PaletteCache * pCache = new (std::nothrow) PaletteCache;
+            if (nullptr == pCache)
+                return nullptr;
+
+            ExpandPaletteStops(*kPalettes[index].pStops, pCache->entries);
+
+            if (!__sync_bool_compare_and_swap(&g_paletteCaches[index], nullptr, pCache))
+                delete pCache;
+        }
+        return g_paletteCaches[index]->entries;
+    }
+}
+
+// SetZonePalette
+//
+// Assigns a palette to a zone; the effects in that zone pick it up on their next frame.  The cache is filled
+// before the zone's pointer is switched, so the draw task never sees a half-expanded palette.
+
+bool SetZonePalette(LedZone zone, PaletteId palette)
+{
+    if (zone >= LedZone::Count || palette >= PaletteId::Count)
+        return false;
+
+    const CRGB * pEntries = ExpandPalette(palette);
+    if (nullptr == pEntries)
+        return false;
+
+    g_zonePaletteIds[static_cast<uint8_t>(zone)] = palette;
+    g_zonePalettes[static_cast<uint8_t>(zone)] = pEntries;
+    return true;
+}
+
+bool SetAllZonePalettes(PaletteId palette)
+{
+    for (uint8_t zone = 0; zone < static_cast<uint8_t>(LedZone::Count); ++zone)
+    {
+        if (!SetZonePalette(static_cast<LedZone>(zone), palette))
+            return false;
+    }
+    return true;
+}
+
+// BeginPalettes
+//
+// Gives every zone the Backglass palette; call before the draw task starts
+
+void BeginPalettes()
+{
+    SetAllZonePalettes(PaletteId::Backglass);
+}
+
+// GetZonePalette
+//
+// Returns the 256 colors of the zone's palette
+
+const CRGB * HOT_RENDER GetZonePalette(LedZone zone)
+{
+    return g_zonePalettes[static_cast<uint8_t>(zone)];
+}
+
+// GetPalette
+//
+// Returns the 256 colors of a palette whether or not any zone uses it, or null if there is no memory to expand it
+
+const CRGB * GetPalette(PaletteId palette)
+{
+    return palette < PaletteId::Count ? ExpandPalette(palette) : nullptr;
+}
+
+bool FindPalette(const char * pszName, PaletteId & palette)
+{
+    for (uint8_t i = 0; i < static_cast<uint8_t>(PaletteId::Count); ++i)
+    {
+        if (0 == strcasecmp(pszName, kPalettes[i].name))
+        {
+            palette = static_cast<PaletteId>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char * GetPaletteName(PaletteId palette)
+{
+    return palette < PaletteId::Count ? kPalettes[static_cast<uint8_t>(palette)].name : "unknown";
+}
+
+void ReportPalettes()
+{
+    for (uint8_t zone = 0; zone < static_cast<uint8_t>(LedZone::Count); ++zone)
+        debugI("Zone %u uses palette %s", zone, GetPaletteName(g_zonePaletteIds[zone]));
+}
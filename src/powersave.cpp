@@ -0,0 +1,180 @@
+#include "globals.h"
+#include "powersave.h"
+#include "drawing.h"
+#include "deferredlog.h"
+#include <WiFi.h>
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+    constexpr uint32_t kIdleAfterMs        = 60000;
+    constexpr uint32_t kFullCpuMhz         = 240;
+    constexpr uint32_t kIdleCpuMhz         = 80;       // Lowest clock that keeps APB, and so the I2S LED timing, at 80 MHz
+    constexpr uint32_t kIdleFrameMs        = 40;       // 25 fps is plenty for attract mode
+    constexpr uint32_t kStaticFrameMs      = 100;
+    constexpr uint16_t kStaticFrameCount   = 25;       // Unchanged frames in a row before the output counts as static
+    constexpr uint32_t kActivePollMs       = 10;
+    constexpr uint32_t kIdlePollMs         = 50;
+
+    // Rough supply current of the ESP32 module itself, from the datasheet, so the report can estimate the saving
+    constexpr uint32_t kActiveCurrentMa    = 110;      // 240 MHz, WiFi without power save
+    constexpr uint32_t kIdleCurrentMa      = 45;       // 80 MHz, WiFi modem sleep
+
+    volatile uint32_t g_lastActivityMs = 0;
+    volatile uint32_t g_lastActivityUs = 0;
+    std::atomic<bool> g_bActivity(false);
+    volatile bool     g_bInhibited = false;
+
+    // Owned by the draw task
+    bool     g_bIdle = false;
+    bool     g_bStatic = false;
+    uint32_t g_lastFrameHash = 0;
+    uint16_t g_unchangedFrames = 0;
+    uint32_t g_stateSince = 0;
+    uint32_t g_idleTotalMs = 0;
+    uint32_t g_activeTotalMs = 0;
+    uint32_t g_idleEntries = 0;
+    uint32_t g_wakeLatencyLastUs = 0;
+    uint32_t g_wakeLatencyMaxUs = 0;
+
+    uint32_t HashLeds(uint32_t hash, const CRGB * pLeds, size_t count)
+    {
+        const uint8_t * pBytes = reinterpret_cast<const uint8_t *>(pLeds);
+        for (size_t i = 0; i < count * sizeof(CRGB); ++i)
+            hash = (hash ^ pBytes[i]) * 16777619u;         // FNV-1a
+        return hash;
+    }
+
+    void AccountState(uint32_t now)
+    {
+        (g_bIdle ? g_idleTotalMs : g_activeTotalMs) += now - g_stateSince;
+        g_stateSince = now;
+    }
+
+    void EnterIdle(uint32_t now)
+    {
+        AccountState(now);
+        g_bIdle = true;
+        ++g_idleEntries;
+        setCpuFrequencyMhz(kIdleCpuMhz);
+        WiFi.setSleep(true);
+        logI("Power save on after %u s without activity", kIdleAfterMs / 1000);
+    }
+
+    void ExitIdle(uint32_t now)
+    {
+        setCpuFrequencyMhz(kFullCpuMhz);
+        WiFi.setSleep(false);
+        AccountState(now);
+        g_bIdle = false;
+        g_bStatic = false;
+        g_unchangedFrames = 0;
+
+        g_wakeLatencyLastUs = micros() - g_lastActivityUs;
+        g_wakeLatencyMaxUs = std::max(g_wakeLatencyMaxUs, g_wakeLatencyLastUs);
+    }
+}
+
+// BeginPowerGovernor
+//
+// Starts at full speed with modem sleep off, which the Arduino core otherwise enables by default
+
+void BeginPowerGovernor()
+{
+    WiFi.setSleep(false);
+    g_stateSince = millis();
+    g_lastActivityMs = g_stateSince;
+}
+
+// NotePowerActivity
+//
+// Called from any task when a command or event arrives; wakes the draw task so it can restore full speed
+
+void NotePowerActivity()
+{
+    g_lastActivityMs = millis();
+    g_lastActivityUs = micros();
+    g_bActivity = true;
+    WakeDrawLoop();
+}
+
+// InhibitPowerSave
+//
+// Holds the cabinet at full speed until released, for measurements that must not see the clock change.  Both
+// ends count as activity, so an idle cabinet wakes at once and the idle minute restarts on release.
+
+void InhibitPowerSave(bool bInhibit)
+{
+    g_bInhibited = bInhibit;
+    NotePowerActivity();
+}
+
+// UpdatePowerGovernor
+//
+// Called by the draw task at the start of every pass, before it draws; returns true when power save just ended
+
+bool UpdatePowerGovernor(uint32_t now)
+{
+    const bool bActivity = g_bActivity.exchange(false);
+
+    if (g_bIdle && bActivity)
+    {
+        ExitIdle(now);
+        return true;
+    }
+#if ENABLE_POWERSAVE
+    if (!g_bIdle && !g_bInhibited && now - g_lastActivityMs >= kIdleAfterMs)
+        EnterIdle(now);
+#endif
+    return false;
+}
+
+// NotePowerFrame
+//
+// Called by the draw task after every show() to spot output that has stopped changing
+
+void NotePowerFrame()
+{
+    if (!g_bIdle)
+        return;
+
+    const uint32_t hash = HashLeds(HashLeds(2166136261u, leds0, NUM_LEDS0), leds1, NUM_LEDS1);
+    g_unchangedFrames = (hash == g_lastFrameHash) ? std::min<uint16_t>(g_unchangedFrames + 1, kStaticFrameCount) : 0;
+    g_lastFrameHash = hash;
+    g_bStatic = (g_unchangedFrames >= kStaticFrameCount);
+}
+
+// PowerSaveFrameMs
+//
+// The shortest time a draw pass may take, 0 when running at full speed
+
+uint32_t PowerSaveFrameMs()
+{
+    if (!g_bIdle)
+        return 0;
+    return g_bStatic ? kStaticFrameMs : kIdleFrameMs;
+}
+
+// PowerSavePollMs
+//
+// How long the polling loops (loop() and the debug task) should sleep between turns
+
+uint32_t PowerSavePollMs()
+{
+    return g_bIdle ? kIdlePollMs : kActivePollMs;
+}
+
+void ReportPowerStats()
+{
+    const uint32_t now = millis();
+    const uint32_t idleMs = g_idleTotalMs + (g_bIdle ? now - g_stateSince : 0);
+    const uint32_t activeMs = g_activeTotalMs + (g_bIdle ? 0 : now - g_stateSince);
+    const uint32_t totalMs = std::max<uint32_t>(idleMs + activeMs, 1);
+    const uint32_t estimatedMa = static_cast<uint32_t>((static_cast<uint64_t>(idleMs) * kIdleCurrentMa + static_cast<uint64_t>(activeMs) * kActiveCurrentMa) / totalMs);
+
+    debugI("Power: %s at %u MHz%s, idle %u%% of the time, %u idle periods, est. %u mA",
+           g_bIdle ? "saving" : "full speed", getCpuFrequencyMhz(), g_bStatic ? " (static output)" : "",
+           static_cast<uint32_t>(static_cast<uint64_t>(idleMs) * 100 / totalMs), g_idleEntries, estimatedMa);
+    debugI("Power: wake latency last %u us, max %u us", g_wakeLatencyLastUs, g_wakeLatencyMaxUs);
+}
@@ -0,0 +1,155 @@
+#include "globals.h"
+#include "preview.h"
+#include <cstring>
+
+namespace
+{
+    constexpr uint8_t kPreviewMsgKeyFrame   = 0x10;
+    constexpr uint8_t kPreviewMsgDeltaFrame = 0x11;
+    constexpr uint8_t kDeltaRecordBytes     = 4;
+    constexpr uint16_t kKeyFrameInterval    = 100;      // Frames between key frames, so a lost delta heals
+
+    static_assert(kPreviewLedCount <= 256, "Delta records address LEDs with one byte");
+
+    // Front buffer, written only by the draw task.  The sequence is bumped after each flip; a reader that
+    // sees it move by two or more while copying may have read a buffer that was being rewritten.
+
+    uint8_t g_previewBuffers[2][kPreviewFrameBytes];
+    volatile uint8_t  g_previewFront = 0;
+    volatile uint16_t g_previewSequence = 0;
+    volatile uint32_t g_previewIntervalMs = 1000 / kDefaultPreviewFps;
+    volatile bool     g_bPreviewCapture = false;       // Publish every frame, for a recording
+    uint32_t g_lastPublishMs = 0;
+
+    // Stream encoder state, owned by the one task that sends the stream
+
+    uint8_t  g_latestFrame[kPreviewFrameBytes];
+    uint8_t  g_sentFrame[kPreviewFrameBytes];
+    uint16_t g_sentSequence = 0;
+    uint16_t g_framesSinceKey = kKeyFrameInterval;
+
+    void WriteHeader(uint8_t * pMessage, uint8_t type, uint16_t sequence)
+    {
+        pMessage[0] = type;
+        pMessage[1] = static_cast<uint8_t>(sequence);
+        pMessage[2] = static_cast<uint8_t>(sequence >> 8);
+    }
+}
+
+// PublishPreviewFrame
+//
+// Called by the draw task after every show; copies the LEDs into the back buffer and flips it to the front
+// once the preview interval has passed, or every time while a recording captures
+
+void HOT_RENDER PublishPreviewFrame()
+{
+    const uint32_t now = millis();
+    if (!g_bPreviewCapture && now - g_lastPublishMs < g_previewIntervalMs)
+        return;
+    g_lastPublishMs = now;
+
+    const uint8_t back = g_previewFront ^ 1;
+    memcpy(g_previewBuffers[back], leds0, NUM_LEDS0 * sizeof(CRGB));
+    memcpy(g_previewBuffers[back] + NUM_LEDS0 * sizeof(CRGB), leds1, NUM_LEDS1 * sizeof(CRGB));
+    g_previewFront = back;
+    const uint16_t next = g_previewSequence + 1;
+    g_previewSequence = next ? next : 1;            // 0 means nothing published yet
+}
+
+// CopyPreviewFrame
+//
+// Copies the newest published frame (kPreviewFrameBytes) and returns its sequence; false before the first one
+
+bool CopyPreviewFrame(uint8_t * pFrame, uint16_t & sequence)
+{
+    for (;;)
+    {
+        sequence = g_previewSequence;
+        if (sequence == 0)
+            return false;
+        memcpy(pFrame, g_previewBuffers[g_previewFront], kPreviewFrameBytes);
+        if (static_cast<uint16_t>(g_previewSequence - sequence) < 2)
+            return true;
+    }
+}
+
+// NextPreviewMessage
+//
+// Encodes the newest frame for the stream into pMessage (kMaxPreviewMessage bytes) and returns its length, or 0
+// when there is nothing new to send.  A forced key frame resends the newest frame even if it went out before.
+// Only one task may call this.
+
+size_t NextPreviewMessage(uint8_t * pMessage, bool bForceKeyFrame)
+{
+    if (g_previewSequence == g_sentSequence && !bForceKeyFrame)
+        return 0;
+
+    uint16_t sequence;
+    if (!CopyPreviewFrame(g_latestFrame, sequence))
+        return 0;
+    g_sentSequence = sequence;
+
+    if (!bForceKeyFrame && g_framesSinceKey < kKeyFrameInterval)
+    {
+        uint8_t * pOut = pMessage + kPreviewHeaderBytes;
+        const uint8_t * const pEnd = pMessage + kMaxPreviewMessage;
+        bool bFits = true;
+        for (uint16_t led = 0; led < kPreviewLedCount; ++led)
+        {
+            const uint8_t * pRgb = g_latestFrame + led * 3;
+            if (0 == memcmp(pRgb, g_sentFrame + led * 3, 3))
+                continue;
+            if (pEnd - pOut < kDeltaRecordBytes)
+            {
+                bFits = false;
+                break;
+            }
+            pOut[0] = static_cast<uint8_t>(led);
+            memcpy(pOut + 1, pRgb, 3);
+            pOut += kDeltaRecordBytes;
+        }
+
+        // A delta that would be bigger than a key frame is sent as one
+        if (bFits)
+        {
+            if (pOut == pMessage + kPreviewHeaderBytes)
+                return 0;
+            WriteHeader(pMessage, kPreviewMsgDeltaFrame, sequence);
+            memcpy(g_sentFrame, g_latestFrame, kPreviewFrameBytes);
+            ++g_framesSinceKey;
+            return pOut - pMessage;
+        }
+    }
+
+    WriteHeader(pMessage, kPreviewMsgKeyFrame, sequence);
+    memcpy(pMessage + kPreviewHeaderBytes, g_latestFrame, kPreviewFrameBytes);
+    memcpy(g_sentFrame, g_latestFrame, kPreviewFrameBytes);
+    g_framesSinceKey = 0;
+    return kMaxPreviewMessage;
+}
+
+// SetPreviewCapture
+//
+// While set, every frame the draw task shows is published, so a recording sampling CopyPreviewFrame sees them all
+
+void SetPreviewCapture(bool bCapture)
+{
+    g_bPreviewCapture = bCapture;
+}
+
+// SetPreviewRate
+//
+// Sets how often the draw task publishes a frame for the preview, 1 to kMaxPreviewFps
+
+bool SetPreviewRate(uint8_t fps)
+{
+    if (fps == 0 || fps > kMaxPreviewFps)
+        return false;
+    g_previewIntervalMs = 1000 / fps;
+    return true;
+}
+
+uint8_t GetPreviewRate()
+{
+    return static_cast<uint8_t>(1000 / g_previewIntervalMs);
+}
@@ -0,0 +1,181 @@
+#include "globals.h"
+#include "remotepixels.h"
+#include <atomic>
+#include <utility>
+
+namespace
+{
+    constexpr size_t kRemoteLedCount  = NUM_LEDS0 + NUM_LEDS1;
+    constexpr size_t kRemoteMaskBytes = (kRemoteLedCount + 7) / 8;
+
+    // Staged by the writers under g_pixelMux.  A staged LED is one whose mask entry is not black, which lets a
+    // zone be staged with FillZoneBuffers like any other pair of channel buffers.
+
+    CRGB g_stagedLeds0[NUM_LEDS0];
+    CRGB g_stagedLeds1[NUM_LEDS1];
+    CRGB g_stagedMask0[NUM_LEDS0];
+    CRGB g_stagedMask1[NUM_LEDS1];
+    bool g_bStagedReplace = false;
+    volatile bool g_bStaged = false;
+    portMUX_TYPE g_pixelMux = portMUX_INITIALIZER_UNLOCKED;
+
+    std::atomic<int16_t> g_stagedBrightness(-1);
+
+    // Owned by the draw task
+    CRGB     g_heldLeds0[NUM_LEDS0];
+    CRGB     g_heldLeds1[NUM_LEDS1];
+    uint8_t  g_heldMask[kRemoteMaskBytes];             // One bit per LED, leds0 first
+    bool     g_bHolding = false;
+    bool     g_bOverlaid = false;
+    uint32_t g_lastWriteMs = 0;
+
+    bool IsHeldLed(size_t led)
+    {
+        return g_heldMask[led / 8] & (1 << (led % 8));
+    }
+
+    void TakeStaged(CRGB * pHeld, CRGB * pStaged, CRGB * pMask, size_t count, size_t firstLed)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!pMask[i])
+                continue;
+            pHeld[i] = pStaged[i];
+            pMask[i] = CRGB::Black;
+            g_heldMask[(firstLed + i) / 8] |= 1 << ((firstLed + i) % 8);
+        }
+    }
+
+    // Trades the held LEDs with the live ones; doing it twice puts everything back
+
+    void SwapHeldLeds()
+    {
+        for (size_t led = 0; led < NUM_LEDS0; ++led)
+        {
+            if (IsHeldLed(led))
+                std::swap(leds0[led], g_heldLeds0[led]);
+        }
+        for (size_t led = 0; led < NUM_LEDS1; ++led)
+        {
+            if (IsHeldLed(NUM_LEDS0 + led))
+                std::swap(leds1[led], g_heldLeds1[led]);
+        }
+    }
+}
+
+// BeginPixelWrites
+//
+// Starts staging a batch of LEDs that goes out in a single show().  With bReplace the batch replaces every LED
+// held so far instead of adding to them.  Keep the batch short: it runs with interrupts off on this core, so
+// parse and validate first and only copy in here.
+
+void BeginPixelWrites(bool bReplace)
+{
+    portENTER_CRITICAL(&g_pixelMux);
+    if (bReplace)
+    {
+        for (CRGB & mask : g_stagedMask0)
+            mask = CRGB::Black;
+        for (CRGB & mask : g_stagedMask1)
+            mask = CRGB::Black;
+        g_bStagedReplace = true;
+    }
+}
+
+void WritePixel(uint8_t strip, uint16_t index, const CRGB & color)
+{
+    if (strip == 0 && index < NUM_LEDS0)
+    {
+        g_stagedLeds0[index] = color;
+        g_stagedMask0[index] = CRGB::White;
+    }
+    else if (strip == 1 && index < NUM_LEDS1)
+    {
+        g_stagedLeds1[index] = color;
+        g_stagedMask1[index] = CRGB::White;
+    }
+}
+
+bool WriteZonePixels(LedZone zone, const CRGB & color)
+{
+    return FillZoneBuffers(zone, g_stagedLeds0, g_stagedLeds1, color)
+        && FillZoneBuffers(zone, g_stagedMask0, g_stagedMask1, CRGB::White);
+}
+
+void EndPixelWrites()
+{
+    g_bStaged = true;
+    portEXIT_CRITICAL(&g_pixelMux);
+    WakeDrawLoop();
+}
+
+// PostBrightness
+//
+// Sets the global brightness on the next draw pass; the caller stores it if it should survive a reboot
+
+void PostBrightness(uint8_t brightness)
+{
+    g_stagedBrightness = brightness;
+    WakeDrawLoop();
+}
+
+// ApplyRemoteRequests
+//
+// Takes staged LEDs and brightness between passes and lets the held LEDs go once they have timed out.
+// Returns true when the output has to be shown again even if no zone drew.
+
+bool ApplyRemoteRequests()
+{
+    bool bChanged = false;
+
+    const int16_t brightness = g_stagedBrightness.exchange(-1);
+    if (brightness >= 0)
+    {
+        FastLED.setBrightness(static_cast<uint8_t>(brightness));
+        bChanged = true;
+    }
+
+    const uint32_t now = millis();
+    if (g_bStaged)
+    {
+        portENTER_CRITICAL(&g_pixelMux);
+        if (g_bStagedReplace)
+            memset(g_heldMask, 0, sizeof(g_heldMask));
+        TakeStaged(g_heldLeds0, g_stagedLeds0, g_stagedMask0, NUM_LEDS0, 0);
+        TakeStaged(g_heldLeds1, g_stagedLeds1, g_stagedMask1, NUM_LEDS1, NUM_LEDS0);
+        g_bStagedReplace = false;
+        g_bStaged = false;
+        portEXIT_CRITICAL(&g_pixelMux);
+
+        g_bHolding = true;
+        g_lastWriteMs = now;
+        bChanged = true;
+    }
+    else if (g_bHolding && now - g_lastWriteMs >= kRemoteHoldMs)
+    {
+        g_bHolding = false;
+        memset(g_heldMask, 0, sizeof(g_heldMask));
+        bChanged = true;
+    }
+    return bChanged;
+}
+
+// OverlayRemotePixels
+//
+// Puts the held LEDs over the live output just before a show(); LiftRemotePixels takes them off afterwards
+
+void OverlayRemotePixels()
+{
+    if (!g_bHolding || g_bOverlaid)
+        return;
+    SwapHeldLeds();
+    g_bOverlaid = true;
+}
+
+void LiftRemotePixels()
+{
+    if (!g_bOverlaid)
+        return;
+    SwapHeldLeds();
+    g_bOverlaid = false;
+}
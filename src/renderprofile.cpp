@@ -0,0 +1,183 @@
+#include "globals.h"
+#include "renderprofile.h"
+#include "powersave.h"
+#include "monitor.h"
+#include <Preferences.h>
+#include <algorithm>
+
+extern TaskHandle_t g_taskProfile;
+
+namespace
+{
+    constexpr uint32_t kMaxRenderProfileSeconds = 300;
+    constexpr uint32_t kProfileWriteIntervalMs  = 20;       // About as often as a busy web client saves settings
+    constexpr uint32_t kProfileSettleMs         = 50;       // Lets the draw task finish the pass it is timing
+    constexpr const char * kProfilePrefsNamespace = "profile";
+    constexpr const char * kProfileCounterKey     = "n";
+
+    enum class ProfilePhase : uint8_t
+    {
+        Idle = 0,
+        Quiet,
+        FlashLoad
+    };
+
+    // Each sample records the CPU clock it ran at, so a run the clock changed under shows up in the report
+
+    struct PassStats
+    {
+        uint32_t passes = 0;
+        uint32_t totalUs = 0;
+        uint32_t maxUs = 0;
+        uint32_t minMhz = UINT32_MAX;
+        uint32_t maxMhz = 0;
+
+        void Add(uint32_t us, uint32_t mhz)
+        {
+            ++passes;
+            totalUs += us;
+            maxUs = std::max(maxUs, us);
+            minMhz = std::min(minMhz, mhz);
+            maxMhz = std::max(maxMhz, mhz);
+        }
+
+        uint32_t AvgUs() const
+        {
+            return passes ? totalUs / passes : 0;
+        }
+    };
+
+    struct RenderProfile
+    {
+        PassStats quiet;
+        PassStats afterWrite;               // First pass after a flash write, with a cold cache
+        PassStats betweenWrites;
+        PassStats writes;
+        uint32_t  lastWriteSeen = 0;        // Draw task side
+    };
+
+    RenderProfile g_profile;
+    volatile ProfilePhase g_profilePhase = ProfilePhase::Idle;
+    volatile uint32_t g_profileWrites = 0;  // Bumped after every completed flash write
+    volatile bool g_bProfileBusy = false;
+    uint32_t g_profileSeconds = kDefaultRenderProfileSeconds;
+
+    void ReportPassStats(const char * pszLabel, const char * pszUnit, const PassStats & stats)
+    {
+        if (0 == stats.passes)
+            debugI("  %s no %s", pszLabel, pszUnit);
+        else
+            debugI("  %s %u %s, avg %u us, max %u us at %u-%u MHz", pszLabel, stats.passes, pszUnit, stats.AvgUs(), stats.maxUs, stats.minMhz, stats.maxMhz);
+    }
+
+    void RenderProfileTaskEntry(void *)
+    {
+        const uint32_t halfMs = g_profileSeconds * 1000 / 2;
+
+        g_profilePhase = ProfilePhase::Quiet;
+        vTaskDelay(pdMS_TO_TICKS(halfMs));
+
+        Preferences prefs;
+        if (prefs.begin(kProfilePrefsNamespace, false))
+        {
+            g_profilePhase = ProfilePhase::FlashLoad;
+            const uint32_t start = millis();
+            for (uint32_t counter = 0; millis() - start < halfMs; ++counter)
+            {
+                const uint32_t writeStart = micros();
+                prefs.putUInt(kProfileCounterKey, counter);
+                g_profile.writes.Add(micros() - writeStart, getCpuFrequencyMhz());
+                ++g_profileWrites;
+                vTaskDelay(pdMS_TO_TICKS(kProfileWriteIntervalMs));
+            }
+            g_profilePhase = ProfilePhase::Idle;
+            prefs.clear();
+            prefs.end();
+        }
+        else
+        {
+            debugW("Render profile could not open NVS, no flash load phase");
+        }
+
+        g_profilePhase = ProfilePhase::Idle;
+        vTaskDelay(pdMS_TO_TICKS(kProfileSettleMs));
+        InhibitPowerSave(false);
+        ReportRenderProfile();
+
+        g_bProfileBusy = false;
+        ExitMonitoredTask(g_taskProfile);
+    }
+}
+
+// StartRenderProfile
+//
+// Starts a profile run of the given length in the background; the report is logged when it ends.  Power save
+// is held off for the whole run, since it would drop the clock to 80 MHz a minute in.
+
+bool StartRenderProfile(uint32_t seconds)
+{
+    if (g_bProfileBusy || seconds < 2 || seconds > kMaxRenderProfileSeconds)
+        return false;
+
+    g_profile = RenderProfile();
+    g_profileWrites = 0;
+    g_profileSeconds = seconds;
+    g_bProfileBusy = true;
+    InhibitPowerSave(true);
+    if (pdPASS != xTaskCreatePinnedToCore(RenderProfileTaskEntry, "Profile", kRenderProfileStackSize, nullptr, tskIDLE_PRIORITY + 1, &g_taskProfile, NET_CORE))
+    {
+        InhibitPowerSave(false);
+        g_bProfileBusy = false;
+        return false;
+    }
+    debugI("Profiling rendering for %u seconds, NVS writes start halfway", seconds);
+    return true;
+}
+
+// NoteRenderPass
+//
+// Called by the draw task with the time its zone steps took in a pass that drew something
+
+void HOT_RENDER NoteRenderPass(uint32_t renderUs)
+{
+    const ProfilePhase phase = g_profilePhase;
+    if (phase == ProfilePhase::Idle)
+        return;
+
+    const uint32_t mhz = getCpuFrequencyMhz();
+    if (phase == ProfilePhase::Quiet)
+    {
+        g_profile.quiet.Add(renderUs, mhz);
+    }
+    else
+    {
+        const uint32_t writes = g_profileWrites;
+        if (writes != g_profile.lastWriteSeen)
+        {
+            g_profile.lastWriteSeen = writes;
+            g_profile.afterWrite.Add(renderUs, mhz);
+        }
+        else
+        {
+            g_profile.betweenWrites.Add(renderUs, mhz);
+        }
+    }
+}
+
+void ReportRenderProfile()
+{
+    if (0 == g_profile.quiet.passes)
+        return;
+
+    const RenderProfile & profile = g_profile;
+    debugI("Render profile, hot path in %s:", ENABLE_IRAM_RENDER ? "IRAM" : "flash");
+    ReportPassStats("Quiet:         ", "passes", profile.quiet);
+    ReportPassStats("NVS writes:    ", "writes", profile.writes);
+    ReportPassStats("After a write: ", "passes", profile.afterWrite);
+    ReportPassStats("Between writes:", "passes", profile.betweenWrites);
+    if (profile.afterWrite.passes && profile.betweenWrites.passes)
+    {
+        debugI("  Cache refill costs %d us per pass after a write",
+               static_cast<int>(profile.afterWrite.AvgUs()) - static_cast<int>(profile.betweenWrites.AvgUs()));
+    }
+}
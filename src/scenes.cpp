@@ -0,0 +1,370 @@
+#include "globals.h"
+#include "scenes.h"
+#include "drawing.h"
+#include "framefile.h"
+#include "powersave.h"
+#include <SPIFFS.h>
+
+namespace
+{
+    constexpr size_t   kSceneLedCount      = NUM_LEDS0 + NUM_LEDS1;
+    constexpr size_t   kSceneMaskBytes     = (kSceneLedCount + 7) / 8;
+    constexpr uint16_t kSceneFileIntervalMs = 1000;     // Unused, but a frame file header needs one
+
+    const uint16_t kChannelSizes[NUM_CHANNELS] = { NUM_LEDS0, NUM_LEDS1 };
+
+    static_assert(kMaxSceneZoneMask == (1 << static_cast<uint8_t>(LedZone::Count)) - 1, "A zone mask has a bit per LedZone");
+
+    struct ScenePreset
+    {
+        volatile bool used = false;
+        char name[kMaxSceneNameLength + 1] = {};
+        uint16_t zoneMask = kSceneAllZones;
+        uint8_t ledMask[kSceneMaskBytes] = {};
+        CRGB leds0[NUM_LEDS0];
+        CRGB leds1[NUM_LEDS1];
+    };
+
+    enum class SceneEdit : uint8_t
+    {
+        None = 0,
+        Save,
+        Delete
+    };
+
+    struct SceneEditRequest
+    {
+        volatile SceneEdit edit = SceneEdit::None;
+        char name[kMaxSceneNameLength + 1] = {};
+        uint16_t zoneMask = kSceneAllZones;
+    };
+
+    ScenePreset g_scenes[kMaxScenes];
+    SceneEditRequest g_sceneEdit;
+
+    // Activation is latest-wins so a game can switch looks as fast as it likes
+    volatile int8_t g_requestedScene = -1;
+    volatile bool g_bSceneChange = false;
+
+    // Owned by the draw task
+    int8_t g_activeScene = -1;
+    CRGB g_liveLeds0[NUM_LEDS0];                        // What the live effects had drawn before a scene took over
+    CRGB g_liveLeds1[NUM_LEDS1];
+    CRGB g_maskLeds0[NUM_LEDS0];                        // Scratch for building zone masks
+    CRGB g_maskLeds1[NUM_LEDS1];
+
+    bool IsValidSceneName(const char * pszName)
+    {
+        return nullptr != pszName && 0 != *pszName && strlen(pszName) <= kMaxSceneNameLength;
+    }
+
+    void MakeScenePath(const char * pszName, char * pszPath, size_t cchPath)
+    {
+        snprintf(pszPath, cchPath, "/%s.scn", pszName);
+    }
+
+    int8_t FindScene(const char * pszName)
+    {
+        for (int8_t i = 0; i < kMaxScenes; ++i)
+        {
+            if (g_scenes[i].used && 0 == strcmp(g_scenes[i].name, pszName))
+                return i;
+        }
+        return -1;
+    }
+
+    int8_t FindFreeScene()
+    {
+        for (int8_t i = 0; i < kMaxScenes; ++i)
+        {
+            if (!g_scenes[i].used)
+                return i;
+        }
+        return -1;
+    }
+
+    bool IsSceneLed(const ScenePreset & scene, size_t led)
+    {
+        return scene.ledMask[led / 8] & (1 << (led % 8));
+    }
+
+    // BuildLedMask
+    //
+    // Expands a zone mask into one bit per LED, leds0 first, by filling the zones into scratch buffers
+
+    void BuildLedMask(ScenePreset & scene)
+    {
+        memset(scene.ledMask, 0, sizeof(scene.ledMask));
+        if (scene.zoneMask == kSceneAllZones)
+        {
+            memset(scene.ledMask, 0xFF, sizeof(scene.ledMask));
+            return;
+        }
+
+        fill_solid(g_maskLeds0, NUM_LEDS0, CRGB::Black);
+        fill_solid(g_maskLeds1, NUM_LEDS1, CRGB::Black);
+        for (uint8_t zone = 0; zone < static_cast<uint8_t>(LedZone::Count); ++zone)
+        {
+            if (scene.zoneMask & (1 << zone))
+                FillZoneBuffers(static_cast<LedZone>(zone), g_maskLeds0, g_maskLeds1, CRGB::White);
+        }
+
+        for (size_t led = 0; led < kSceneLedCount; ++led)
+        {
+            const CRGB & marked = led < NUM_LEDS0 ? g_maskLeds0[led] : g_maskLeds1[led - NUM_LEDS0];
+            if (marked)
+                scene.ledMask[led / 8] |= 1 << (led % 8);
+        }
+    }
+
+    // A scene file is a single raw frame file covering both channels, followed by the zone mask
+
+    bool WriteSceneFile(const ScenePreset & scene)
+    {
+        char path[kMaxSceneNameLength + 8];
+        MakeScenePath(scene.name, path, sizeof(path));
+        File file = SPIFFS.open(path, FILE_WRITE);
+        if (!file)
+            return false;
+
+        FrameFileHeader header;
+        InitFrameFileHeader(header, kSceneFileIntervalMs);
+        AddFrameFileSpan(header, 0, 0, NUM_LEDS0);
+        AddFrameFileSpan(header, 1, 0, NUM_LEDS1);
+        header.frameCount = 1;
+
+        const size_t expected = sizeof(header) + sizeof(scene.leds0) + sizeof(scene.leds1) + sizeof(scene.zoneMask);
+        const size_t written = file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header))
+                             + file.write(reinterpret_cast<const uint8_t *>(scene.leds0), sizeof(scene.leds0))
+                             + file.write(reinterpret_cast<const uint8_t *>(scene.leds1), sizeof(scene.leds1))
+                             + file.write(reinterpret_cast<const uint8_t *>(&scene.zoneMask), sizeof(scene.zoneMask));
+        file.close();
+        return written == expected;
+    }
+
+    bool ReadSceneFile(File & file, ScenePreset & scene)
+    {
+        FrameFileHeader header;
+        return file.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) == sizeof(header)
+            && IsValidFrameFileHeader(header, kChannelSizes, NUM_CHANNELS)
+            && header.encoding == static_cast<uint8_t>(FrameEncoding::Raw)
+            && header.spanCount == 2
+            && FrameFilePixelsPerFrame(header) == kSceneLedCount
+            && file.read(reinterpret_cast<uint8_t *>(scene.leds0), sizeof(scene.leds0)) == sizeof(scene.leds0)
+            && file.read(reinterpret_cast<uint8_t *>(scene.leds1), sizeof(scene.leds1)) == sizeof(scene.leds1)
+            && file.read(reinterpret_cast<uint8_t *>(&scene.zoneMask), sizeof(scene.zoneMask)) == sizeof(scene.zoneMask);
+    }
+
+    void CaptureScene(const SceneEditRequest & request)
+    {
+        int8_t index = FindScene(request.name);
+        if (index < 0)
+            index = FindFreeScene();
+        if (index < 0)
+        {
+            debugW("No room for scene %s, delete one first", request.name);
+            return;
+        }
+
+        // A new slot only becomes visible to FindScene once it is complete
+        ScenePreset & scene = g_scenes[index];
+        strcpy(scene.name, request.name);
+        scene.zoneMask = request.zoneMask;
+        memcpy(scene.leds0, leds0, sizeof(scene.leds0));
+        memcpy(scene.leds1, leds1, sizeof(scene.leds1));
+        BuildLedMask(scene);
+        scene.used = true;
+
+        if (!WriteSceneFile(scene))
+            debugW("Could not store scene %s, it will be lost on reboot", scene.name);
+        debugI("Saved scene %s", scene.name);
+    }
+
+    void RemoveScene(const SceneEditRequest & request)
+    {
+        const int8_t index = FindScene(request.name);
+        if (index < 0)
+            return;
+
+        if (index == g_activeScene)
+        {
+            g_requestedScene = -1;
+            g_bSceneChange = true;
+        }
+        g_scenes[index].used = false;
+
+        char path[kMaxSceneNameLength + 8];
+        MakeScenePath(request.name, path, sizeof(path));
+        SPIFFS.remove(path);
+        debugI("Deleted scene %s", request.name);
+    }
+}
+
+// BeginScenes
+//
+// Loads every stored scene into RAM.  Call once after SPIFFS is mounted and before the draw task starts.
+
+bool BeginScenes()
+{
+    File root = SPIFFS.open("/");
+    if (!root)
+        return false;
+
+    uint8_t loaded = 0;
+    for (File file = root.openNextFile(); file; file = root.openNextFile())
+    {
+        String path = file.name();
+        if (!path.endsWith(".scn"))
+            continue;
+
+        const String name = path.substring(path.startsWith("/") ? 1 : 0, path.length() - 4);
+        const int8_t index = FindFreeScene();
+        if (index < 0 || !IsValidSceneName(name.c_str()))
+        {
+            debugW("Skipping scene %s", path.c_str());
+            continue;
+        }
+
+        ScenePreset & scene = g_scenes[index];
+        if (!ReadSceneFile(file, scene))
+        {
+            debugW("%s is not a valid scene", path.c_str());
+            continue;
+        }
+        strcpy(scene.name, name.c_str());
+        BuildLedMask(scene);
+        scene.used = true;
+        ++loaded;
+    }
+    debugI("Loaded %u scenes", loaded);
+    return true;
+}
+
+// SaveScene
+//
+// Captures the current output as a scene on the next draw pass.  zoneMask has a bit per LedZone, or is
+// kSceneAllZones to capture the whole backglass.
+
+bool SaveScene(const char * pszName, uint16_t zoneMask)
+{
+    if (!IsValidSceneName(pszName) || zoneMask > kMaxSceneZoneMask || g_sceneEdit.edit != SceneEdit::None)
+        return false;
+
+    strcpy(g_sceneEdit.name, pszName);
+    g_sceneEdit.zoneMask = zoneMask;
+    g_sceneEdit.edit = SceneEdit::Save;
+    WakeDrawLoop();
+    return true;
+}
+
+bool ActivateScene(const char * pszName)
+{
+    if (!IsValidSceneName(pszName))
+        return false;
+
+    const int8_t index = FindScene(pszName);
+    if (index < 0)
+        return false;
+
+    g_requestedScene = index;
+    g_bSceneChange = true;
+    NotePowerActivity();
+    return true;
+}
+
+void ClearScene()
+{
+    g_requestedScene = -1;
+    g_bSceneChange = true;
+    NotePowerActivity();
+}
+
+bool DeleteScene(const char * pszName)
+{
+    if (!IsValidSceneName(pszName) || g_sceneEdit.edit != SceneEdit::None || FindScene(pszName) < 0)
+        return false;
+
+    strcpy(g_sceneEdit.name, pszName);
+    g_sceneEdit.edit = SceneEdit::Delete;
+    WakeDrawLoop();
+    return true;
+}
+
+void ReportScenes()
+{
+    for (int8_t i = 0; i < kMaxScenes; ++i)
+    {
+        if (g_scenes[i].used)
+            debugI("Scene %s, zones 0x%02x%s", g_scenes[i].name, g_scenes[i].zoneMask, i == g_activeScene ? " (active)" : "");
+    }
+}
+
+// ApplySceneRequests
+//
+// Carries out pending saves, deletes and activations between frames.  Returns true when the scene being shown
+// changed, in which case the caller has to refresh the output even if no zone drew.
+
+bool ApplySceneRequests()
+{
+    bool bChanged = false;
+
+    if (g_sceneEdit.edit == SceneEdit::Save)
+        CaptureScene(g_sceneEdit);
+    else if (g_sceneEdit.edit == SceneEdit::Delete)
+        RemoveScene(g_sceneEdit);
+    g_sceneEdit.edit = SceneEdit::None;
+
+    if (g_bSceneChange)
+    {
+        g_bSceneChange = false;
+        const int8_t requested = g_requestedScene;
+
+        // Put back what the effects had drawn so nothing of the previous scene lingers in static parts
+        if (g_activeScene >= 0)
+        {
+            memcpy(leds0, g_liveLeds0, sizeof(g_liveLeds0));
+            memcpy(leds1, g_liveLeds1, sizeof(g_liveLeds1));
+        }
+        else if (requested >= 0)
+        {
+            memcpy(g_liveLeds0, leds0, sizeof(g_liveLeds0));
+            memcpy(g_liveLeds1, leds1, sizeof(g_liveLeds1));
+        }
+
+        g_activeScene = (requested >= 0 && g_scenes[requested].used) ? requested : -1;
+        if (IsSceneHoldingDisplay())
+        {
+            memcpy(leds0, g_scenes[g_activeScene].leds0, sizeof(g_liveLeds0));
+            memcpy(leds1, g_scenes[g_activeScene].leds1, sizeof(g_liveLeds1));
+        }
+        bChanged = true;
+    }
+    return bChanged;
+}
+
+bool IsSceneHoldingDisplay()
+{
+    return g_activeScene >= 0 && g_scenes[g_activeScene].zoneMask == kSceneAllZones;
+}
+
+// OverlayActiveScene
+//
+// Puts the held LEDs of a zone-limited scene back on top of whatever the live effects just drew
+
+void OverlayActiveScene()
+{
+    if (g_activeScene < 0 || IsSceneHoldingDisplay())
+        return;
+
+    const ScenePreset & scene = g_scenes[g_activeScene];
+    for (size_t led = 0; led < NUM_LEDS0; ++led)
+    {
+        if (IsSceneLed(scene, led))
+            leds0[led] = scene.leds0[led];
+    }
+    for (size_t led = 0; led < NUM_LEDS1; ++led)
+    {
+        if (IsSceneLed(scene, NUM_LEDS0 + led))
+            leds1[led] = scene.leds1[led];
+    }
+}
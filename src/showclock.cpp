@@ -0,0 +1,51 @@
+#include "globals.h"
+#include "showclock.h"
+
+namespace
+{
+    TaskHandle_t      g_virtualClockTask = nullptr;
+    volatile uint32_t g_virtualClockMs   = 0;
+    volatile uint32_t g_showOffsetMs     = 0;         // Written whole by the clock sync task, so reads never tear
+}
+
+uint32_t ShowMillis()
+{
+    if (g_virtualClockTask != nullptr && g_virtualClockTask == xTaskGetCurrentTaskHandle())
+        return g_virtualClockMs;
+    return millis() + g_showOffsetMs;
+}
+
+void SetShowClockOffset(uint32_t offsetMs)
+{
+    g_showOffsetMs = offsetMs;
+}
+
+uint32_t GetShowClockOffset()
+{
+    return g_showOffsetMs;
+}
+
+void BeginVirtualShowTime(uint32_t startMs)
+{
+    g_virtualClockMs = startMs;
+    g_virtualClockTask = xTaskGetCurrentTaskHandle();
+}
+
+void AdvanceVirtualShowTime(uint32_t deltaMs)
+{
+    g_virtualClockMs += deltaMs;
+}
+
+void EndVirtualShowTime()
+{
+    g_virtualClockTask = nullptr;
+}
+
+// get_millisecond_timer
+//
+// FastLED's time source when USE_GET_MILLISECOND_TIMER is defined
+
+uint32_t get_millisecond_timer()
+{
+    return ShowMillis();
+}
@@ -0,0 +1,291 @@
+// audiocheck
+//
+// Host-side check of the audio analysis in include/audioanalysis.h, built from the same header the firmware uses:
+//
+//     g++ -std=c++17 -O2 -Wall -Iinclude tools/audiocheck.cpp -o audiocheck
+//     ./audiocheck                         runs a synthetic kick drum track and checks the beats found in it
+//     ./audiocheck song.wav [beats.txt]    also analyzes a recording, and scores it against labelled beats
+//
+// Recordings must be 16-bit PCM at 16 kHz, as the microphone is sampled ("sox in.wav -r 16000 -b 16 out.wav").
+// Stereo is mixed down.  The beat labels are one time in seconds per line; an Audacity label track exported as
+// text works as-is, since only the first number on each line is read.
+//
+// Every block is also timed.  The host is far faster than the ESP32, so a block that takes longer than the
+// device's kAudioBlockBudgetUs here means the analysis is hopelessly over budget; the real margin is the
+// overrun count in the "stats" console command.  It exits non-zero if any check fails.
+
+#include "audioanalysis.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t kBlockMs        = kAudioBlockSize * 1000 / kAudioSampleRate;
+    constexpr uint32_t kBeatToleranceMs = 2 * kBlockMs + 8;     // A beat is reported when the block holding it ends
+    constexpr uint32_t kMinMatchPct    = 90;                    // Recordings: share of beats found and beats real
+    constexpr uint32_t kKickIntervalMs = 500;                   // 120 BPM
+    constexpr uint32_t kKickCount      = 40;
+
+    static_assert(kAudioBlockSize * 1000 % kAudioSampleRate == 0, "Blocks must be a whole number of ms");
+
+    using Samples = std::vector<int16_t>;
+    using Times = std::vector<uint32_t>;
+
+    struct RunResult
+    {
+        Times    beatsMs;
+        uint32_t blocks = 0;
+        double   worstUs = 0;
+        double   totalUs = 0;
+    };
+
+    // Feeds the samples through the analyzer a block at a time, as the audio task does, with each block
+    // stamped by the time it ended
+
+    RunResult Analyze(const Samples & samples)
+    {
+        AudioAnalyzer analyzer;
+        RunResult result;
+        int32_t block[kAudioBlockSize];
+        uint32_t lastBeatMs = 0;
+
+        for (size_t first = 0; first + kAudioBlockSize <= samples.size(); first += kAudioBlockSize)
+        {
+            for (uint16_t i = 0; i < kAudioBlockSize; ++i)
+                block[i] = static_cast<int32_t>(samples[first + i]) * 65536;
+
+            const uint32_t nowMs = (result.blocks + 1) * kBlockMs;
+            AudioSnapshot snapshot;
+            const auto start = std::chrono::steady_clock::now();
+            analyzer.Analyze(block, nowMs, snapshot);
+            const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+            ++result.blocks;
+            result.totalUs += us;
+            if (us > result.worstUs)
+                result.worstUs = us;
+
+            if (snapshot.lastBeatMs != lastBeatMs)
+            {
+                lastBeatMs = snapshot.lastBeatMs;
+                result.beatsMs.push_back(lastBeatMs);
+            }
+        }
+        return result;
+    }
+
+    bool CheckBudget(const char * pszName, const RunResult & result)
+    {
+        const double averageUs = result.blocks ? result.totalUs / result.blocks : 0;
+        const bool bOk = result.worstUs <= kAudioBlockBudgetUs;
+        std::printf("%s: %u blocks, average %.1f us, worst %.1f us of the %u us budget: %s\n", pszName, result.blocks,
+                    averageUs, result.worstUs, kAudioBlockBudgetUs, bOk ? "ok" : "FAIL");
+        return bOk;
+    }
+
+    // Pairs every expected beat with the first unused detection within kBeatToleranceMs after it; returns how
+    // many expected beats were found
+
+    size_t MatchBeats(const Times & expectedMs, const Times & foundMs)
+    {
+        std::vector<bool> used(foundMs.size(), false);
+        size_t matched = 0;
+        for (uint32_t expected : expectedMs)
+        {
+            for (size_t i = 0; i < foundMs.size(); ++i)
+            {
+                if (!used[i] && foundMs[i] + kBlockMs >= expected && foundMs[i] <= expected + kBeatToleranceMs)
+                {
+                    used[i] = true;
+                    ++matched;
+                    break;
+                }
+            }
+        }
+        return matched;
+    }
+
+    // A decaying 60-90 Hz kick every kKickIntervalMs over a steady 1 kHz tone and noise, none of which should
+    // trigger a beat on its own
+
+    bool CheckSyntheticKicks()
+    {
+        const uint32_t leadInMs = 1000;
+        const size_t sampleCount = (leadInMs + kKickCount * kKickIntervalMs) * kAudioSampleRate / 1000;
+        Samples samples(sampleCount);
+        Times kicksMs;
+
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> noise(-0.01, 0.01);
+        for (size_t i = 0; i < sampleCount; ++i)
+        {
+            const double t = static_cast<double>(i) / kAudioSampleRate;
+            double value = 0.1 * std::sin(2 * M_PI * 1000 * t) + noise(rng);
+
+            const uint32_t ms = static_cast<uint32_t>(i * 1000 / kAudioSampleRate);
+            if (ms >= leadInMs)
+            {
+                const double sinceKick = std::fmod(t - leadInMs / 1000.0, kKickIntervalMs / 1000.0);
+                const double pitch = 60 + 30 * std::exp(-sinceKick / 0.02);
+                value += 0.7 * std::exp(-sinceKick / 0.06) * std::sin(2 * M_PI * pitch * sinceKick);
+            }
+            samples[i] = static_cast<int16_t>(std::lround(std::fmax(-1.0, std::fmin(1.0, value)) * 32767));
+        }
+        for (uint32_t kick = 0; kick < kKickCount; ++kick)
+            kicksMs.push_back(leadInMs + kick * kKickIntervalMs);
+
+        const RunResult result = Analyze(samples);
+        const size_t matched = MatchBeats(kicksMs, result.beatsMs);
+        const bool bBeatsOk = matched == kicksMs.size() && result.beatsMs.size() == kicksMs.size();
+        std::printf("Synthetic kicks: %zu of %zu found, %zu beats reported: %s\n", matched, kicksMs.size(),
+                    result.beatsMs.size(), bBeatsOk ? "ok" : "FAIL");
+
+        return CheckBudget("Synthetic kicks", result) && bBeatsOk;
+    }
+
+    uint32_t ReadLittleEndian(const uint8_t * p, uint8_t cb)
+    {
+        uint32_t value = 0;
+        for (uint8_t i = cb; i > 0; --i)
+            value = (value << 8) | p[i - 1];
+        return value;
+    }
+
+    // Reads a 16-bit PCM WAV at kAudioSampleRate, mixing any channels down to one
+
+    bool ReadWav(const char * pszPath, Samples & samples)
+    {
+        FILE * pFile = std::fopen(pszPath, "rb");
+        if (!pFile)
+        {
+            std::printf("%s: cannot open\n", pszPath);
+            return false;
+        }
+
+        uint8_t riff[12];
+        bool bOk = std::fread(riff, sizeof(riff), 1, pFile) == 1 && !std::memcmp(riff, "RIFF", 4) && !std::memcmp(riff + 8, "WAVE", 4);
+        uint16_t channels = 0;
+        bool bFormatOk = false;
+        while (bOk)
+        {
+            uint8_t chunk[8];
+            if (std::fread(chunk, sizeof(chunk), 1, pFile) != 1)
+            {
+                bOk = false;
+                break;
+            }
+            const uint32_t cbChunk = ReadLittleEndian(chunk + 4, 4);
+
+            if (!std::memcmp(chunk, "fmt ", 4))
+            {
+                uint8_t format[16];
+                bOk = cbChunk >= sizeof(format) && std::fread(format, sizeof(format), 1, pFile) == 1
+                   && std::fseek(pFile, cbChunk - sizeof(format) + (cbChunk & 1), SEEK_CUR) == 0;
+                channels = static_cast<uint16_t>(ReadLittleEndian(format + 2, 2));
+                bFormatOk = bOk && ReadLittleEndian(format, 2) == 1 && channels > 0
+                         && ReadLittleEndian(format + 4, 4) == kAudioSampleRate && ReadLittleEndian(format + 14, 2) == 16;
+                if (!bFormatOk)
+                {
+                    std::printf("%s: not 16-bit PCM at %u Hz\n", pszPath, kAudioSampleRate);
+                    std::fclose(pFile);
+                    return false;
+                }
+            }
+            else if (!std::memcmp(chunk, "data", 4) && bFormatOk)
+            {
+                std::vector<int16_t> interleaved(cbChunk / sizeof(int16_t));
+                bOk = std::fread(interleaved.data(), sizeof(int16_t), interleaved.size(), pFile) == interleaved.size();
+                samples.resize(interleaved.size() / channels);
+                for (size_t i = 0; i < samples.size(); ++i)
+                {
+                    int32_t sum = 0;
+                    for (uint16_t channel = 0; channel < channels; ++channel)
+                        sum += interleaved[i * channels + channel];
+                    samples[i] = static_cast<int16_t>(sum / channels);
+                }
+                break;
+            }
+            else
+            {
+                bOk = std::fseek(pFile, cbChunk + (cbChunk & 1), SEEK_CUR) == 0;
+            }
+        }
+        std::fclose(pFile);
+
+        if (!bOk)
+            std::printf("%s: not a WAV file, or truncated\n", pszPath);
+        return bOk;
+    }
+
+    bool ReadBeatLabels(const char * pszPath, Times & beatsMs)
+    {
+        FILE * pFile = std::fopen(pszPath, "r");
+        if (!pFile)
+        {
+            std::printf("%s: cannot open\n", pszPath);
+            return false;
+        }
+
+        char szLine[256];
+        while (std::fgets(szLine, sizeof(szLine), pFile))
+        {
+            char * pszEnd = nullptr;
+            const double seconds = std::strtod(szLine, &pszEnd);
+            if (pszEnd != szLine && seconds >= 0)
+                beatsMs.push_back(static_cast<uint32_t>(std::lround(seconds * 1000)));
+        }
+        std::fclose(pFile);
+        return true;
+    }
+
+    bool CheckRecording(const char * pszWav, const char * pszLabels)
+    {
+        Samples samples;
+        if (!ReadWav(pszWav, samples))
+            return false;
+
+        const RunResult result = Analyze(samples);
+        bool bOk = CheckBudget(pszWav, result);
+
+        if (!pszLabels)
+        {
+            for (uint32_t beatMs : result.beatsMs)
+                std::printf("%.3f\n", beatMs / 1000.0);
+            std::printf("%s: %zu beats\n", pszWav, result.beatsMs.size());
+            return bOk;
+        }
+
+        Times labelsMs;
+        if (!ReadBeatLabels(pszLabels, labelsMs))
+            return false;
+
+        const size_t matched = MatchBeats(labelsMs, result.beatsMs);
+        const size_t recallPct = labelsMs.empty() ? 100 : matched * 100 / labelsMs.size();
+        const size_t precisionPct = result.beatsMs.empty() ? 100 : matched * 100 / result.beatsMs.size();
+        const bool bBeatsOk = recallPct >= kMinMatchPct && precisionPct >= kMinMatchPct;
+        std::printf("%s: %zu of %zu labelled beats found (%zu%%), %zu of %zu reported beats real (%zu%%): %s\n", pszWav,
+                    matched, labelsMs.size(), recallPct, matched, result.beatsMs.size(), precisionPct, bBeatsOk ? "ok" : "FAIL");
+        return bOk && bBeatsOk;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    bool bOk = CheckSyntheticKicks();
+
+    if (argc > 3)
+    {
+        std::printf("usage: %s [recording.wav [beats.txt]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 1)
+        bOk &= CheckRecording(argv[1], argc > 2 ? argv[2] : nullptr);
+
+    return bOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
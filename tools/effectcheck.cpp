@@ -0,0 +1,110 @@
+// effectcheck
+//
+// Host-side render of the jackpot effect in include/jackpoteffect.h, built from the same headers the firmware uses
+// on top of a small FastLED stand-in:
+//
+//     g++ -std=c++17 -O2 -Wall -Itools/host -Iinclude tools/effectcheck.cpp -o effectcheck
+//     ./effectcheck                        renders every mode for every seed in jackpotgoldens.h and checks the hashes
+//     ./effectcheck --write                prints a new jackpotgoldens.h instead, for after a deliberate change
+//
+// Each run is the one the "fingerprint" console command does: kFingerprintFrames frames kFingerprintFrameMs apart
+// from kFingerprintStartMs, on the Backglass palette and the heartbeat pulse.  A mismatch here means the effect
+// changed; a mismatch only on the cabinet means the build there differs from this one.  It exits non-zero if any
+// check fails.
+
+#include "jackpotgoldens.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    constexpr uint16_t kWriteSeeds[] = { 1, 42, 1337 };     // 1337 is the console command's default
+    constexpr uint8_t  kModeCount = static_cast<uint8_t>(JackpotMode::Count);
+
+    CRGB g_backglass[kPaletteSize];
+
+    const CRGB * GetBackglassPalette()
+    {
+        return g_backglass;
+    }
+
+    uint32_t RenderMode(JackpotMode mode, uint16_t seed)
+    {
+        JackpotFingerprint run(mode, seed, GetBackglassPalette);
+        g_hostMillis = kFingerprintStartMs;
+        for (uint16_t frame = 0; frame < kFingerprintFrames; ++frame)
+        {
+            run.RenderFrame(g_hostMillis);
+            g_hostMillis += kFingerprintFrameMs;
+        }
+        return run.hash();
+    }
+
+    void WriteGoldens()
+    {
+        std::printf("#pragma once\n"
+                    "\n"
+                    "#include \"jackpoteffect.h\"\n"
+                    "\n"
+                    "// Jackpot goldens\n"
+                    "//\n"
+                    "// The hash of every jackpot mode rendered by JackpotFingerprint from each seed, which the \"fingerprint\"\n"
+                    "// console command checks the cabinet against.  Generated by \"effectcheck --write\"; regenerate it whenever a\n"
+                    "// change to the effect is meant to change what it draws.\n"
+                    "\n"
+                    "struct JackpotGolden\n"
+                    "{\n"
+                    "    uint16_t seed;\n"
+                    "    uint32_t hashes[static_cast<uint8_t>(JackpotMode::Count)];\n"
+                    "};\n"
+                    "\n"
+                    "const JackpotGolden kJackpotGoldens[] =\n"
+                    "{\n");
+        for (uint16_t seed : kWriteSeeds)
+        {
+            std::printf("    { %u, {", seed);
+            for (uint8_t mode = 0; mode < kModeCount; ++mode)
+                std::printf("%s0x%08xu", mode ? ", " : " ", RenderMode(static_cast<JackpotMode>(mode), seed));
+            std::printf(" } },\n");
+        }
+        std::printf("};\n");
+    }
+
+    bool CheckGoldens()
+    {
+        unsigned failures = 0;
+        for (const JackpotGolden & golden : kJackpotGoldens)
+        {
+            for (uint8_t mode = 0; mode < kModeCount; ++mode)
+            {
+                const uint32_t hash = RenderMode(static_cast<JackpotMode>(mode), golden.seed);
+                const bool bOk = hash == golden.hashes[mode];
+                std::printf("Seed %u, mode %u: %08x, golden %08x: %s\n", golden.seed, mode, hash, golden.hashes[mode],
+                            bOk ? "ok" : "FAIL");
+                if (!bOk)
+                    ++failures;
+            }
+        }
+        return failures == 0;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    ExpandPaletteStops(kBackglassColors, g_backglass);
+
+    if (argc == 2 && !std::strcmp(argv[1], "--write"))
+    {
+        WriteGoldens();
+        return EXIT_SUCCESS;
+    }
+    if (argc > 1)
+    {
+        std::printf("usage: %s [--write]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    return CheckGoldens() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
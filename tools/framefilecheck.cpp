@@ -0,0 +1,183 @@
+// framefilecheck
+//
+// Host-side check of the frame file format in include/framefile.h, built from the same header the firmware uses:
+//
+//     g++ -std=c++17 -O2 -Wall -Iinclude tools/framefilecheck.cpp -o framefilecheck
+//     ./framefilecheck                     round-trips generated frames through the DeltaRle encoder and decoder
+//     ./framefilecheck bake.led ...        also validates and decodes recordings copied off the cabinet
+//
+// The self test encodes sequences of frames that change nowhere, everywhere and in scattered runs longer than a
+// token can hold, decodes each one on top of the previous frame and compares the result, and checks that the
+// decoder rejects truncated and overlong data.  It exits non-zero if any check fails.
+
+#include "framefile.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // NUM_LEDS0 and NUM_LEDS1 in include/globals.h
+    constexpr uint16_t kChannelSizes[] = { 8 * 6 + 4 + 1, 121 };
+    constexpr uint8_t  kChannelCount = sizeof(kChannelSizes) / sizeof(kChannelSizes[0]);
+
+    using Frame = std::vector<uint8_t>;
+
+    int g_failures = 0;
+
+    void Fail(const char * pszWhat, size_t frame)
+    {
+        std::printf("FAIL: %s at frame %zu\n", pszWhat, frame);
+        ++g_failures;
+    }
+
+    // Changes roughly changePct percent of the pixels, in runs, so both token kinds and their limits get used
+
+    void MutateFrame(Frame & frame, std::mt19937 & rng, unsigned changePct)
+    {
+        const size_t pixelCount = frame.size() / kFrameFileBytesPerLed;
+        size_t pixel = 0;
+        while (pixel < pixelCount)
+        {
+            const size_t run = 1 + rng() % (2 * kFrameRunMax);
+            const bool bChange = rng() % 100 < changePct;
+            for (size_t i = pixel; i < pixel + run && i < pixelCount; ++i)
+            {
+                if (bChange)
+                {
+                    for (size_t c = 0; c < kFrameFileBytesPerLed; ++c)
+                        frame[i * kFrameFileBytesPerLed + c] = static_cast<uint8_t>(rng());
+                }
+            }
+            pixel += run;
+        }
+    }
+
+    void CheckRoundTrip(size_t pixelCount, size_t frameCount, unsigned changePct, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        Frame current(pixelCount * kFrameFileBytesPerLed, 0);
+        Frame previous;
+        Frame decoded(current.size(), 0xA5);
+        Frame encoded(FrameFileMaxEncodedBytes(pixelCount));
+
+        for (size_t frame = 0; frame < frameCount; ++frame)
+        {
+            MutateFrame(current, rng, frame == 0 ? 100 : changePct);
+            const size_t cbEncoded = EncodeDeltaRleFrame(frame ? previous.data() : nullptr, current.data(), pixelCount,
+                                                         encoded.data(), encoded.size());
+            if (cbEncoded == 0)
+            {
+                Fail("encoder ran out of room within FrameFileMaxEncodedBytes", frame);
+                return;
+            }
+
+            // The key frame lands on a buffer of junk: it has to decode on top of anything, which is what lets a
+            // looping player restart
+            if (!DecodeDeltaRleFrame(encoded.data(), cbEncoded, decoded.data(), pixelCount))
+                Fail(frame ? "delta frame did not decode" : "key frame did not decode", frame);
+            if (decoded != current)
+            {
+                Fail("decoded frame differs", frame);
+                return;
+            }
+
+            if (cbEncoded > 1 && DecodeDeltaRleFrame(encoded.data(), cbEncoded - 1, decoded.data(), pixelCount))
+                Fail("truncated frame was accepted", frame);
+            if (DecodeDeltaRleFrame(encoded.data(), cbEncoded, decoded.data(), pixelCount - 1))
+                Fail("frame longer than the layout was accepted", frame);
+            decoded = current;
+
+            // Too small an output buffer must fail instead of writing past it
+            if (cbEncoded > 1 && 0 != EncodeDeltaRleFrame(frame ? previous.data() : nullptr, current.data(), pixelCount,
+                                                          encoded.data(), cbEncoded - 1))
+            {
+                Fail("encoder overran a short buffer", frame);
+            }
+
+            previous = current;
+        }
+    }
+
+    bool CheckFile(const char * pszPath)
+    {
+        FILE * pFile = std::fopen(pszPath, "rb");
+        if (!pFile)
+        {
+            std::printf("%s: cannot open\n", pszPath);
+            return false;
+        }
+
+        FrameFileHeader header;
+        bool bValid = std::fread(&header, sizeof(header), 1, pFile) == 1
+                   && IsValidFrameFileHeader(header, kChannelSizes, kChannelCount);
+        if (!bValid)
+        {
+            std::printf("%s: not a valid frame file for this cabinet\n", pszPath);
+            std::fclose(pFile);
+            return false;
+        }
+
+        const size_t pixelCount = FrameFilePixelsPerFrame(header);
+        Frame pixels(pixelCount * kFrameFileBytesPerLed, 0);
+        Frame encoded(FrameFileMaxEncodedBytes(pixelCount));
+        size_t cbFrames = 0;
+        for (uint32_t frame = 0; frame < header.frameCount && bValid; ++frame)
+        {
+            if (header.encoding == static_cast<uint8_t>(FrameEncoding::Raw))
+            {
+                bValid = std::fread(pixels.data(), pixels.size(), 1, pFile) == 1;
+                cbFrames += pixels.size();
+                continue;
+            }
+
+            uint16_t cbFrame = 0;
+            bValid = std::fread(&cbFrame, sizeof(cbFrame), 1, pFile) == 1
+                  && cbFrame <= encoded.size()
+                  && std::fread(encoded.data(), cbFrame, 1, pFile) == 1
+                  && DecodeDeltaRleFrame(encoded.data(), cbFrame, pixels.data(), pixelCount);
+            cbFrames += sizeof(cbFrame) + cbFrame;
+            if (!bValid)
+                std::printf("%s: frame %u is truncated or corrupt\n", pszPath, frame);
+        }
+        const bool bTrailing = bValid && std::fgetc(pFile) != EOF;
+        std::fclose(pFile);
+
+        if (!bValid)
+            return false;
+        if (bTrailing)
+        {
+            std::printf("%s: data after the last of %u frames\n", pszPath, header.frameCount);
+            return false;
+        }
+
+        const size_t cbRaw = static_cast<size_t>(header.frameCount) * FrameFileRawFrameBytes(header);
+        std::printf("%s: %s, %u frames every %u ms%s, %u spans, %zu bytes of frames (%.0f%% of raw)\n", pszPath,
+                    header.encoding == static_cast<uint8_t>(FrameEncoding::Raw) ? "raw" : "DeltaRle", header.frameCount,
+                    header.frameIntervalMs, (header.flags & kFrameFileFlagLoop) ? ", loops" : "", header.spanCount, cbFrames,
+                    cbRaw ? 100.0 * cbFrames / cbRaw : 0.0);
+        return true;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    const size_t kAllPixels = kChannelSizes[0] + kChannelSizes[1];
+    const unsigned kChangePcts[] = { 0, 5, 50, 100 };
+    uint32_t seed = 1;
+    for (size_t pixelCount : { size_t(1), size_t(kFrameRunMax), size_t(kFrameRunMax + 1), kAllPixels })
+    {
+        for (unsigned changePct : kChangePcts)
+            CheckRoundTrip(pixelCount, 200, changePct, seed++);
+    }
+    std::printf("Round trip: %s\n", g_failures ? "FAILED" : "ok");
+
+    bool bFilesOk = true;
+    for (int i = 1; i < argc; ++i)
+        bFilesOk &= CheckFile(argv[i]);
+
+    return g_failures == 0 && bFilesOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
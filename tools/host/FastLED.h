@@ -0,0 +1,232 @@
+#pragma once
+
+// FastLED subset for host tools
+//
+// Just enough of FastLED for the effect headers in include/ to build on a PC.  The math is lib8tion's portable C
+// path with FASTLED_SCALE8_FIXED, which is what the ESP32 build runs, so a host tool draws the same bytes as the
+// cabinet; the "fingerprint" console command is the check that it still does.  beat8 and friends read
+// g_hostMillis, which the tool advances as its show clock.
+
+#include <stdint.h>
+#include <string.h>
+
+inline uint32_t g_hostMillis = 0;
+
+typedef uint8_t  fract8;
+typedef uint16_t accum88;
+
+inline uint8_t scale8(uint8_t i, fract8 scale)
+{
+    return static_cast<uint8_t>((static_cast<uint16_t>(i) * (1 + static_cast<uint16_t>(scale))) >> 8);
+}
+
+inline uint8_t qadd8(uint8_t i, uint8_t j)
+{
+    const unsigned int t = i + j;
+    return static_cast<uint8_t>(t > 255 ? 255 : t);
+}
+
+inline uint8_t lerp8by8(uint8_t a, uint8_t b, fract8 frac)
+{
+    if (b > a)
+        return static_cast<uint8_t>(a + scale8(static_cast<uint8_t>(b - a), frac));
+    return static_cast<uint8_t>(a - scale8(static_cast<uint8_t>(a - b), frac));
+}
+
+inline uint8_t sin8(uint8_t theta)
+{
+    static const uint8_t b_m16_interleave[] = { 0, 49, 49, 41, 90, 27, 117, 10 };
+
+    uint8_t offset = theta;
+    if (theta & 0x40)
+        offset = static_cast<uint8_t>(255 - offset);
+    offset &= 0x3F;
+
+    uint8_t secoffset = offset & 0x0F;
+    if (theta & 0x40)
+        ++secoffset;
+
+    const uint8_t section = offset >> 4;
+    const uint8_t b = b_m16_interleave[section * 2];
+    const uint8_t m16 = b_m16_interleave[section * 2 + 1];
+    const uint8_t mx = static_cast<uint8_t>((m16 * secoffset) >> 4);
+
+    int8_t y = static_cast<int8_t>(mx + b);
+    if (theta & 0x80)
+        y = static_cast<int8_t>(-y);
+    y = static_cast<int8_t>(y + 128);
+    return static_cast<uint8_t>(y);
+}
+
+inline uint16_t beat88(accum88 beats_per_minute_88, uint32_t timebase = 0)
+{
+    return static_cast<uint16_t>(((g_hostMillis - timebase) * beats_per_minute_88 * 280) >> 16);
+}
+
+inline uint16_t beat16(accum88 beats_per_minute, uint32_t timebase = 0)
+{
+    if (beats_per_minute < 256)
+        beats_per_minute <<= 8;
+    return beat88(beats_per_minute, timebase);
+}
+
+inline uint8_t beat8(accum88 beats_per_minute, uint32_t timebase = 0)
+{
+    return static_cast<uint8_t>(beat16(beats_per_minute, timebase) >> 8);
+}
+
+struct CRGB
+{
+    union
+    {
+        struct
+        {
+            uint8_t r;
+            uint8_t g;
+            uint8_t b;
+        };
+        uint8_t raw[3];
+    };
+
+    // Only the colors the shared headers use
+    enum HTMLColorCode : uint32_t
+    {
+        Black       = 0x000000,
+        Blue        = 0x0000FF,
+        BlueViolet  = 0x8A2BE2,
+        Cyan        = 0x00FFFF,
+        DarkOrange  = 0xFF8C00,
+        DeepPink    = 0xFF1493,
+        DeepSkyBlue = 0x00BFFF,
+        Gold        = 0xFFD700,
+        Green       = 0x008000,
+        LawnGreen   = 0x7CFC00,
+        Magenta     = 0xFF00FF,
+        Orange      = 0xFFA500,
+        OrangeRed   = 0xFF4500,
+        Purple      = 0x800080,
+        Red         = 0xFF0000,
+        White       = 0xFFFFFF,
+        Yellow      = 0xFFFF00
+    };
+
+    CRGB() = default;
+
+    constexpr CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib)
+    {
+    }
+
+    constexpr CRGB(uint32_t colorcode)
+        : r(static_cast<uint8_t>(colorcode >> 16)), g(static_cast<uint8_t>(colorcode >> 8)), b(static_cast<uint8_t>(colorcode))
+    {
+    }
+
+    constexpr CRGB(HTMLColorCode colorcode) : CRGB(static_cast<uint32_t>(colorcode))
+    {
+    }
+
+    CRGB & operator+=(const CRGB & rhs)
+    {
+        r = qadd8(r, rhs.r);
+        g = qadd8(g, rhs.g);
+        b = qadd8(b, rhs.b);
+        return *this;
+    }
+
+    CRGB & nscale8(uint8_t scale)
+    {
+        const uint16_t scale_fixed = scale + 1;
+        r = static_cast<uint8_t>((r * scale_fixed) >> 8);
+        g = static_cast<uint8_t>((g * scale_fixed) >> 8);
+        b = static_cast<uint8_t>((b * scale_fixed) >> 8);
+        return *this;
+    }
+
+    CRGB & nscale8_video(uint8_t scale)
+    {
+        const uint8_t nonzeroscale = scale != 0 ? 1 : 0;
+        r = r == 0 ? 0 : static_cast<uint8_t>(((r * scale) >> 8) + nonzeroscale);
+        g = g == 0 ? 0 : static_cast<uint8_t>(((g * scale) >> 8) + nonzeroscale);
+        b = b == 0 ? 0 : static_cast<uint8_t>(((b * scale) >> 8) + nonzeroscale);
+        return *this;
+    }
+
+    bool operator==(const CRGB & rhs) const
+    {
+        return r == rhs.r && g == rhs.g && b == rhs.b;
+    }
+
+    bool operator!=(const CRGB & rhs) const
+    {
+        return !(*this == rhs);
+    }
+};
+
+#define FL_PROGMEM
+
+typedef uint32_t TProgmemRGBPalette16[16];
+
+enum TBlendType
+{
+    NOBLEND = 0,
+    LINEARBLEND = 1
+};
+
+class CRGBPalette16
+{
+  public:
+
+    explicit CRGBPalette16(const TProgmemRGBPalette16 & stops)
+    {
+        for (uint8_t i = 0; i < 16; ++i)
+            entries[i] = CRGB(stops[i]);
+    }
+
+    const CRGB & operator[](uint8_t index) const
+    {
+        return entries[index];
+    }
+
+    CRGB entries[16];
+};
+
+inline CRGB ColorFromPalette(const CRGBPalette16 & pal, uint8_t index, uint8_t brightness = 255, TBlendType blendType = LINEARBLEND)
+{
+    const uint8_t hi4 = index >> 4;
+    const uint8_t lo4 = index & 0x0F;
+    const CRGB & entry = pal[hi4];
+
+    uint8_t red1 = entry.r;
+    uint8_t green1 = entry.g;
+    uint8_t blue1 = entry.b;
+
+    if (lo4 && blendType != NOBLEND)
+    {
+        const CRGB & next = pal[hi4 == 15 ? 0 : hi4 + 1];
+        const uint8_t f2 = static_cast<uint8_t>(lo4 << 4);
+        const uint8_t f1 = static_cast<uint8_t>(255 - f2);
+
+        red1 = static_cast<uint8_t>(scale8(red1, f1) + scale8(next.r, f2));
+        green1 = static_cast<uint8_t>(scale8(green1, f1) + scale8(next.g, f2));
+        blue1 = static_cast<uint8_t>(scale8(blue1, f1) + scale8(next.b, f2));
+    }
+
+    if (brightness != 255)
+    {
+        if (brightness)
+        {
+            ++brightness;
+            if (red1)
+                red1 = scale8(red1, brightness);
+            if (green1)
+                green1 = scale8(green1, brightness);
+            if (blue1)
+                blue1 = scale8(blue1, brightness);
+        }
+        else
+        {
+            red1 = green1 = blue1 = 0;
+        }
+    }
+    return CRGB(red1, green1, blue1);
+}
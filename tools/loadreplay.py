@@ -0,0 +1,277 @@
+#!/usr/bin/env python3
+"""Replay HTTP request traces against a cabinet and report latency and frame-rate impact.
+
+Traces are the .http files in the repo root (requests separated by ###) or JSON lines with a "url" or "path"
+and optional "method" and "body".  Only the path and query of each request are kept; they are sent to the
+target in trace order, round robin, at --rate requests a second over --concurrency connections.
+
+Latency is measured from when a request was due, not from when a connection got round to sending it, so a
+server that falls behind shows up in the percentiles instead of quietly lowering the rate.
+
+Before the load starts the tool samples /drawstats for --baseline seconds to get the idle frame rate, and again
+across the load.  One trace request is sent first so the power governor is awake for the baseline too; it caps
+the frame rate after a minute without activity.
+
+    python3 tools/loadreplay.py 192.168.10.99 setLed.http setLeds.http --rate 20 --concurrency 4
+    python3 tools/loadreplay.py --standin setPalette.http scene.http --duration 5
+
+--standin runs the load against a local stand-in that answers the ApiWebServer routes, which checks a trace
+and the tool itself without a cabinet.
+"""
+
+import argparse
+import http.client
+import http.server
+import json
+import queue
+import threading
+import time
+from urllib.parse import urlsplit
+
+# Routes served by ApiWebServer (include/apiwebserver.h), for the stand-in
+ROUTES = {
+    "/setled", "/setbrightness", "/setleds", "/play", "/stop", "/scene", "/savescene", "/clearscene",
+    "/setpalette", "/frame", "/previewrate", "/drawstats",
+}
+STANDIN_FPS = 60
+
+
+class TraceRequest:
+    def __init__(self, method, target, body=None):
+        self.method = method
+        self.target = target
+        self.body = body
+
+
+def request_target(url):
+    parts = urlsplit(url)
+    target = parts.path or "/"
+    return target + ("?" + parts.query if parts.query else "")
+
+
+def load_http_file(path):
+    """Requests from a REST client .http file: a request line, optional headers, a blank line and a body."""
+    requests = []
+    with open(path, encoding="utf-8") as handle:
+        blocks = handle.read().split("###")
+    for block in blocks:
+        lines = [line for line in block.strip().splitlines() if not line.lstrip().startswith("#")]
+        if not lines:
+            continue
+        method, _, url = lines[0].strip().partition(" ")
+        body_lines = []
+        in_body = False
+        for line in lines[1:]:
+            if in_body:
+                body_lines.append(line)
+            elif not line.strip():
+                in_body = True
+        body = "\n".join(body_lines).encode() if body_lines else None
+        requests.append(TraceRequest(method.upper(), request_target(url.strip()), body))
+    return requests
+
+
+def load_jsonl_file(path):
+    requests, skipped = [], 0
+    with open(path, encoding="utf-8") as handle:
+        for line in handle:
+            if not line.strip():
+                continue
+            entry = json.loads(line)
+            url = entry.get("url") or entry.get("path")
+            if not url:
+                skipped += 1
+                continue
+            body = entry.get("body")
+            requests.append(TraceRequest(entry.get("method", "GET").upper(), request_target(url),
+                                         body.encode() if isinstance(body, str) else None))
+    if skipped:
+        print(f"{path}: skipped {skipped} lines without a url or path")
+    return requests
+
+
+def load_traces(paths):
+    requests = []
+    for path in paths:
+        requests += load_jsonl_file(path) if path.endswith(".jsonl") else load_http_file(path)
+    return requests
+
+
+def send(host, port, request, timeout):
+    """Sends one request on a new connection and returns the status, or raises."""
+    connection = http.client.HTTPConnection(host, port, timeout=timeout)
+    try:
+        connection.request(request.method, request.target, body=request.body)
+        response = connection.getresponse()
+        response.read()
+        return response.status
+    finally:
+        connection.close()
+
+
+def draw_stats(host, port, timeout):
+    try:
+        connection = http.client.HTTPConnection(host, port, timeout=timeout)
+        connection.request("GET", "/drawstats")
+        response = connection.getresponse()
+        data = response.read()
+        connection.close()
+        return json.loads(data) if response.status == 200 else None
+    except (OSError, ValueError):
+        return None
+
+
+def frame_rate(before, after):
+    if not before or not after or after["millis"] == before["millis"]:
+        return None
+    return (after["frames"] - before["frames"]) * 1000.0 / (after["millis"] - before["millis"])
+
+
+def percentile(sorted_values, fraction):
+    if not sorted_values:
+        return 0.0
+    index = min(len(sorted_values) - 1, int(round(fraction * (len(sorted_values) - 1))))
+    return sorted_values[index]
+
+
+def run_load(host, port, requests, rate, concurrency, duration, timeout):
+    """Open-loop load: requests are scheduled at a fixed rate whether or not earlier ones have finished."""
+    due = queue.Queue()
+    latencies, statuses, errors = [], {}, {}
+    lock = threading.Lock()
+
+    def worker():
+        while True:
+            item = due.get()
+            if item is None:
+                return
+            due_time, request = item
+            delay = due_time - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+            try:
+                status = send(host, port, request, timeout)
+                key, bucket = status, statuses
+            except OSError as error:
+                key, bucket = type(error).__name__, errors
+            elapsed = time.monotonic() - due_time
+            with lock:
+                latencies.append(elapsed)
+                bucket[key] = bucket.get(key, 0) + 1
+
+    workers = [threading.Thread(target=worker, daemon=True) for _ in range(concurrency)]
+    for thread in workers:
+        thread.start()
+
+    start = time.monotonic()
+    count = int(rate * duration)
+    for i in range(count):
+        due.put((start + i / rate, requests[i % len(requests)]))
+    for _ in workers:
+        due.put(None)
+    for thread in workers:
+        thread.join()
+    return latencies, statuses, errors, time.monotonic() - start
+
+
+class StandInHandler(http.server.BaseHTTPRequestHandler):
+    started = time.monotonic()
+    delay = 0.0
+
+    def handle_request(self):
+        length = int(self.headers.get("Content-Length", 0))
+        if length:
+            self.rfile.read(length)
+        if self.delay:
+            time.sleep(self.delay)
+        path = urlsplit(self.path).path
+        if path not in ROUTES:
+            self.send_response(404)
+            self.end_headers()
+            return
+        body = b""
+        if path == "/drawstats":
+            millis = int((time.monotonic() - self.started) * 1000)
+            body = json.dumps({"millis": millis, "frames": millis * STANDIN_FPS // 1000,
+                               "showAvgUs": 0, "passAvgUs": 0, "overruns": 0}).encode()
+        self.send_response(200)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    do_GET = handle_request
+    do_POST = handle_request
+
+    def log_message(self, *args):
+        pass
+
+
+def start_standin(delay_ms):
+    StandInHandler.delay = delay_ms / 1000.0
+    server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), StandInHandler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("target", nargs="?", help="cabinet address, host or host:port; omit with --standin")
+    parser.add_argument("traces", nargs="+", help=".http or .jsonl files")
+    parser.add_argument("--rate", type=float, default=10.0, help="requests a second")
+    parser.add_argument("--concurrency", type=int, default=2)
+    parser.add_argument("--duration", type=float, default=30.0, help="seconds of load")
+    parser.add_argument("--baseline", type=float, default=5.0, help="seconds of idle frame rate sampling")
+    parser.add_argument("--timeout", type=float, default=5.0)
+    parser.add_argument("--standin", action="store_true", help="run against a local stand-in server")
+    parser.add_argument("--standin-delay-ms", type=float, default=0.0)
+    args = parser.parse_args()
+
+    traces = ([args.target] if args.target and args.standin else []) + args.traces
+    if args.standin:
+        server = start_standin(args.standin_delay_ms)
+        host, port = server.server_address
+    elif args.target:
+        host, _, port = args.target.partition(":")
+        port = int(port or 80)
+    else:
+        parser.error("a target is needed without --standin")
+
+    requests = load_traces(traces)
+    if not requests:
+        parser.error("the traces hold no requests")
+    print(f"{len(requests)} requests from {len(traces)} traces against {host}:{port}")
+
+    try:
+        send(host, port, requests[0], args.timeout)
+    except OSError as error:
+        print(f"Warm-up request failed: {error}")
+    idle_before = draw_stats(host, port, args.timeout)
+    time.sleep(args.baseline)
+    idle_after = draw_stats(host, port, args.timeout)
+
+    latencies, statuses, errors, elapsed = run_load(host, port, requests, args.rate, args.concurrency,
+                                                    args.duration, args.timeout)
+    load_after = draw_stats(host, port, args.timeout)
+
+    latencies.sort()
+    ms = [value * 1000.0 for value in latencies]
+    print(f"{len(latencies)} requests in {elapsed:.1f} s ({len(latencies) / elapsed:.1f}/s)")
+    print(f"latency p50 {percentile(ms, 0.50):.1f} ms, p90 {percentile(ms, 0.90):.1f} ms, "
+          f"p99 {percentile(ms, 0.99):.1f} ms, max {ms[-1] if ms else 0:.1f} ms")
+    print("status " + ", ".join(f"{code}: {count}" for code, count in sorted(statuses.items())))
+    failed = sum(count for code, count in statuses.items() if code >= 400) + sum(errors.values())
+    print(f"errors {failed}" + ("".join(f", {name}: {count}" for name, count in errors.items())))
+
+    idle_fps = frame_rate(idle_before, idle_after)
+    load_fps = frame_rate(idle_after, load_after)
+    if idle_fps is None or load_fps is None:
+        print("frame rate unavailable, the target has no /drawstats")
+    else:
+        change = (load_fps - idle_fps) / idle_fps * 100.0 if idle_fps else 0.0
+        print(f"frame rate idle {idle_fps:.1f} fps, under load {load_fps:.1f} fps ({change:+.1f}%)")
+        print(f"draw pass avg {load_after['passAvgUs']} us, show avg {load_after['showAvgUs']} us, "
+              f"{load_after['overruns'] - idle_after['overruns']} governor overruns under load")
+
+
+if __name__ == "__main__":
+    main()
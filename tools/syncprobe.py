@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Measure how closely the show clocks of several cabinets agree.
+
+Every cabinet with clock sync enabled answers the same UDP requests that followers send to the master (see
+include/clocksync.h).  This script plays a follower that never steers: it times a burst of exchanges with each
+cabinet, keeps the one with the shortest round trip, and reports each cabinet's show clock relative to the
+first one.  That difference is the phase error the effects see.
+
+    python3 tools/syncprobe.py 192.168.10.99 192.168.10.98 --rounds 30
+"""
+
+import argparse
+import socket
+import struct
+import time
+
+PORT = 4210
+MAGIC = 0x53504F42
+REQUEST, REPLY = 0, 1
+ROLE_OFF = 0
+ROLE_NAMES = {0: "off", 1: "master", 2: "follower"}
+PACKET = struct.Struct("<IBBHIIQQQ")            # Matches ClockSyncPacket in src/clocksync.cpp
+
+
+def now_us():
+    return time.monotonic_ns() // 1000
+
+
+def exchange(sock, address, sequence, timeout):
+    """One request/reply, returning (offset_us, delay_us, reply) or None on a timeout."""
+    t1 = now_us()
+    sock.sendto(PACKET.pack(MAGIC, REQUEST, ROLE_OFF, sequence, 0, 0, t1, 0, 0), (address, PORT))
+    deadline = time.monotonic() + timeout
+    while True:
+        remaining = deadline - time.monotonic()
+        if remaining <= 0:
+            return None
+        sock.settimeout(remaining)
+        try:
+            data, _ = sock.recvfrom(PACKET.size)
+        except socket.timeout:
+            return None
+        t4 = now_us()
+        if len(data) != PACKET.size:
+            continue
+        magic, kind, role, seq, epoch, seed, origin, t2, t3 = PACKET.unpack(data)
+        if magic != MAGIC or kind != REPLY or seq != sequence or origin != t1:
+            continue
+        offset = ((t2 - t1) + (t3 - t4)) // 2
+        delay = (t4 - t1) - (t3 - t2)
+        return offset, delay, {"role": role, "epoch": epoch}
+
+
+def best_of(sock, address, burst, timeout, sequence):
+    best = None
+    for i in range(burst):
+        result = exchange(sock, address, (sequence + i) & 0xFFFF, timeout)
+        if result and (best is None or result[1] < best[1]):
+            best = result
+    return best
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("nodes", nargs="+", help="cabinet addresses, the first is the reference")
+    parser.add_argument("--rounds", type=int, default=10)
+    parser.add_argument("--burst", type=int, default=8, help="exchanges per cabinet per round, the fastest is kept")
+    parser.add_argument("--interval", type=float, default=1.0, help="seconds between rounds")
+    parser.add_argument("--timeout", type=float, default=0.2)
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    errors = {node: [] for node in args.nodes[1:]}
+    sequence = 1
+
+    for round_index in range(args.rounds):
+        results = {}
+        for node in args.nodes:
+            results[node] = best_of(sock, node, args.burst, args.timeout, sequence)
+            sequence += args.burst
+
+        reference = results[args.nodes[0]]
+        line = [f"{round_index:3}"]
+        for node in args.nodes:
+            result = results[node]
+            if result is None:
+                line.append(f"{node}: no reply")
+                continue
+            offset, delay, info = result
+            role = ROLE_NAMES.get(info["role"], "?")
+            if node == args.nodes[0] or reference is None:
+                line.append(f"{node} ({role}): rtt {delay} us, epoch {info['epoch']}")
+            else:
+                error = offset - reference[0]
+                errors[node].append(error)
+                line.append(f"{node} ({role}): phase {error / 1000:+.2f} ms, rtt {delay} us, epoch {info['epoch']}")
+        print(" | ".join(line))
+        time.sleep(args.interval)
+
+    for node, samples in errors.items():
+        if samples:
+            mean = sum(samples) / len(samples)
+            worst = max(samples, key=abs)
+            print(f"{node}: mean phase error {mean / 1000:+.2f} ms, worst {worst / 1000:+.2f} ms over {len(samples)} rounds")
+
+
+if __name__ == "__main__":
+    main()